@@ -0,0 +1,99 @@
+# Profile guided optimization (PGO) and link time optimization (LTO) support.
+#
+# A PGO build is done in three steps within the same build directory:
+#  1. Configure with -DPGO_MODE=GENERATE and build: creates an instrumented binary.
+#  2. Build the 'pgo-training' target: runs the instrumented binary with a deterministic workload
+#     and writes the profile data to PGO_PROFILE_DIR.
+#  3. Re-configure with -DPGO_MODE=USE and build again: creates the optimized binary.
+#  4. Optional: with -DPGO_BASELINE_BINARY=<binary built without PGO>, the 'pgo-benchmark' target
+#     reports the speedup of the optimized binary in the input benchmarks.
+#
+# LTO can be enabled independently with -DENABLE_LTO=ON and is recommended together with PGO_MODE=USE.
+
+set(PgoModeOptions "OFF" "GENERATE" "USE")
+set(PGO_MODE "OFF" CACHE STRING "Profile guided optimization mode")
+set_property(CACHE PGO_MODE PROPERTY STRINGS ${PgoModeOptions})
+set(PGO_PROFILE_DIR "${CMAKE_BINARY_DIR}/pgo-profile" CACHE PATH "Profile data directory for PGO builds")
+set(PGO_BASELINE_BINARY "" CACHE FILEPATH "Binary without PGO, compared by the 'pgo-benchmark' target")
+
+option(ENABLE_LTO "Enable link time optimization" OFF)
+
+list(FIND PgoModeOptions ${PGO_MODE} _pgo_index)
+if(_pgo_index EQUAL -1)
+  message(FATAL_ERROR "PGO_MODE must be one of ${PgoModeOptions}")
+endif()
+
+# Helper function, sets up PGO and LTO compile and link flags for the given target
+# and adds the 'pgo-training' target for PGO_MODE=GENERATE and the 'pgo-benchmark' target
+# for PGO_MODE=USE.
+function(add_pgo_lto_support target training_script benchmark_script)
+  if(ENABLE_LTO)
+    if(CMAKE_VERSION VERSION_LESS "3.9")
+      message(WARNING "LTO requires CMake 3.9 or later, building without LTO.")
+    else()
+      cmake_policy(SET CMP0069 NEW)
+      include(CheckIPOSupported)
+      check_ipo_supported(RESULT _lto_supported OUTPUT _lto_output)
+      if(_lto_supported)
+        message(STATUS "Link time optimization enabled.")
+        set_property(TARGET ${target} PROPERTY INTERPROCEDURAL_OPTIMIZATION TRUE)
+      else()
+        message(WARNING "LTO is not supported by the compiler: ${_lto_output}")
+      endif()
+    endif()
+  endif()
+
+  if("${PGO_MODE}" STREQUAL "OFF")
+    return()
+  endif()
+
+  if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+    set(_pgo_generate_flags "-fprofile-generate" "-fprofile-dir=${PGO_PROFILE_DIR}"
+                            "-fprofile-update=atomic")
+    # Sources not exercised by the training must not fail the -Werror build.
+    set(_pgo_use_flags "-fprofile-use" "-fprofile-dir=${PGO_PROFILE_DIR}" "-fprofile-correction"
+                       "-Wno-missing-profile" "-Wno-coverage-mismatch")
+  elseif(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+    set(_pgo_generate_flags "-fprofile-instr-generate=${PGO_PROFILE_DIR}/projecteur-%p.profraw")
+    set(_pgo_use_flags "-fprofile-instr-use=${PGO_PROFILE_DIR}/projecteur.profdata"
+                       "-Wno-profile-instr-unprofiled" "-Wno-profile-instr-out-of-date")
+    find_program(LLVM_PROFDATA_EXECUTABLE NAMES llvm-profdata)
+    if(NOT LLVM_PROFDATA_EXECUTABLE)
+      message(WARNING "llvm-profdata not found, needed to merge PGO profile data.")
+    endif()
+  else()
+    message(WARNING "PGO is not supported for compiler '${CMAKE_CXX_COMPILER_ID}'.")
+    return()
+  endif()
+
+  if("${PGO_MODE}" STREQUAL "GENERATE")
+    message(STATUS "PGO: Building instrumented binary, profile dir: ${PGO_PROFILE_DIR}")
+    target_compile_options(${target} PRIVATE ${_pgo_generate_flags})
+    target_link_libraries(${target} PRIVATE ${_pgo_generate_flags})
+
+    add_custom_target(pgo-training
+      COMMAND ${CMAKE_COMMAND} -E make_directory "${PGO_PROFILE_DIR}"
+      COMMAND sh "${training_script}" "$<TARGET_FILE:${target}>" "${PGO_PROFILE_DIR}"
+                 "${LLVM_PROFDATA_EXECUTABLE}"
+      WORKING_DIRECTORY "${CMAKE_BINARY_DIR}"
+      COMMENT "Running PGO training workload"
+      VERBATIM
+    )
+    add_dependencies(pgo-training ${target})
+  elseif("${PGO_MODE}" STREQUAL "USE")
+    message(STATUS "PGO: Using profile data from ${PGO_PROFILE_DIR}")
+    target_compile_options(${target} PRIVATE ${_pgo_use_flags})
+    target_link_libraries(${target} PRIVATE ${_pgo_use_flags})
+
+    if(PGO_BASELINE_BINARY)
+      add_custom_target(pgo-benchmark
+        COMMAND sh "${benchmark_script}" "${PGO_BASELINE_BINARY}" "$<TARGET_FILE:${target}>"
+                   "${CMAKE_BINARY_DIR}"
+        WORKING_DIRECTORY "${CMAKE_BINARY_DIR}"
+        COMMENT "Comparing the input benchmarks with ${PGO_BASELINE_BINARY}"
+        VERBATIM
+      )
+      add_dependencies(pgo-benchmark ${target})
+    endif()
+  endif()
+endfunction()
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Compares the input pipeline of two Projecteur binaries, used by the 'pgo-benchmark' build target.
+#
+# Usage: pgo-benchmark.sh <baseline-binary> <optimized-binary> [work-dir]
+#
+# Runs the input benchmark (--benchmark-input) for each pattern with both binaries, at a rate
+# above what the pipeline can process, and reports the throughput and the median latency of
+# both together with the speedup of the optimized binary.
+
+BASELINE="$1"
+OPTIMIZED="$2"
+WORK_DIR="${3:-.}"
+SECONDS_PER_RUN="${PGO_BENCHMARK_SECONDS:-5}"
+RATE="${PGO_BENCHMARK_RATE:-200000}"
+
+if [ ! -x "$BASELINE" ] || [ ! -x "$OPTIMIZED" ]; then
+  echo "Usage: $0 <baseline-binary> <optimized-binary> [work-dir]" >&2
+  exit 1
+fi
+
+CFG="$WORK_DIR/pgo-benchmark.conf"
+
+# Prints '<throughput> <p50 latency>' of a benchmark run.
+run() {
+  rm -f "$CFG"
+  QT_QPA_PLATFORM=offscreen "$1" --cfg "$CFG" \
+    --benchmark-input "pattern=$2,rate=$RATE,duration=$SECONDS_PER_RUN" 2>/dev/null \
+    | awk '/^throughput:/ { t = $2 } /^latency/ { sub(/^.*p50=/, ""); sub(/ .*$/, ""); p = $0 }
+           END { if (t == "" || p == "") exit 1; print t, p }'
+}
+
+printf "%-13s %14s %14s %8s %13s %13s %8s\n" pattern "baseline f/s" "optimized f/s" speedup \
+       "baseline p50" "optimized p50" speedup
+for pattern in motion press double-press hold; do
+  base=$(run "$BASELINE" $pattern) || { echo "Baseline benchmark failed ($pattern)." >&2; exit 1; }
+  opt=$(run "$OPTIMIZED" $pattern) || { echo "Optimized benchmark failed ($pattern)." >&2; exit 1; }
+  echo "$pattern $base $opt" | awk '{
+    printf "%-13s %14.1f %14.1f %7.2fx %11dus %11dus %7.2fx\n", $1, $2, $4, ($2 > 0 ? $4 / $2 : 0),
+           $3, $5, ($5 > 0 ? $3 / $5 : 0)
+  }'
+done
+rm -f "$CFG"
@@ -0,0 +1,96 @@
+#!/bin/sh
+# PGO training workload for Projecteur, used by the 'pgo-training' build target.
+#
+# Usage: pgo-training.sh <projecteur-binary> <profile-dir> [llvm-profdata]
+#
+# Runs the instrumented binary on the offscreen platform with a separate configuration file:
+#  1. Input replay: synthetic evdev frames of all input benchmark patterns (motion, press,
+#     double-press, hold) are fed through the input pipeline (--benchmark-input), with and
+#     without the real-time input thread.
+#  2. Overlay: the instance is driven deterministically via IPC commands: spot activation,
+#     shape/size/zoom/rotation changes and settings updates.
+# Presenter devices are never connected (--no-devices, implied by --benchmark-input), so the
+# profile does not depend on the hardware of the build machine. HID++ code paths are not
+# trained, there is no synthetic HID++ device.
+
+BIN="$1"
+PROFILE_DIR="$2"
+LLVM_PROFDATA="$3"
+ROUNDS="${PGO_TRAINING_ROUNDS:-20}"
+INPUT_SECONDS="${PGO_TRAINING_INPUT_SECONDS:-3}"
+READY_TIMEOUT="${PGO_TRAINING_READY_TIMEOUT:-30}"
+
+if [ ! -x "$BIN" ] || [ -z "$PROFILE_DIR" ]; then
+  echo "Usage: $0 <projecteur-binary> <profile-dir> [llvm-profdata]" >&2
+  exit 1
+fi
+
+CFG="$PROFILE_DIR/pgo-training.conf"
+rm -f "$CFG"
+
+# --- 1. Input replay
+for pattern in motion press double-press hold; do
+  for thread in "" "--input-thread=on"; do
+    QT_QPA_PLATFORM=offscreen "$BIN" --cfg "$CFG" $thread \
+      --benchmark-input "pattern=$pattern,rate=2000,duration=$INPUT_SECONDS" >/dev/null || exit 1
+  done
+done
+
+# --- 2. Overlay and settings via IPC
+# The instance is ready for commands once it created its local socket (after removing a stale one).
+SOCKET="${TMPDIR:-/tmp}/Projecteur_local_socket"
+MARKER="$PROFILE_DIR/pgo-training.start"
+touch "$MARKER"
+sleep 1 # socket timestamps must be distinguishable from the marker
+
+QT_QPA_PLATFORM=offscreen "$BIN" --cfg "$CFG" --no-devices &
+PID=$!
+
+waited=0
+until [ -S "$SOCKET" ] && [ "$SOCKET" -nt "$MARKER" ]; do
+  if ! kill -0 $PID 2>/dev/null; then
+    echo "Projecteur exited before it was ready for commands." >&2
+    exit 1
+  fi
+  if [ $waited -ge $((READY_TIMEOUT * 10)) ]; then
+    echo "Projecteur not ready for commands after ${READY_TIMEOUT}s." >&2
+    kill $PID
+    exit 1
+  fi
+  sleep 0.1
+  waited=$((waited + 1))
+done
+rm -f "$MARKER"
+
+cmd() {
+  "$BIN" -c "$1" >/dev/null 2>&1
+}
+
+i=0
+while [ $i -lt "$ROUNDS" ]; do
+  for shape in circle square star ngon; do
+    cmd spot=on
+    cmd spot.shape=$shape
+    cmd spot.rotation=$((i * 15 % 360))
+    cmd spot.size.adjust=5
+    cmd spot.size.adjust=-5
+    cmd border=true
+    cmd border.size=$((i % 20 + 1))
+    cmd dot=true
+    cmd zoom=true
+    cmd zoom.factor=2.5
+    cmd zoom=false
+    cmd shade.opacity=0.4
+    cmd spot=toggle
+    cmd spot=toggle
+  done
+  cmd spot=off
+  i=$((i + 1))
+done
+
+cmd quit
+wait $PID
+
+if [ -n "$LLVM_PROFDATA" ]; then
+  "$LLVM_PROFDATA" merge -output="$PROFILE_DIR/projecteur.profdata" "$PROFILE_DIR"/*.profraw
+fi
@@ -0,0 +1,94 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur - See LICENSE.md and README.md
+import QtQuick 2.3
+import QtQuick.Window 2.2
+
+import Projecteur.Utils 1.0 as Utils
+
+// Overlay window for the Qt Quick software renderer (no OpenGL available): The spot is painted by
+// the RasterSpot item, the shade around it by the Shade item; no graphical effects are used.
+Window {
+    id: mainWindow
+    property var screenId: -1
+    readonly property bool spotOnCurrentWindow: ProjecteurApp.currentSpotScreen === screenId
+    property alias desktopPixmap: rasterSpot.pixmap
+
+    width: 300; height: 200
+
+    flags: Qt.FramelessWindowHint | Qt.WindowStaysOnTopHint | Qt.SplashScreen
+
+    color: "transparent"
+
+    // Only the spot shape is rotated, shade and zoom stay screen-aligned.
+    readonly property real spotRotation: Settings.spotRotationAllowed ? Settings.spotRotation : 0
+
+    Item {
+        id: overlayItem
+        anchors.fill: parent
+
+        opacity: ProjecteurApp.overlayVisible ? 1.0 : 0.0
+        Behavior on opacity { PropertyAnimation { easing.type: Easing.OutQuad } }
+
+        Item {
+            anchors.fill: parent
+            MouseArea {
+                id: ma
+
+                readonly property bool calculateMapping: Settings.multiScreenOverlayEnabled && !mainWindow.spotOnCurrentWindow
+                readonly property point globalPos: calculateMapping ? ProjecteurApp.currentCursorPos : Qt.point(0,0)
+                readonly property point mappedPos: calculateMapping ? mainWindow.contentItem.mapFromGlobal(globalPos.x, globalPos.y) : globalPos
+                readonly property int posX: spotOnCurrentWindow ? mouseX : mappedPos.x
+                readonly property int posY: spotOnCurrentWindow ? mouseY : mappedPos.y
+
+                cursorShape: Settings.cursor
+                anchors.fill: parent
+                hoverEnabled: true
+                onClicked: { ProjecteurApp.spotlightWindowClicked() }
+                onExited: { ProjecteurApp.cursorExitedWindow() }
+                onEntered: { ProjecteurApp.cursorEntered(screenId) }
+                onPositionChanged: {
+
+                    if (Settings.multiScreenOverlayEnabled || ProjecteurApp.spotFeedEnabled) {
+                        ProjecteurApp.cursorPositionChanged(
+                            mainWindow.contentItem.mapToGlobal(ma.mouseX, ma.mouseY))
+                    }
+                }
+            }
+        }
+
+        Rectangle {
+            property int spotSize: (mainWindow.height / 100.0) * Settings.spotSize
+            id: centerRect
+            opacity: Settings.shadeOpacity
+            height: spotSize > 50 ? Math.min(spotSize, mainWindow.height) : 50
+            width: height
+            x: ma.posX - width/2
+            y: ma.posY - height/2
+            color: Settings.shadeColor
+            visible: false
+            enabled: false
+        }
+
+        Utils.RasterSpot {
+            id: rasterSpot
+            readonly property real rotationRad: mainWindow.spotRotation * Math.PI / 180.0
+            // Size of the bounding box of the rotated spot shape
+            readonly property real spotExtent: centerRect.width * (Math.abs(Math.cos(rotationRad))
+                                                                   + Math.abs(Math.sin(rotationRad)))
+            settings: Settings
+            anchors.centerIn: centerRect
+            width: spotExtent; height: spotExtent
+            spotRotation: mainWindow.spotRotation
+            zoomVisible: Settings.zoomEnabled && mainWindow.spotOnCurrentWindow
+            zoomCenter: Qt.point(ma.mouseX, ma.mouseY)
+        }
+
+        Utils.Shade {
+            id: shade
+            visible: Settings.showSpotShade
+            color: centerRect.color
+            opacity: centerRect.opacity
+            anchors.fill: parent
+            spotRect: Qt.rect(rasterSpot.x, rasterSpot.y, rasterSpot.width, rasterSpot.height)
+        }
+    }
+} // Window
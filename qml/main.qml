@@ -18,46 +18,16 @@ Window {
 
     color: "transparent"
 
-    readonly property double diagonal: Math.sqrt(Math.pow(Math.max(width, height),2)*2)
+    // Only the spot shape is rotated, shade and zoom stay screen-aligned.
+    readonly property real spotRotation: Settings.spotRotationAllowed ? Settings.spotRotation : 0
 
     Item {
-        id: rotationItem
-        anchors.centerIn: parent
-        width: rotation === 0 ? mainWindow.width : mainWindow.diagonal;
-        height: rotation === 0 ? mainWindow.height : width
-        rotation: Settings.spotRotationAllowed ? Settings.spotRotation : 0
+        id: overlayItem
+        anchors.fill: parent
 
         opacity: ProjecteurApp.overlayVisible ? 1.0 : 0.0
         Behavior on opacity { PropertyAnimation { easing.type: Easing.OutQuad } }
 
-        Item {
-            id: desktopItem
-            anchors.centerIn: centerRect
-            visible: false; enabled: false; clip: true
-            scale: Settings.zoomFactor
-            width: centerRect.width / scale; height: centerRect.height / scale
-
-            Utils.Image {
-                id: desktopImage
-                smooth: rotation == 0 ? false : true
-                rotation: -rotationItem.rotation
-                readonly property real xOffset: Math.floor(parent.width/2.0 + ((rotationItem.width-mainWindow.width)/2))
-                readonly property real yOffset: Math.floor(parent.height/2.0 + ((rotationItem.height-mainWindow.height)/2))
-                x: -ma.mouseX + xOffset
-                y: -ma.mouseY + yOffset
-                width: mainWindow.width; height: mainWindow.height
-            }
-        }
-
-        OpacityMask {
-            visible: Settings.zoomEnabled && mainWindow.spotOnCurrentWindow
-            cached: true
-            anchors.fill: centerRect
-            source: desktopItem
-            maskSource: spotShapeLoader.item
-            enabled: false
-        }
-
         Item {
             anchors.fill: parent
             MouseArea {
@@ -77,7 +47,7 @@ Window {
                 onEntered: { ProjecteurApp.cursorEntered(screenId) }
                 onPositionChanged: {
 
-                    if (Settings.multiScreenOverlayEnabled) {
+                    if (Settings.multiScreenOverlayEnabled || ProjecteurApp.spotFeedEnabled) {
                         ProjecteurApp.cursorPositionChanged(
                             mainWindow.contentItem.mapToGlobal(mouse.x, mouse.y))
                     }
@@ -98,68 +68,133 @@ Window {
             enabled: false
         }
 
-        Loader {
-            id: spotShapeLoader
-            visible: false; enabled: false
+        // Spot, border and zoom layers are rendered with a fixed size (spot size rounded up to the next
+        // power of two) and scaled to the spot size, resizing the spot does not reallocate the
+        // offscreen textures of the masks with each step.
+        Item {
+            id: spotLayer
+            readonly property real rotationRad: mainWindow.spotRotation * Math.PI / 180.0
+            // Size of the bounding box of the rotated spot shape
+            readonly property real spotExtent: centerRect.width * (Math.abs(Math.cos(rotationRad))
+                                                                   + Math.abs(Math.sin(rotationRad)))
+            readonly property int layerSize: Math.pow(2, Math.ceil(Math.log(spotExtent) / Math.LN2))
+            readonly property real layerScale: spotExtent / layerSize
+            readonly property rect spotBounds: Qt.rect(centerRect.x + (centerRect.width - spotExtent) / 2,
+                                                       centerRect.y + (centerRect.height - spotExtent) / 2,
+                                                       spotExtent, spotExtent)
             anchors.centerIn: centerRect
-            width: centerRect.width;  height: width
-            sourceComponent: Qt.createComponent(Settings.spotShape)
-        }
-
-        OpacityMask {
-            id: spot
-            visible: Settings.showSpotShade
-            opacity: centerRect.opacity
-            cached: true
-            invert: true
-            anchors.fill: centerRect
-            source: centerRect
-            maskSource: spotShapeLoader.item
+            width: layerSize; height: width
+            scale: layerScale
             enabled: false
-        }
 
-        Loader {
-            id: borderShapeLoader
-            anchors.centerIn: centerRect
-            width: centerRect.width;  height: width
-            visible: false; enabled: false
-            sourceComponent: spotShapeLoader.sourceComponent
-            onStatusChanged: {
-                if (status == Loader.Ready) {
-                    borderShapeLoader.item.color = Qt.binding(function(){ return Settings.borderColor; })
+            Item {
+                id: desktopSource
+                anchors.fill: parent
+                visible: false; enabled: false
+
+                Item {
+                    id: desktopItem
+                    anchors.centerIn: parent
+                    clip: true
+                    scale: Settings.zoomFactor / spotLayer.layerScale
+                    width: parent.width / scale; height: parent.height / scale
+
+                    Utils.Image {
+                        id: desktopImage
+                        smooth: false
+                        magnification: Settings.zoomFactor
+                        readonly property real xOffset: Math.floor(parent.width/2.0)
+                        readonly property real yOffset: Math.floor(parent.height/2.0)
+                        x: -ma.mouseX + xOffset
+                        y: -ma.mouseY + yOffset
+                        width: mainWindow.width; height: mainWindow.height
+                    }
                 }
             }
-        }
 
-        Item {
-            id: borderShapeMask
-            anchors.centerIn: centerRect
-            width: centerRect.width;  height: width
-            enabled: false; visible: false
+            OpacityMask {
+                visible: Settings.zoomEnabled && mainWindow.spotOnCurrentWindow
+                cached: true
+                anchors.fill: parent
+                source: desktopSource
+                maskSource: spotShapeSource
+                enabled: false
+            }
+
+            // The only instance of the spot shape, all masks and the border share its texture.
+            // Masks only use the alpha channel, the shape color is used for the border.
             Item {
-                id: borderShapeScaled
-                anchors.centerIn: parent
-                width: parent.width; height: width
-                scale: (100 - Settings.borderSize) * 1.0 / 100.0
-                property Component component: borderShapeLoader.sourceComponent
-                property QtObject innerObject
-                onComponentChanged: {
-                    if (innerObject) innerObject.destroy()
-                    innerObject = component.createObject(borderShapeScaled, {visible: true})
+                id: spotShape
+                anchors.fill: parent
+                visible: false; enabled: false
+
+                Loader {
+                    id: spotShapeLoader
+                    enabled: false
+                    anchors.centerIn: parent
+                    width: parent.width * centerRect.width / spotLayer.spotExtent; height: width
+                    rotation: mainWindow.spotRotation
+                    sourceComponent: Qt.createComponent(Settings.spotShape)
+                    onStatusChanged: {
+                        if (status == Loader.Ready) {
+                            spotShapeLoader.item.visible = true
+                            spotShapeLoader.item.color = Qt.binding(function(){ return Settings.borderColor; })
+                        }
+                    }
                 }
             }
-        }
 
-        OpacityMask {
-            id: spotBorder
-            visible: Settings.showBorder && Settings.borderSize > 0
-            opacity: Settings.borderOpacity
-            cached: true
-            invert: true
-            anchors.fill: centerRect
-            source: borderShapeLoader.item
-            maskSource: borderShapeMask
-            enabled: false
+            ShaderEffectSource {
+                id: spotShapeSource
+                visible: false; enabled: false
+                anchors.fill: parent
+                sourceItem: spotShape
+            }
+
+            Rectangle {
+                id: shadeSource
+                anchors.fill: parent
+                color: centerRect.color
+                visible: false; enabled: false
+            }
+
+            OpacityMask {
+                id: spot
+                visible: Settings.showSpotShade
+                opacity: centerRect.opacity
+                cached: true
+                invert: true
+                anchors.fill: parent
+                source: shadeSource
+                maskSource: spotShapeSource
+                enabled: false
+            }
+
+            Item {
+                id: borderShapeMask
+                anchors.fill: parent
+                enabled: false; visible: false
+                // Draws the shared shape texture, scaled down by the border size
+                ShaderEffect {
+                    id: borderShapeScaled
+                    anchors.centerIn: parent
+                    width: parent.width; height: width
+                    scale: (100 - Settings.borderSize) * 1.0 / 100.0
+                    property variant source: spotShapeSource
+                }
+            }
+
+            OpacityMask {
+                id: spotBorder
+                visible: Settings.showBorder && Settings.borderSize > 0
+                opacity: Settings.borderOpacity
+                cached: true
+                invert: true
+                anchors.fill: parent
+                source: spotShapeSource
+                maskSource: borderShapeMask
+                enabled: false
+            }
         }
 
         Rectangle {
@@ -174,40 +209,13 @@ Window {
             enabled: false
         }
 
-        Rectangle {
-            id: topRect
-            visible: spot.visible
-            color: centerRect.color
-            opacity: centerRect.opacity
-            anchors{ top: parent.top; bottom: centerRect.top; left: parent.left; right: parent.right }
-            enabled: false
-        }
-
-        Rectangle {
-            id: bottomRect
+        Utils.Shade {
+            id: shade
             visible: spot.visible
             color: centerRect.color
             opacity: centerRect.opacity
-            anchors{ top: centerRect.bottom; bottom: parent.bottom; left: parent.left; right: parent.right }
-            enabled: false
-        }
-
-        Rectangle {
-            id: leftRect
-            visible: spot.visible
-            color: centerRect.color
-            opacity: centerRect.opacity
-            anchors{ top: topRect.bottom; bottom: bottomRect.top; left: parent.left; right: centerRect.left }
-            enabled: false
-        }
-
-        Rectangle {
-            id: rightRect
-            visible: spot.visible
-            color: centerRect.color
-            opacity: centerRect.opacity
-            anchors{ top: topRect.bottom; bottom: bottomRect.top; left: centerRect.right; right: parent.right }
-            enabled: false
+            anchors.fill: parent
+            spotRect: spotLayer.spotBounds
         }
     }
 } // Window
@@ -0,0 +1,72 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "device-cache.h"
+
+#include "deviceinput.h"
+#include "logging.h"
+#include "metrics.h"
+
+#include <algorithm>
+
+DECLARE_LOGGING_CATEGORY(device)
+
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  metrics::Counter& evictionsCounter()
+  {
+    static auto& c = metrics::counter("projecteur_device_cache_evictions",
+                                      "Device states evicted from the device state cache.");
+    return c;
+  }
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+DeviceStateCache::DeviceStateCache(size_t capacity)
+  : m_capacity(std::max<size_t>(capacity, 1))
+{}
+
+// -------------------------------------------------------------------------------------------------
+DeviceStateCache::Entries::iterator DeviceStateCache::findEntry(const DeviceId& id)
+{
+  return std::find_if(m_entries.begin(), m_entries.end(),
+                      [&id](const Entries::value_type& e) { return e.first == id; });
+}
+
+// -------------------------------------------------------------------------------------------------
+DeviceStateCache::Entry& DeviceStateCache::entry(const DeviceId& id)
+{
+  const auto it = findEntry(id);
+  if (it != m_entries.end())
+  {
+    m_entries.splice(m_entries.begin(), m_entries, it);
+    return m_entries.front().second;
+  }
+
+  m_entries.emplace_front(id, Entry());
+  while (m_entries.size() > m_capacity)
+  {
+    const auto& evicted = m_entries.back().first;
+    logDebug(device) << QString("Evicted cached state of device %1:%2")
+                        .arg(logging::hexId(evicted.vendorId), logging::hexId(evicted.productId));
+    evictionsCounter().inc();
+    m_entries.pop_back();
+  }
+  return m_entries.front().second;
+}
+
+// -------------------------------------------------------------------------------------------------
+const DeviceStateCache::Entry* DeviceStateCache::find(const DeviceId& id) const
+{
+  const auto it = std::find_if(m_entries.cbegin(), m_entries.cend(),
+                               [&id](const Entries::value_type& e) { return e.first == id; });
+  return (it == m_entries.cend()) ? nullptr : &it->second;
+}
+
+// -------------------------------------------------------------------------------------------------
+std::shared_ptr<InputMapper> DeviceStateCache::takeInputMapper(const DeviceId& id)
+{
+  const auto it = findEntry(id);
+  if (it == m_entries.end()) { return nullptr; }
+  return std::move(it->second.inputMapper);
+}
@@ -0,0 +1,53 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include "device-defs.h"
+#include "hidpp.h"
+
+#include <QVariantMap>
+
+#include <list>
+#include <memory>
+#include <utility>
+
+class InputMapper;
+
+// -------------------------------------------------------------------------------------------------
+/// Least recently used cache for device state that survives disconnects.
+///
+/// Restoring a device from the settings or from the device itself is comparatively expensive:
+/// the input mapping configuration is deserialized and compiled again and the HID++ features are
+/// resolved with requests to the device. Devices that reconnect frequently (USB hubs, docks,
+/// power saving) are restored from memory instead.
+class DeviceStateCache
+{
+public:
+  struct Entry {
+    std::shared_ptr<InputMapper> inputMapper; ///< Configured input mapper of a disconnected device
+    HIDPP::FeatureSet::Snapshot featureSet;   ///< Resolved HID++ features
+    QVariantMap uiState;                      ///< State of the device preferences page
+  };
+
+  static constexpr size_t DefaultCapacity = 8;
+
+  explicit DeviceStateCache(size_t capacity = DefaultCapacity);
+
+  /// Entry for the device, created if it does not exist yet. The entry becomes the most recently
+  /// used entry, which can evict the least recently used entry.
+  Entry& entry(const DeviceId& id);
+  /// Entry for the device or nullptr, does not change the order of the entries.
+  const Entry* find(const DeviceId& id) const;
+  /// Takes the input mapper out of the entry for the device.
+  std::shared_ptr<InputMapper> takeInputMapper(const DeviceId& id);
+
+  size_t size() const { return m_entries.size(); }
+  size_t capacity() const { return m_capacity; }
+
+private:
+  using Entries = std::list<std::pair<DeviceId, Entry>>;
+  Entries::iterator findEntry(const DeviceId& id);
+
+  const size_t m_capacity;
+  Entries m_entries; // most recently used entry first
+};
@@ -6,29 +6,253 @@
 #include "deviceinput.h"
 #include "enum-helper.h"
 #include "logging.h"
+#include "metrics.h"
+#include "watchdog.h"
+
+#include <algorithm>
 
 #include <unistd.h>
 
+#include <QPointer>
 #include <QSocketNotifier>
-#include <QTimer>
 
 DECLARE_LOGGING_CATEGORY(hid)
 
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  struct HidppMetrics
+  {
+    metrics::Counter& requests = metrics::counter("projecteur_hidpp_requests",
+                                                  "HID++ requests sent to devices.");
+    metrics::Counter& replies = metrics::counter("projecteur_hidpp_replies",
+                                                 "HID++ replies matched to a request.");
+    metrics::Counter& timeouts = metrics::counter("projecteur_hidpp_timeouts",
+                                                  "HID++ requests without reply before timeout.");
+    metrics::Counter& hidppErrors = metrics::counter("projecteur_hidpp_errors",
+                                                     "HID++ requests that failed.", {{"kind", "hidpp"}});
+    metrics::Counter& writeErrors = metrics::counter("projecteur_hidpp_errors",
+                                                     "HID++ requests that failed.", {{"kind", "write"}});
+    metrics::Counter& notifications = metrics::counter("projecteur_hidpp_notifications",
+                                                       "HID++ notifications received.");
+    metrics::Gauge& pending = metrics::gauge("projecteur_hidpp_pending_requests",
+                                             "HID++ requests waiting for a reply.");
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  HidppMetrics& hidppMetrics()
+  {
+    static HidppMetrics m;
+    return m;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Features resolved on device initialization, other features are only queried for diagnostics.
+  const HIDPP::FeatureSet::FeatureCodes usedFeatures_ = {
+    HIDPP::FeatureCode::Reset,
+    HIDPP::FeatureCode::BatteryStatus,
+    HIDPP::FeatureCode::PresenterControl,
+    HIDPP::FeatureCode::ReprogramControlsV4,
+    HIDPP::FeatureCode::PointerSpeed,
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  /// Reprogrammable buttons of the Logitech Spotlight
+  struct SpotlightButton
+  {
+    uint16_t controlId;
+    uint16_t keyCode; ///< Key of the regular input reports of the button
+    DeviceFlag holdFlag;
+    SpecialKeys::Key hold;
+    SpecialKeys::Key holdMove;
+  };
+
+  const std::array<SpotlightButton, 2> spotlightButtons_ = {{
+    { HIDPP::ReprogramControls::ControlId::Next, KEY_RIGHT, DeviceFlag::NextHold,
+      SpecialKeys::Key::NextHold, SpecialKeys::Key::NextHoldMove },
+    { HIDPP::ReprogramControls::ControlId::Back, KEY_LEFT, DeviceFlag::BackHold,
+      SpecialKeys::Key::BackHold, SpecialKeys::Key::BackHoldMove },
+  }};
+
+  // -----------------------------------------------------------------------------------------------
+  /// Key code if the key event contains a single key event with the given value, -1 otherwise.
+  int singleKey(const KeyEvent& ke, int32_t value)
+  {
+    int code = -1;
+    for (const auto& die : ke)
+    {
+      if (die.type == EV_SYN || die.type == EV_MSC) { continue; }
+      if (die.type != EV_KEY || die.value != value || code != -1) { return -1; }
+      code = die.code;
+    }
+    return code;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Button of the key event sequence, if it is a single press and release of a button.
+  const SpotlightButton* buttonTap(const KeyEventSequence& kes)
+  {
+    if (kes.size() != 2) { return nullptr; }
+
+    const int code = singleKey(kes[0], 1);
+    if (code == -1 || singleKey(kes[1], 0) != code) { return nullptr; }
+
+    const auto it = std::find_if(spotlightButtons_.cbegin(), spotlightButtons_.cend(),
+    [code](const SpotlightButton& button) { return button.keyCode == code; });
+    return (it != spotlightButtons_.cend()) ? &(*it) : nullptr;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  bool usesKey(const KeyEventSequence& kes, uint16_t code)
+  {
+    return std::any_of(kes.cbegin(), kes.cend(), [code](const KeyEvent& ke) {
+      return std::any_of(ke.cbegin(), ke.cend(), [code](const DeviceInputEvent& die) {
+        return die.type == EV_KEY && die.code == code;
+      });
+    });
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Control reporting of the Spotlight buttons for an input mapping configuration.
+  ///
+  /// Without firmware remapping all buttons are diverted, which enables the hold and hold + move
+  /// Hid++ notifications. With firmware remapping, taps of a button that are mapped to the key of
+  /// another button are remapped by the device; this is only done if no remaining mapping uses
+  /// the keys of both buttons, since the host would not be able to tell them apart anymore.
+  /// Buttons are only diverted if there are hold mappings for them. The input sequences handled
+  /// by the device are returned in fwSequences.
+  std::vector<SubHidppConnection::ControlReporting> controlReporting(
+    const InputMapConfig& config, bool firmwareRemapping, DeviceFlags deviceFlags,
+    std::vector<KeyEventSequence>& fwSequences)
+  {
+    struct Remap {
+      const SpotlightButton* from;
+      const SpotlightButton* to;
+      KeyEventSequence sequence;
+    };
+
+    std::vector<Remap> remaps;
+    if (firmwareRemapping)
+    {
+      for (const auto& item : config)
+      {
+        const auto action = std::dynamic_pointer_cast<KeySequenceAction>(item.second.action);
+        if (!action) { continue; }
+
+        const auto from = buttonTap(item.first);
+        const auto to = buttonTap(action->keySequence.nativeSequence());
+        if (from && to && from != to) { remaps.push_back({from, to, item.first}); }
+      }
+    }
+
+    const auto isRemapped = [&remaps](const KeyEventSequence& kes) {
+      return std::any_of(remaps.cbegin(), remaps.cend(),
+                         [&kes](const Remap& r) { return r.sequence == kes; });
+    };
+
+    const auto usesHold = [](const KeyEventSequence& kes, const SpotlightButton& button) {
+      return usesKey(kes, to_integral(button.hold)) || usesKey(kes, to_integral(button.holdMove));
+    };
+
+    const auto conflicts = [&](const Remap& r) {
+      return std::any_of(config.cbegin(), config.cend(),
+      [&](const InputMapConfig::value_type& item) {
+        if (isRemapped(item.first)) { return false; }
+        return usesKey(item.first, r.from->keyCode) || usesKey(item.first, r.to->keyCode)
+               || usesHold(item.first, *r.from);
+      });
+    };
+
+    for (auto it = remaps.begin(); it != remaps.end();)
+    {
+      if (conflicts(*it)) {
+        // Start over, since the removed remap can conflict with the remaining ones now.
+        remaps.erase(it);
+        it = remaps.begin();
+      } else {
+        ++it;
+      }
+    }
+
+    std::vector<SubHidppConnection::ControlReporting> result;
+    fwSequences.clear();
+    for (const auto& button : spotlightButtons_)
+    {
+      if (!(deviceFlags & button.holdFlag)) { continue; }
+
+      SubHidppConnection::ControlReporting reporting;
+      reporting.controlId = button.controlId;
+      reporting.remapTo = button.controlId;
+
+      const auto it = std::find_if(remaps.cbegin(), remaps.cend(),
+                                   [&button](const Remap& r) { return r.from == &button; });
+      if (it != remaps.cend())
+      {
+        reporting.remapTo = it->to->controlId;
+        fwSequences.push_back(it->sequence);
+      }
+
+      reporting.diverted = !firmwareRemapping
+                           || std::any_of(config.cbegin(), config.cend(),
+                              [&](const InputMapConfig::value_type& item) {
+                                return usesHold(item.first, button);
+                              });
+      result.push_back(reporting);
+    }
+
+    return result;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  HIDPP::Message setCidReportingMessage(uint8_t featureIndex,
+                                        const SubHidppConnection::ControlReporting& reporting)
+  {
+    using namespace HIDPP::ReprogramControls;
+    const uint8_t flags = reporting.diverted
+                          ? (Flags::Divert | Flags::DivertValid | Flags::RawXY | Flags::RawXYValid)
+                          : (Flags::DivertValid | Flags::RawXYValid);
+
+    return HIDPP::Message(HIDPP::Message::Type::Long, HIDPP::DeviceIndex::WirelessDevice1,
+                          featureIndex, SetCidReporting,
+                          HIDPP::Message::Data{static_cast<uint8_t>(reporting.controlId >> 8),
+                                               static_cast<uint8_t>(reporting.controlId & 0xff),
+                                               flags,
+                                               static_cast<uint8_t>(reporting.remapTo >> 8),
+                                               static_cast<uint8_t>(reporting.remapTo & 0xff)});
+  }
+} // end anonymous namespace
+
 // -------------------------------------------------------------------------------------------------
 SubHidppConnection::SubHidppConnection(SubHidrawConnection::Token token,
                                        const DeviceId& id, const DeviceScan::SubDevice& sd)
   : SubHidrawConnection(token, id, sd)
   , m_featureSet(this)
-  , m_requestCleanupTimer(new QTimer(this))
+  , m_requestCleanupTimer(new timing::Timer(this))
 {
   constexpr int cleanUpTimerInterval = 500;
   m_requestCleanupTimer->setInterval(cleanUpTimerInterval);
   m_requestCleanupTimer->setSingleShot(false);
-  connect(m_requestCleanupTimer, &QTimer::timeout, this, &SubHidppConnection::clearTimedOutRequests);
+  connect(m_requestCleanupTimer, &timing::Timer::timeout, this, &SubHidppConnection::clearTimedOutRequests);
 }
 
 // -------------------------------------------------------------------------------------------------
-SubHidppConnection::~SubHidppConnection() = default;
+SubHidppConnection::~SubHidppConnection()
+{
+  hidppMetrics().pending.dec(static_cast<int64_t>(m_requests.size()));
+  if (m_inputMapper) { m_inputMapper->setFirmwareMappedSequences({}); }
+
+  // Do not leave remapped buttons behind on the device, e.g. after Projecteur exits. Written
+  // synchronously without waiting for the responses, this fails silently if the device is gone.
+  const auto rcIndex = m_featureSet.featureIndex(HIDPP::FeatureCode::ReprogramControlsV4);
+  if (!rcIndex) { return; }
+
+  for (auto reporting : m_controlReporting)
+  {
+    if (reporting.remapTo == reporting.controlId) { continue; }
+    reporting.remapTo = reporting.controlId;
+    reporting.diverted = false;
+    sendData(setCidReportingMessage(rcIndex, reporting));
+  }
+}
 
 // -------------------------------------------------------------------------------------------------
 const char* toString(SubHidppConnection::ReceiverState s, bool withClass)
@@ -175,6 +399,8 @@ void SubHidppConnection::sendRequest(HIDPP::Message msg, RequestResultCallback r
         return;
       }
 
+      hidppMetrics().writeErrors.inc();
+      hidppMetrics().pending.dec();
       if (it->callBack) { it->callBack(result, HIDPP::Message()); }
       m_requests.erase(it);
     }));
@@ -183,8 +409,10 @@ void SubHidppConnection::sendRequest(HIDPP::Message msg, RequestResultCallback r
 
     // Place request in request list with a timeout
     m_requests.emplace_back(RequestEntry{
-      std::move(msg), std::chrono::steady_clock::now() + std::chrono::milliseconds{hidppMsgTimeoutMs},
+      std::move(msg), timing::now() + std::chrono::milliseconds{hidppMsgTimeoutMs},
       std::move(cb)});
+    hidppMetrics().requests.inc();
+    hidppMetrics().pending.inc();
 
     // Run cleanup timer if not already active
     if (!m_requestCleanupTimer->isActive()) { m_requestCleanupTimer->start(); }
@@ -357,6 +585,14 @@ std::shared_ptr<SubHidppConnection> SubHidppConnection::create(const DeviceScan:
   connect(connection->socketReadNotifier(), &QSocketNotifier::activated, &*connection,
           &SubHidppConnection::onHidppDataAvailable);
 
+  if (const auto im = connection->m_inputMapper.get())
+  {
+    connect(im, &InputMapper::configurationChanged, &*connection,
+            &SubHidppConnection::updateControlReporting);
+    connect(im, &InputMapper::firmwareRemappingChanged, &*connection,
+            &SubHidppConnection::updateControlReporting);
+  }
+
   connection->postTask([c = &*connection]() { c->subDeviceInit(); });
   return connection;
 }
@@ -571,7 +807,7 @@ void SubHidppConnection::initPresenter(std::function<void(PresenterState)> cb)
 
     setPresenterState(PresenterState::Initializing);
 
-    m_featureSet.initFromDevice(deviceId(), makeSafeCallback(
+    m_featureSet.initFromDevice(deviceId(), usedFeatures_, makeSafeCallback(
     [this, cb=std::move(cb)](HIDPP::FeatureSet::State state) mutable
     {
       using FState = HIDPP::FeatureSet::State;
@@ -589,7 +825,7 @@ void SubHidppConnection::initPresenter(std::function<void(PresenterState)> cb)
         }
         case FState::Initialized:
         {
-          logDebug(hid) << tr("Received %1 supported features from device. (%2)")
+          logDebug(hid) << tr("Resolved %1 supported features of device. (%2)")
                            .arg(m_featureSet.featureCount()).arg(path());
 
           registerForFeatureNotifications();
@@ -635,27 +871,22 @@ void SubHidppConnection::initFeatures(
     });
   }
 
-  // Enable Next and back button on hold functionality.
+  // Enable Next and back button on hold functionality and firmware remapping of buttons.
   if (const auto contrFeatureIndex = m_featureSet.featureIndex(FeatureCode::ReprogramControlsV4))
   {
-    if (hasFlags(DeviceFlags::NextHold))
-    {
-      batch.emplace(RequestBatchItem {
-        Message(Message::Type::Long, DeviceIndex::WirelessDevice1, contrFeatureIndex, 3,
-                Message::Data{0x00, 0xda, 0x33}),
-        [resultMap](MsgResult res, Message&& /* msg */) {
-          resultMap->emplace(FeatureCode::ReprogramControlsV4, res);
-        }
-      });
-    }
+    std::vector<KeyEventSequence> fwSequences;
+    m_controlReporting = controlReporting(m_inputMapper->configuration(),
+                                          m_inputMapper->firmwareRemapping(),
+                                          flags(), fwSequences);
+    m_inputMapper->setFirmwareMappedSequences(std::move(fwSequences));
 
-    if (hasFlags(DeviceFlags::BackHold))
+    for (const auto& reporting : m_controlReporting)
     {
       batch.emplace(RequestBatchItem {
-        Message(Message::Type::Long, DeviceIndex::WirelessDevice1, contrFeatureIndex, 3,
-                Message::Data{0x00, 0xdc, 0x33}),
-        [resultMap](MsgResult res, Message&& /* msg */) {
+        setCidReportingMessage(contrFeatureIndex, reporting),
+        [resultMap, self=QPointer<SubHidppConnection>(this)](MsgResult res, Message&& /* msg */) {
           resultMap->emplace(FeatureCode::ReprogramControlsV4, res);
+          if (res != MsgResult::Ok && self) { self->resetControlReporting(); }
         }
       });
     }
@@ -679,6 +910,79 @@ void SubHidppConnection::initFeatures(
   });
 }
 
+// -------------------------------------------------------------------------------------------------
+void SubHidppConnection::updateControlReporting()
+{
+  using namespace HIDPP;
+
+  // Control reporting is (re)programmed with the initialization of the device features.
+  if (m_presenterState != PresenterState::Initialized_Online) { return; }
+
+  const auto rcIndex = m_featureSet.featureIndex(FeatureCode::ReprogramControlsV4);
+  if (!rcIndex) { return; }
+
+  std::vector<KeyEventSequence> fwSequences;
+  auto reporting = controlReporting(m_inputMapper->configuration(),
+                                    m_inputMapper->firmwareRemapping(),
+                                    flags(), fwSequences);
+  if (reporting == m_controlReporting) { return; }
+
+  logDebug(hid) << tr("Updating control reporting, %1 input sequences handled by the device. (%2)")
+                   .arg(fwSequences.size()).arg(path());
+
+  m_controlReporting = std::move(reporting);
+  m_inputMapper->setFirmwareMappedSequences(std::move(fwSequences));
+
+  RequestBatch batch;
+  for (const auto& cr : m_controlReporting) {
+    batch.emplace(RequestBatchItem{ setCidReportingMessage(rcIndex, cr), nullptr });
+  }
+
+  sendRequestBatch(std::move(batch), makeSafeCallback([this](std::vector<MsgResult>&& results)
+  {
+    const bool ok = std::all_of(results.cbegin(), results.cend(),
+                                [](MsgResult res) { return res == MsgResult::Ok; });
+    if (ok) { return; }
+
+    logWarn(hid) << tr("Setting the control reporting failed, input mapping is handled by "
+                          "the host. (%1)").arg(path());
+    resetControlReporting();
+  }));
+}
+
+// -------------------------------------------------------------------------------------------------
+void SubHidppConnection::resetControlReporting()
+{
+  using namespace HIDPP;
+
+  // Already reset, e.g. for another failed request of the same batch.
+  if (m_controlReporting.empty()) { return; }
+  m_controlReporting.clear();
+  m_inputMapper->setFirmwareMappedSequences({});
+
+  const auto rcIndex = m_featureSet.featureIndex(FeatureCode::ReprogramControlsV4);
+  if (!rcIndex) { return; }
+
+  // Requests that succeeded before the failure left controls remapped in the device; the host
+  // mapping must not be applied to presses that the device already remapped.
+  std::vector<KeyEventSequence> fwSequences;
+  const auto hostReporting = controlReporting(m_inputMapper->configuration(), false, flags(),
+                                              fwSequences);
+  RequestBatch batch;
+  for (const auto& cr : hostReporting) {
+    batch.emplace(RequestBatchItem{ setCidReportingMessage(rcIndex, cr), nullptr });
+  }
+
+  sendRequestBatch(std::move(batch), makeSafeCallback([this](std::vector<MsgResult>&& results)
+  {
+    const bool ok = std::all_of(results.cbegin(), results.cend(),
+                                [](MsgResult res) { return res == MsgResult::Ok; });
+    if (ok) { return; }
+
+    logWarn(hid) << tr("Removing the button remapping from the device failed. (%1)").arg(path());
+  }), true /* continue on error */);
+}
+
 // -------------------------------------------------------------------------------------------------
 void SubHidppConnection::updateDeviceFlags()
 {
@@ -853,6 +1157,21 @@ void SubHidppConnection::triggerBattyerInfoUpdate()
   }));
 }
 
+// -------------------------------------------------------------------------------------------------
+void SubHidppConnection::enumerateFeatures()
+{
+  m_featureSet.enumerateFeatures(deviceId(), makeSafeCallback([this](bool success)
+  {
+    if (success) { emit featureTableChanged(); }
+  }));
+}
+
+// -------------------------------------------------------------------------------------------------
+bool SubHidppConnection::restoreFeatureSet(const HIDPP::FeatureSet::Snapshot& snapshot)
+{
+  return m_featureSet.restore(snapshot);
+}
+
 // -------------------------------------------------------------------------------------------------
 const HIDPP::BatteryInfo& SubHidppConnection::batteryInfo() const {
   return m_batteryInfo;
@@ -976,6 +1295,7 @@ void SubHidppConnection::checkAndUpdatePresenterState(std::function<void(Present
 // -------------------------------------------------------------------------------------------------
 void SubHidppConnection::onHidppDataAvailable(int fd)
 {
+  const watchdog::Zone zone("SubHidppConnection::onHidppDataAvailable");
   // size_t{HIDPP::Message } .. to make clang-tidy happy
   HIDPP::Message msg(std::vector<uint8_t>(size_t{HIDPP::Message::LONG_MSG_SIZE}));
   const auto res = ::read(fd, msg.data(), msg.dataSize());
@@ -1008,6 +1328,8 @@ void SubHidppConnection::onHidppDataAvailable(int fd)
     {
       logDebug(hid) << tr("Received hiddpp error with code = %1 on")
                        .arg(to_integral(msg.errorCode())) << path() << "(" << msg.hex() << ")";
+      hidppMetrics().hidppErrors.inc();
+      hidppMetrics().pending.dec();
       if (it->callBack) {
         it->callBack(MsgResult::HidppError, std::move(msg));
       }
@@ -1031,6 +1353,8 @@ void SubHidppConnection::onHidppDataAvailable(int fd)
     // Found matching request
     logDebug(hid) << tr("Received %1 bytes on").arg(msg.size()) << path()
                   << "(" << msg.hex() << ")";
+    hidppMetrics().replies.inc();
+    hidppMetrics().pending.dec();
     if (it->callBack) {
       it->callBack(MsgResult::Ok, std::move(msg));
     }
@@ -1041,6 +1365,8 @@ void SubHidppConnection::onHidppDataAvailable(int fd)
     // Event/Notification
     // logDebug(hid) << tr("Received notification (%1) on %2").arg(msg.hex()).arg(path());
 
+    hidppMetrics().notifications.inc();
+
     // Notify subscribers
     const auto& callbackList = m_notificationSubscribers[msg.featureIndex()];
     for ( const auto& subscriber : callbackList) {
@@ -1058,11 +1384,13 @@ void SubHidppConnection::onHidppDataAvailable(int fd)
 
 // -------------------------------------------------------------------------------------------------
 void SubHidppConnection::clearTimedOutRequests() {
-  const auto now = std::chrono::steady_clock::now();
+  const auto now = timing::now();
   m_requests.remove_if([&now](const RequestEntry& entry) {
     if (now <= entry.validUntil) {
       return false;
     }
+    hidppMetrics().timeouts.inc();
+    hidppMetrics().pending.dec();
     if (entry.callBack) {
       entry.callBack(MsgResult::Timeout, HIDPP::Message());
     }
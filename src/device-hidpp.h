@@ -4,12 +4,11 @@
 
 #include "device.h"
 #include "hidpp.h"
+#include "timing.h"
 
-#include <chrono>
 #include <list>
 #include <unordered_map>
 
-class QTimer;
 
 // -------------------------------------------------------------------------------------------------
 /// Hid++ connection class
@@ -66,6 +65,12 @@ public:
   PresenterState presenterState() const;
   ReceiverState receiverState() const;
   const HIDPP::FeatureSet& featureSet() { return m_featureSet; }
+  /// Reads the complete feature table from the device, featureTableChanged() is emitted
+  /// when done. Only the features used by Projecteur are resolved on initialization.
+  void enumerateFeatures();
+  /// Restores the feature set of a previous connection to the same device on initialization,
+  /// instead of resolving the features again - unless the device firmware changed.
+  bool restoreFeatureSet(const HIDPP::FeatureSet::Snapshot& snapshot);
 
   HIDPP::ProtocolVersion protocolVersion() const;
   void triggerBattyerInfoUpdate();
@@ -76,10 +81,21 @@ public:
   /// Set device pointer speed - speed needs to be in the range [0-9]
   void setPointerSpeed(uint8_t speed, RequestResultCallback cb);
 
+  /// Reporting of a reprogrammable control (ReprogramControlsV4).
+  struct ControlReporting {
+    uint16_t controlId = 0;
+    bool diverted = false; ///< Presses are sent as Hid++ notifications (e.g. for hold + move)
+    uint16_t remapTo = 0;  ///< Control the device reports instead, the control itself if not remapped
+    bool operator==(const ControlReporting& o) const {
+      return std::tie(controlId, diverted, remapTo) == std::tie(o.controlId, o.diverted, o.remapTo);
+    }
+  };
+
 signals:
   void receiverStateChanged(ReceiverState);
   void presenterStateChanged(PresenterState);
   void featureSetInitialized();
+  void featureTableChanged();
 
   void batteryInfoChanged(const HIDPP::BatteryInfo&);
 
@@ -88,6 +104,12 @@ private:
   void initReceiver(std::function<void(ReceiverState)>);
   void initPresenter(std::function<void(PresenterState)>);
   void updateDeviceFlags();
+  /// Programs the control reporting for the current input mapper configuration, see
+  /// InputMapper::firmwareRemapping.
+  void updateControlReporting();
+  /// Removes all firmware remaps from the device after a failed update of the control reporting
+  /// and lets the host handle all mappings.
+  void resetControlReporting();
   void registerForUsbNotifications();
   void registerForFeatureNotifications();
   /// Initializes features. Returns a map of initalized features and the result from it.
@@ -118,16 +140,17 @@ private:
 
   ReceiverState m_receiverState = ReceiverState::Uninitialized;
   PresenterState m_presenterState = PresenterState::Uninitialized;
+  std::vector<ControlReporting> m_controlReporting; ///< Last control reporting sent to the device
 
   /// A request entry for request messages sent to the device.
   struct RequestEntry {
     HIDPP::Message request;
-    std::chrono::time_point<std::chrono::steady_clock> validUntil;
+    timing::TimePoint validUntil;
     RequestResultCallback callBack;
   };
 
   std::list<RequestEntry> m_requests;
-  QTimer* m_requestCleanupTimer = nullptr;
+  timing::Timer* m_requestCleanupTimer = nullptr;
 
   struct Subscriber { QObject* object = nullptr; uint8_t function; NotificationCallback cb; };
   std::unordered_map<uint8_t, std::list<Subscriber>> m_notificationSubscribers;
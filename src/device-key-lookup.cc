@@ -5,6 +5,8 @@
 
 #include "enum-helper.h"
 
+#include <QStringList>
+
 #include <linux/input.h>
 
 #include <unordered_map>
@@ -75,4 +77,43 @@ const QString& lookup(const DeviceId& dId, const DeviceInputEvent& die)
   static const QString notFound;
   return notFound;
 }
-} // end namespace KeyName
\ No newline at end of file
+
+// -------------------------------------------------------------------------------------------------
+QChar pressChar()
+{
+  return QChar(0x2193); // ↓
+}
+
+// -------------------------------------------------------------------------------------------------
+QChar releaseChar()
+{
+  return QChar(0x2191); // ↑
+}
+
+// -------------------------------------------------------------------------------------------------
+const DeviceInputEvent& keyEventInput(const KeyEvent& ke)
+{
+  return (ke.back().code != SYN_REPORT) ? ke.back() : ke.front();
+}
+
+// -------------------------------------------------------------------------------------------------
+QString eventName(const DeviceId& dId, const DeviceInputEvent& die)
+{
+  const auto& lookupName = lookup(dId, die);
+  return lookupName.isEmpty() ? QString::number(die.code, 16) : lookupName;
+}
+
+// -------------------------------------------------------------------------------------------------
+QString sequenceText(const DeviceId& dId, const KeyEventSequence& kes)
+{
+  QStringList events;
+  for (const auto& ke : kes)
+  {
+    if (ke.empty()) { continue; }
+    const auto& die = keyEventInput(ke);
+    events.push_back(QString("[%1%2]").arg(eventName(dId, die))
+                                      .arg(die.value ? pressChar() : releaseChar()));
+  }
+  return events.join(' ');
+}
+} // end namespace KeyName
@@ -10,4 +10,17 @@
 namespace KeyName
 {
   const QString& lookup(const DeviceId& dId, const DeviceInputEvent& die);
+
+  /// Arrows that mark a key press (↓) or release (↑) in key event texts.
+  QChar pressChar();
+  QChar releaseChar();
+
+  /// Event that identifies the key of a key event (not the SYN_REPORT of the frame).
+  const DeviceInputEvent& keyEventInput(const KeyEvent& ke);
+
+  /// Device specific name of the event, or its hexadecimal code if there is none.
+  QString eventName(const DeviceId& dId, const DeviceInputEvent& die);
+
+  /// Text of an input sequence, e.g. "[Next↓] [Next↑]".
+  QString sequenceText(const DeviceId& dId, const KeyEventSequence& kes);
 } // end namespace KeyName
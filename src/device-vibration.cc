@@ -7,6 +7,7 @@
 #include "hidpp.h"
 #include "iconwidgets.h"
 #include "logging.h"
+#include "timing.h"
 
 #include <QCheckBox>
 #include <QFontDatabase>
@@ -16,7 +17,6 @@
 #include <QSocketNotifier>
 #include <QSpinBox>
 #include <QStackedWidget>
-#include <QTimer>
 #include <QVBoxLayout>
 
 #include <array>
@@ -42,8 +42,8 @@ struct TimerWidget::Impl
     , sbMinutes(new QSpinBox(parent))
     , sbSeconds(new QSpinBox(parent))
     , btnStartStop(new IconButton(Font::Icon::media_control_48, parent))
-    , timer(new QTimer(parent))
-    , countdownTimer(new QTimer(parent))
+    , timer(new timing::Timer(parent))
+    , countdownTimer(new timing::Timer(parent))
     , overlayLabel(new QLabel(parent))
   {
     const auto layout = new QHBoxLayout(parent);
@@ -104,7 +104,7 @@ struct TimerWidget::Impl
       emit parent->enabledChanged(checked);
     });
 
-    QObject::connect(timer, &QTimer::timeout, parent, [this](){ btnStartStop->setChecked(false); });
+    QObject::connect(timer, &timing::Timer::timeout, parent, [this](){ btnStartStop->setChecked(false); });
     QObject::connect(sbHours, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), parent,
     [this, parent]() {
       updateTimerInterval();
@@ -124,7 +124,7 @@ struct TimerWidget::Impl
     timer->setSingleShot(true);
     countdownTimer->setInterval(1000);
 
-    QObject::connect(countdownTimer, &QTimer::timeout, parent, [this](){
+    QObject::connect(countdownTimer, &timing::Timer::timeout, parent, [this](){
       updateOverlayLabel(--secondsLeft);
     });
   }
@@ -161,8 +161,8 @@ struct TimerWidget::Impl
   QSpinBox* sbMinutes = nullptr;
   QSpinBox* sbSeconds = nullptr;
   IconButton* btnStartStop = nullptr;
-  QTimer* timer = nullptr;
-  QTimer* countdownTimer = nullptr;
+  timing::Timer* timer = nullptr;
+  timing::Timer* countdownTimer = nullptr;
   QLabel* overlayLabel = nullptr;
   int secondsLeft = 0;
 };
@@ -172,7 +172,7 @@ TimerWidget::TimerWidget(QWidget* parent)
   : QWidget(parent)
   , m_impl(new Impl(this))
 {
-  connect(m_impl->timer, &QTimer::timeout, this, &TimerWidget::timeout);
+  connect(m_impl->timer, &timing::Timer::timeout, this, &TimerWidget::timeout);
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -3,11 +3,14 @@
 
 #include "device.h"
 
+#include "device-key-lookup.h"
 #include "deviceinput.h"
 #include "devicescan.h"
 #include "enum-helper.h"
 #include "hidpp.h"
 #include "logging.h"
+#include "metrics.h"
+#include "watchdog.h"
 
 #include <QSocketNotifier>
 #include <QTimer>
@@ -26,6 +29,16 @@ namespace  {
   #endif
 
   const auto hexId = logging::hexId;
+
+  namespace Defaults {
+    // Vendor buttons are mapped to the BTN_TRIGGER_HAPPY1..40 key codes
+    constexpr size_t maxVendorButtons = BTN_TRIGGER_HAPPY40 - BTN_TRIGGER_HAPPY1 + 1;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  QString metricsDeviceLabel(const DeviceId& dId) {
+    return QString("%1:%2").arg(hexId(dId.vendorId), hexId(dId.productId));
+  }
   // class i18n : public QObject {}; // for i18n and logging
 } // end anonymous namespace
 
@@ -65,14 +78,64 @@ const char* toString(ConnectionMode cm, bool withClass)
 DeviceConnection::DeviceConnection(const DeviceId& id, const QString& name,
                                    std::shared_ptr<VirtualDevice> vmouse,
                                    std::shared_ptr<VirtualDevice> vkeyboard)
+  : DeviceConnection(id, name,
+                     std::make_shared<InputMapper>(std::move(vmouse), std::move(vkeyboard)))
+{}
+
+// -------------------------------------------------------------------------------------------------
+DeviceConnection::DeviceConnection(const DeviceId& id, const QString& name,
+                                   std::shared_ptr<InputMapper> inputMapper)
   : m_deviceId(id)
   , m_deviceName(name)
-  , m_inputMapper(std::make_shared<InputMapper>(std::move(vmouse), std::move(vkeyboard)))
+  , m_inputMapper(std::move(inputMapper))
 {
+  m_inputMapper->setMetricsDeviceLabel(metricsDeviceLabel(id));
+  metrics::counter("projecteur_device_connects", "Device connections (including reconnects).",
+                   {{"device", metricsDeviceLabel(id)}}).inc();
+  metrics::gauge("projecteur_devices_connected", "Currently connected devices.").inc();
+
+  // Latency of each mapped input sequence, collected on export as the mappings change at runtime.
+  auto& registry = metrics::Registry::instance();
+  registry.addCollector("projecteur_mapper_dispatch_delay_ms",
+                        "Delay of a mapped action in milliseconds, -1 if it cannot be triggered.",
+                        this, [this](metrics::Samples& samples)
+  {
+    const auto device = metricsDeviceLabel(m_deviceId);
+    for (const auto& latency : m_inputMapper->analyzeLatency())
+    {
+      const auto sequence = KeyName::sequenceText(m_deviceId, latency.sequence);
+      samples.emplace_back(metrics::Labels{{"device", device}, {"sequence", sequence},
+                                           {"delay", "expected"}},
+                           latency.reachable ? latency.expectedDelay : -1);
+      samples.emplace_back(metrics::Labels{{"device", device}, {"sequence", sequence},
+                                           {"delay", "worst_case"}},
+                           latency.reachable ? latency.worstCaseDelay : -1);
+    }
+  });
+  registry.addCollector("projecteur_mapper_continuations",
+                        "Longer mapped input sequences a mapped action waits for.",
+                        this, [this](metrics::Samples& samples)
+  {
+    const auto device = metricsDeviceLabel(m_deviceId);
+    for (const auto& latency : m_inputMapper->analyzeLatency())
+    {
+      const auto sequence = KeyName::sequenceText(m_deviceId, latency.sequence);
+      for (const auto& longer : latency.longerSequences)
+      {
+        const auto continuation = KeyName::sequenceText(m_deviceId, longer);
+        samples.emplace_back(metrics::Labels{{"device", device}, {"sequence", sequence},
+                                             {"continuation", continuation}}, 1);
+      }
+    }
+  });
 }
 
 // -------------------------------------------------------------------------------------------------
-DeviceConnection::~DeviceConnection() = default;
+DeviceConnection::~DeviceConnection()
+{
+  metrics::Registry::instance().removeCollectors(this);
+  metrics::gauge("projecteur_devices_connected", "Currently connected devices.").dec();
+}
 
 // -------------------------------------------------------------------------------------------------
 bool DeviceConnection::hasSubDevice(const QString& path) const
@@ -185,14 +248,28 @@ QSocketNotifier* SubDeviceConnection::socketReadNotifier() {
 // -------------------------------------------------------------------------------------------------
 SubEventConnection::SubEventConnection(Token /* token */,
                                        const DeviceId& dId, const DeviceScan::SubDevice& sd)
-  : SubDeviceConnection(dId, sd, ConnectionType::Event, ConnectionMode::ReadOnly) {}
+  : SubDeviceConnection(dId, sd, ConnectionType::Event, ConnectionMode::ReadOnly)
+  , m_framesRead(metrics::counter("projecteur_input_frames_read", "Input event frames read from devices.",
+                                  {{"device", metricsDeviceLabel(dId)}}))
+  , m_framesForwarded(metrics::counter("projecteur_input_frames_forwarded",
+                                       "Input event frames forwarded to virtual devices.",
+                                       {{"device", metricsDeviceLabel(dId)}}))
+{}
 
 // -------------------------------------------------------------------------------------------------
 SubEventConnection::~SubEventConnection() = default;
 
 // -------------------------------------------------------------------------------------------------
 bool SubEventConnection::isConnected() const {
-  return (m_readNotifier && m_readNotifier->isEnabled());
+  return (m_readNotifier && (m_readByInputThread || m_readNotifier->isEnabled()));
+}
+
+// -------------------------------------------------------------------------------------------------
+void SubEventConnection::setReadByInputThread()
+{
+  if (!m_readNotifier) { return; }
+  m_readNotifier->setEnabled(false);
+  m_readByInputThread = true;
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -280,6 +357,32 @@ std::shared_ptr<SubEventConnection> SubEventConnection::create(const DeviceScan:
   return connection;
 }
 
+// -------------------------------------------------------------------------------------------------
+std::shared_ptr<SubEventConnection> SubEventConnection::createFromFd(int fd,
+                                                                     const DeviceScan::SubDevice& sd,
+                                                                     const DeviceConnection& dc)
+{
+  if (fd == -1) { return std::shared_ptr<SubEventConnection>(); }
+
+  auto connection = std::make_shared<SubEventConnection>(Token{}, dc.deviceId(), sd);
+  connection->m_details.deviceFlags |= DeviceFlag::SynEvents | DeviceFlag::KeyEvents;
+  if (sd.hasRelativeEvents) { connection->m_details.deviceFlags |= DeviceFlag::RelativeEvents; }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  if ((fcntl(fd, F_GETFL, 0) & O_NONBLOCK) == O_NONBLOCK) {
+    connection->m_details.deviceFlags |= DeviceFlag::NonBlocking;
+  }
+
+  connection->m_readNotifier = std::make_unique<QSocketNotifier>(fd, QSocketNotifier::Read);
+  connect(connection->m_readNotifier.get(), &QSocketNotifier::destroyed, [fd, path=sd.deviceFile]() {
+    logDebug(device) << tr("Closing file descriptor for '%1'").arg(path);
+    ::close(fd);
+  });
+
+  connection->m_inputMapper = dc.inputMapper();
+  return connection;
+}
+
 // -------------------------------------------------------------------------------------------------
 SubHidrawConnection::SubHidrawConnection(Token /* token */,
                                          const DeviceId& dId, const DeviceScan::SubDevice& sd)
@@ -306,10 +409,38 @@ void SubHidrawConnection::disconnect() {
 std::shared_ptr<SubHidrawConnection> SubHidrawConnection::create(const DeviceScan::SubDevice& sd,
                                                                  const DeviceConnection& dc)
 {
-  const int devfd = openHidrawSubDevice(sd, dc.deviceId());
+  std::vector<uint8_t> reportDescriptor;
+  const int devfd = openHidrawSubDevice(sd, dc.deviceId(), &reportDescriptor);
   if (devfd == -1) { return std::shared_ptr<SubHidrawConnection>(); }
 
+  const auto reports = HidDescriptor::parseInputReports(reportDescriptor.data(),
+                                                        reportDescriptor.size());
+  HidDescriptor::FieldTable buttonFields;
+  for (const auto& field : reports.fields)
+  {
+    if (!field.isVendorButton()) { continue; }
+    if (buttonFields.size() == Defaults::maxVendorButtons) { break; }
+    buttonFields.push_back(field);
+  }
+
+  // Without anything to decode, there is no reason to keep the device open and wake up
+  // the event loop for each report.
+  if (buttonFields.empty())
+  {
+    logDebug(hid) << tr("No decodable input reports on hidraw device '%1'.").arg(sd.deviceFile);
+    ::close(devfd);
+    return std::shared_ptr<SubHidrawConnection>();
+  }
+
+  logDebug(hid) << tr("Decoding %1 vendor button(s) from hidraw device '%2'.")
+                   .arg(buttonFields.size()).arg(sd.deviceFile);
+
   auto connection = std::make_shared<SubHidrawConnection>(Token{}, dc.deviceId(), sd);
+  connection->m_buttonFields = std::move(buttonFields);
+  connection->m_buttonStates.resize(connection->m_buttonFields.size(), 0);
+  connection->m_readBuffer.resize(reports.maxReportSize);
+  connection->m_usesReportIds = reports.usesReportIds;
+  connection->m_inputMapper = dc.inputMapper();
   connection->createSocketNotifiers(devfd, sd.deviceFile);
 
   connect(connection->socketReadNotifier(), &QSocketNotifier::activated,
@@ -319,7 +450,8 @@ std::shared_ptr<SubHidrawConnection> SubHidrawConnection::create(const DeviceSca
 }
 
 // -----------------------------------------------------------------------------------------------
-int SubHidrawConnection::openHidrawSubDevice(const DeviceScan::SubDevice& sd, const DeviceId& devId)
+int SubHidrawConnection::openHidrawSubDevice(const DeviceScan::SubDevice& sd, const DeviceId& devId,
+                                             std::vector<uint8_t>* reportDescriptor)
 {
   constexpr int errorResult = -1;
   const int devfd = ::open(sd.deviceFile.toLocal8Bit().constData(), O_RDWR|O_NONBLOCK , 0);
@@ -329,8 +461,7 @@ int SubHidrawConnection::openHidrawSubDevice(const DeviceScan::SubDevice& sd, co
     return errorResult;
   }
 
-  { // Get Report Descriptor Size and Descriptor -- currently unused, but if it fails
-    // we don't use the device
+  { // Get Report Descriptor Size and Descriptor -- if it fails we don't use the device
     int descriptorSize = 0;
     if (ioctl(devfd, HIDIOCGRDESCSIZE, &descriptorSize) < 0)
     {
@@ -339,14 +470,18 @@ int SubHidrawConnection::openHidrawSubDevice(const DeviceScan::SubDevice& sd, co
       return errorResult;
     }
 
-    struct hidraw_report_descriptor reportDescriptor {};
-    reportDescriptor.size = descriptorSize;
-    if (ioctl(devfd, HIDIOCGRDESC, &reportDescriptor) < 0)
+    struct hidraw_report_descriptor descriptor {};
+    descriptor.size = descriptorSize;
+    if (ioctl(devfd, HIDIOCGRDESC, &descriptor) < 0)
     {
       logWarn(device) << tr("Cannot retrieve report descriptor of hidraw device '%1'.").arg(sd.deviceFile);
       ::close(devfd);
       return errorResult;
     }
+
+    if (reportDescriptor) {
+      reportDescriptor->assign(descriptor.value, descriptor.value + descriptor.size);
+    }
   }
 
   struct hidraw_devinfo devinfo {};
@@ -435,8 +570,8 @@ void SubHidrawConnection::createSocketNotifiers(int fd, const QString& path)
 // -------------------------------------------------------------------------------------------------
 void SubHidrawConnection::onHidrawDataAvailable(int fd)
 {
-  QByteArray readVal(20, 0);
-  const auto res = ::read(fd, readVal.data(), readVal.size());
+  const watchdog::Zone zone("SubHidrawConnection::onHidrawDataAvailable");
+  const auto res = ::read(fd, m_readBuffer.data(), m_readBuffer.size());
   if (res < 0) {
     if (errno != EAGAIN) {
       emit socketReadError(errno);
@@ -444,9 +579,29 @@ void SubHidrawConnection::onHidrawDataAvailable(int fd)
     return;
   }
 
-  // For generic hidraw devices without known protocols, just print out the
-  // received data into the debug log
-  logDebug(hid) << "Received" << readVal.toHex() << "from" << path();
+  const auto size = static_cast<size_t>(res);
+  if (size == 0) { return; }
+  const uint8_t reportId = m_usesReportIds ? m_readBuffer[0] : 0;
+
+  // Translate vendor button state changes to key events, the button index selects the key code.
+  m_events.clear();
+  for (size_t i = 0; i < m_buttonFields.size(); ++i)
+  {
+    const auto& field = m_buttonFields[i];
+    if (field.reportId != reportId) { continue; }
+
+    const auto pressed = static_cast<uint8_t>(field.extract(m_readBuffer.data(), size));
+    if (pressed == m_buttonStates[i]) { continue; }
+
+    m_buttonStates[i] = pressed;
+    const auto code = static_cast<uint16_t>(BTN_TRIGGER_HAPPY1 + i);
+    m_events.push_back(input_event{{}, EV_KEY, code, pressed});
+  }
+
+  if (m_events.empty() || !m_inputMapper) { return; }
+
+  m_events.push_back(input_event{{}, EV_SYN, SYN_REPORT, 0});
+  m_inputMapper->addEvents(m_events.data(), m_events.size());
 }
 
 // -------------------------------------------------------------------------------------------------
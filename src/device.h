@@ -6,6 +6,7 @@
 #include "enum-helper.h"
 
 #include "devicescan.h"
+#include "hid-descriptor.h"
 
 #include <array>
 #include <memory>
@@ -22,6 +23,8 @@ class QSocketNotifier;
 class SubDeviceConnection;
 class VirtualDevice;
 
+namespace metrics { class Counter; }
+
 // -------------------------------------------------------------------------------------------------
 /// The main device connection class, which usually consists of one or multiple sub devices.
 class DeviceConnection : public QObject
@@ -31,6 +34,10 @@ class DeviceConnection : public QObject
 public:
   DeviceConnection(const DeviceId& id, const QString& name,
     std::shared_ptr<VirtualDevice> vmouse, std::shared_ptr<VirtualDevice> vkeyboard);
+  /// Creates a device connection with the already configured input mapper of a previous
+  /// connection to the same device.
+  DeviceConnection(const DeviceId& id, const QString& name,
+    std::shared_ptr<InputMapper> inputMapper);
 
   ~DeviceConnection();
 
@@ -157,14 +164,27 @@ class SubEventConnection : public SubDeviceConnection
 public:
   static std::shared_ptr<SubEventConnection> create(const DeviceScan::SubDevice& sd,
                                                     const DeviceConnection& dc);
+  /// Create a connection for an already open, event device like file descriptor (e.g. a pipe
+  /// used by the input benchmark). The connection takes ownership of the descriptor.
+  static std::shared_ptr<SubEventConnection> createFromFd(int fd, const DeviceScan::SubDevice& sd,
+                                                          const DeviceConnection& dc);
 
   SubEventConnection(Token, const DeviceId&, const DeviceScan::SubDevice&);
   virtual ~SubEventConnection();
   bool isConnected() const;
   auto& inputBuffer() { return m_inputEventBuffer; }
+  metrics::Counter& framesRead() { return m_framesRead; }
+  metrics::Counter& framesForwarded() { return m_framesForwarded; }
+
+  /// The device is read by the input thread, the read notifier stays disabled.
+  void setReadByInputThread();
+  bool readByInputThread() const { return m_readByInputThread; }
 
 protected:
   InputBuffer<12> m_inputEventBuffer;
+  bool m_readByInputThread = false;
+  metrics::Counter& m_framesRead;
+  metrics::Counter& m_framesForwarded;
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -198,9 +218,16 @@ public:
 
 protected:
   void createSocketNotifiers(int fd, const QString& path);
-  static int openHidrawSubDevice(const DeviceScan::SubDevice& sd, const DeviceId& devId);
+  static int openHidrawSubDevice(const DeviceScan::SubDevice& sd, const DeviceId& devId,
+                                 std::vector<uint8_t>* reportDescriptor = nullptr);
   std::unique_ptr<QSocketNotifier> m_writeNotifier;
 
 private:
   void onHidrawDataAvailable(int fd);
+
+  HidDescriptor::FieldTable m_buttonFields; ///< Vendor buttons decoded from input reports.
+  std::vector<uint8_t> m_buttonStates;
+  std::vector<uint8_t> m_readBuffer;
+  std::vector<struct input_event> m_events;
+  bool m_usesReportIds = false;
 };
@@ -5,15 +5,17 @@
 
 #include "enum-helper.h"
 #include "logging.h"
+#include "metrics.h"
 #include "settings.h"
+#include "timing.h"
 #include "virtualdevice.h"
 
 #include <algorithm>
+#include <bitset>
+#include <chrono>
 #include <list>
 #include <type_traits>
 
-#include <QTimer>
-
 #include <linux/input.h>
 
 LOGGING_CATEGORY(input, "input")
@@ -26,6 +28,55 @@ namespace  {
   #endif
 
 
+  // -----------------------------------------------------------------------------------------------
+  struct MapperMetrics
+  {
+    static metrics::Counter& result(const char* result) {
+      return metrics::counter("projecteur_mapper_results", "Input mapper key event lookup results.",
+                              {{"result", result}});
+    }
+
+    metrics::Counter& hits = result("hit");
+    metrics::Counter& partialHits = result("partial_hit");
+    metrics::Counter& valid = result("valid");
+    metrics::Counter& misses = result("miss");
+    metrics::Counter& timeouts = metrics::counter("projecteur_mapper_sequence_timeouts",
+                                                  "Input mapper key sequence interval timeouts.");
+    metrics::Counter& actions = metrics::counter("projecteur_mapper_actions",
+                                                 "Actions executed by the input mapper.");
+
+    static metrics::Counter& repeat(const char* handling) {
+      return metrics::counter("projecteur_mapper_autorepeats",
+                              "Key autorepeat frames handled by the input mapper fast path.",
+                              {{"handling", handling}});
+    }
+
+    metrics::Counter& repeatsRelayed = repeat("relayed");
+    metrics::Counter& repeatsSuppressed = repeat("suppressed");
+    metrics::Counter& repeatedActions = repeat("action");
+    metrics::Counter& repeatsRegenerated = repeat("regenerated");
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  namespace AdaptiveTiming {
+    constexpr size_t maxGapSamples = 16;     // Recent continuation gaps kept per partial hit
+    constexpr size_t minGapSamples = 4;      // Before that, the full sequence interval is used
+    constexpr int minWindowMs = 60;
+    constexpr int marginMs = 40;             // Added to the slowest observed continuation
+  }
+
+  namespace Autorepeat {
+    constexpr int delayMs = 250; // Defaults of the software autorepeat of the kernel input core
+    constexpr int periodMs = 33;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  MapperMetrics& mapperMetrics()
+  {
+    static MapperMetrics m;
+    return m;
+  }
+
   // -----------------------------------------------------------------------------------------------
   void addKeyToString(QString& str, const QString& key)
   {
@@ -81,6 +132,25 @@ namespace  {
     return false;
   }
 
+  // -----------------------------------------------------------------------------------------------
+  /// Returns the key code if the frame consists of autorepeat events (EV_KEY value 2) of a single
+  /// key - besides MSC_SCAN events and the closing SYN event - and -1 otherwise.
+  int autorepeatCode(const input_event* input_events, size_t num)
+  {
+    if (num < 2 || input_events[num-1].type != EV_SYN) { return -1; }
+
+    int code = -1;
+    for (size_t i = 0; i < num - 1; ++i)
+    {
+      const auto& ev = input_events[i];
+      if (ev.type == EV_MSC && ev.code == MSC_SCAN) { continue; }
+      if (ev.type != EV_KEY || ev.value != 2 || ev.code >= KEY_CNT) { return -1; }
+      if (code >= 0 && code != ev.code) { return -1; }
+      code = ev.code;
+    }
+    return code;
+  }
+
 } // end anonymous namespace
 
 // -------------------------------------------------------------------------------------------------
@@ -248,8 +318,20 @@ namespace  {
 
     auto state() const { return m_pos; }
     void resetState();
-    void reconfigure(const InputMapConfig& config = {});
+    void reconfigure(const InputMapConfig& config = {},
+                     const std::vector<KeyEventSequence>& excluded = {});
     bool hasConfig() const { return !m_rootItem.nextMap.empty(); }
+    bool isPending() const { return m_pos != &m_rootItem; }
+
+    /// Item at the end of the given sequence, nullptr if not part of the configuration.
+    const KeyEventItem* find(const KeyEventSequence& kes) const;
+    /// Returns true if the key event continues a sequence after the given item.
+    static bool continues(const KeyEventItem* item, const KeyEvent& ke);
+    /// Returns false for key events that are never fed to the key map by the input mapper.
+    static bool isMatchable(const KeyEvent& ke);
+    /// Adds all sequences with an action that continue the given item and its sequence.
+    static void collectSequences(const KeyEventItem* item, KeyEventSequence& sequence,
+                                 std::vector<KeyEventSequence>& sequences);
 
   private:
     std::list<KeyEventItem> m_items;
@@ -295,7 +377,74 @@ void DeviceKeyMap::resetState()
 }
 
 // -------------------------------------------------------------------------------------------------
-void DeviceKeyMap::reconfigure(const InputMapConfig& config)
+const KeyEventItem* DeviceKeyMap::find(const KeyEventSequence& kes) const
+{
+  const KeyEventItem* item = &m_rootItem;
+  for (const auto& ke : kes)
+  {
+    const auto it = std::find_if(item->nextMap.cbegin(), item->nextMap.cend(),
+    [&ke](const KeyEventItem* next) {
+      return next && next->keyEvent == ke;
+    });
+    if (it == item->nextMap.cend()) { return nullptr; }
+    item = *it;
+  }
+  return (item == &m_rootItem) ? nullptr : item;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool DeviceKeyMap::continues(const KeyEventItem* item, const KeyEvent& ke)
+{
+  return item && std::any_of(item->nextMap.cbegin(), item->nextMap.cend(),
+  [&ke](const KeyEventItem* next) {
+    return next && next->keyEvent == ke;
+  });
+}
+
+// -------------------------------------------------------------------------------------------------
+bool DeviceKeyMap::isMatchable(const KeyEvent& ke)
+{
+  if (ke.empty()) { return false; }
+
+  // SYN events separate the key events and are never part of them.
+  if (std::any_of(ke.cbegin(), ke.cend(), [](const DeviceInputEvent& e){ return e.type == EV_SYN; })) {
+    return false;
+  }
+
+  // Autorepeat events of held keys never reach the key map, see InputMapper::addEvents
+  const bool autorepeat = std::all_of(ke.cbegin(), ke.cend(), [](const DeviceInputEvent& e){
+    return (e.type == EV_MSC && e.code == MSC_SCAN) || (e.type == EV_KEY && e.value == 2);
+  });
+  if (autorepeat && std::any_of(ke.cbegin(), ke.cend(), [](const DeviceInputEvent& e){
+    return e.type == EV_KEY;
+  })) {
+    return false;
+  }
+
+  // MSC_SCAN events before mouse button events are dropped, see InputMapper::addEvents
+  return !(ke.size() == 2
+           && ke[0].type == EV_MSC && ke[0].code == MSC_SCAN
+           && ke[1].type == EV_KEY
+           && (ke[1].code == BTN_LEFT || ke[1].code == BTN_RIGHT || ke[1].code == BTN_MIDDLE));
+}
+
+// -------------------------------------------------------------------------------------------------
+void DeviceKeyMap::collectSequences(const KeyEventItem* item, KeyEventSequence& sequence,
+                                    std::vector<KeyEventSequence>& sequences)
+{
+  for (const auto next : item->nextMap)
+  {
+    if (!next) { continue; }
+    sequence.push_back(next->keyEvent);
+    if (next->action) { sequences.push_back(sequence); }
+    collectSequences(next, sequence, sequences);
+    sequence.pop_back();
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void DeviceKeyMap::reconfigure(const InputMapConfig& config,
+                               const std::vector<KeyEventSequence>& excluded)
 {
   // -- clear maps + state
   resetState();
@@ -307,6 +456,9 @@ void DeviceKeyMap::reconfigure(const InputMapConfig& config)
   {
     // sanity check
     if (!configItem.second.action) { continue; }
+    if (std::find(excluded.cbegin(), excluded.cend(), configItem.first) != excluded.cend()) {
+      continue;
+    }
 
     KeyEventItem* previous = nullptr;
     KeyEventItem* current = &m_rootItem;
@@ -574,6 +726,13 @@ struct InputMapper::Impl
        std::shared_ptr<VirtualDevice> virtualMouse,
        std::shared_ptr<VirtualDevice> virtualKeybaord);
 
+  /// Observed continuations after a partial hit of a key map item.
+  struct SequenceCadence
+  {
+    std::vector<int> gapsMs; // ring buffer of the most recent gaps
+    size_t nextGap = 0;
+  };
+
   void sequenceTimeout();
   void resetState();
   void record(const struct input_event input_events[], size_t num);
@@ -581,24 +740,57 @@ struct InputMapper::Impl
   void execAction(const std::shared_ptr<Action>& action, DeviceKeyMap::Result r);
   bool hasVirtualDevices() const;
 
+  int partialHitWindow(const KeyEventItem* item) const;
+  void learnContinuation(const KeyEvent& ke, timing::TimePoint now);
+  void partialHit(const KeyEventItem* item, timing::TimePoint now);
+  void updateLatencyMetrics();
+
   void forwardEvents(const struct input_event input_events[], size_t num);
   void forwardEvents(const std::vector<struct input_event>& input_events);
 
+  bool handleAutorepeat(const struct input_event input_events[], size_t num);
+  void trackForwardedKeys(const struct input_event input_events[], size_t num, bool keyboard);
+  void holdAction(const struct input_event input_events[], size_t num,
+                  const std::shared_ptr<Action>& action);
+  void regenerateRepeat();
+  void stopRepeat();
+  void updateMappedKeys();
+
   InputMapper* m_parent = nullptr;
 
   // virtual devices can be empty shared_ptr's if app is started without uinput
   std::shared_ptr<VirtualDevice> m_vmouse;
   std::shared_ptr<VirtualDevice> m_vkeyboard;
 
-  QTimer* m_seqTimer = nullptr;
+  timing::Timer* m_seqTimer = nullptr;
+  int m_sequenceIntervalMs = 250;
   DeviceKeyMap m_keymap;
 
   std::pair<DeviceKeyMap::Result, const KeyEventItem*> m_lastState;
+  bool m_adaptiveTiming = false;
+  std::map<const KeyEventItem*, SequenceCadence> m_cadence;
+  const KeyEventItem* m_partialHitItem = nullptr; // last partial hit, until the next key event
+  timing::TimePoint m_partialHitTime;
   std::vector<input_event> m_events;
   InputMapConfig m_config;
   bool m_recordingMode = false;
+  bool m_firmwareRemapping = false;
+  std::vector<KeyEventSequence> m_firmwareSequences; // excluded from m_keymap
+
+  bool m_repeatActions = false;
+  bool m_regenerateAutorepeat = false;
+  std::bitset<KEY_CNT> m_mappedKeys;    // key codes in the sequences of m_keymap
+  std::bitset<KEY_CNT> m_forwardedKeys; // pressed keys forwarded to the virtual devices
+  int m_heldKey = -1;                   // pressed key that executed m_heldAction
+  std::shared_ptr<Action> m_heldAction;
+  timing::Timer* m_repeatTimer = nullptr;
+  int m_repeatKey = -1;                 // forwarded key repeated by m_repeatTimer
 
   SpecialMoveInputs m_specialMoveInputs;
+  metrics::Counter* m_framesForwarded = nullptr;
+  metrics::Gauge* m_delayedMappings = nullptr;
+  metrics::Gauge* m_unreachableMappings = nullptr;
+  metrics::Gauge* m_maxDispatchDelay = nullptr;
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -608,12 +800,15 @@ InputMapper::Impl::Impl(InputMapper* parent
   : m_parent(parent)
   , m_vmouse(std::move(virtualMouse))
   , m_vkeyboard(std::move(virtualKeyboard))
-  , m_seqTimer(new QTimer(parent))
+  , m_seqTimer(new timing::Timer(parent))
+  , m_repeatTimer(new timing::Timer(parent))
 {
-  constexpr int defaultSequenceIntervalMs = 250;
   m_seqTimer->setSingleShot(true);
-  m_seqTimer->setInterval(defaultSequenceIntervalMs);
-  connect(m_seqTimer, &QTimer::timeout, parent, [this](){ sequenceTimeout(); });
+  m_seqTimer->setInterval(m_sequenceIntervalMs);
+  connect(m_seqTimer, &timing::Timer::timeout, parent, [this](){ sequenceTimeout(); });
+
+  m_repeatTimer->setTimerType(Qt::PreciseTimer);
+  connect(m_repeatTimer, &timing::Timer::timeout, parent, [this](){ regenerateRepeat(); });
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -627,6 +822,7 @@ void InputMapper::Impl::execAction(const std::shared_ptr<Action>& action, Device
 {
   if (!action || action->empty()) { return; }
 
+  mapperMetrics().actions.inc();
   logDebug(input) << "Input map execAction, type =" << toString(action->type())
                   << ", partial_hit =" << (r == DeviceKeyMap::Result::PartialHit);
 
@@ -651,6 +847,8 @@ void InputMapper::Impl::sequenceTimeout()
     return;
   }
 
+  mapperMetrics().timeouts.inc();
+
   if (m_lastState.first == DeviceKeyMap::Result::Valid) {
     // Last input event was part of a valid key sequence, but timeout hit
     // So we emit our stored event so far to the virtual device
@@ -680,8 +878,79 @@ void InputMapper::Impl::sequenceTimeout()
 // -------------------------------------------------------------------------------------------------
 void InputMapper::Impl::resetState()
 {
+  const bool wasPending = m_keymap.isPending();
   m_keymap.resetState();
   m_events.resize(0);
+  if (wasPending) { emit m_parent->sequencePendingChanged(false); }
+}
+
+// -------------------------------------------------------------------------------------------------
+int InputMapper::Impl::partialHitWindow(const KeyEventItem* item) const
+{
+  if (!m_adaptiveTiming) { return m_sequenceIntervalMs; }
+
+  const auto it = m_cadence.find(item);
+  if (it == m_cadence.cend()) { return m_sequenceIntervalMs; }
+  const auto& cadence = it->second;
+
+  if (cadence.gapsMs.size() < AdaptiveTiming::minGapSamples) { return m_sequenceIntervalMs; }
+
+  // The window never closes completely: as long as a longer sequence can follow, waiting for it
+  // is the only way to not lose its action.
+  const auto slowest = *std::max_element(cadence.gapsMs.cbegin(), cadence.gapsMs.cend());
+  return std::min(m_sequenceIntervalMs,
+                  std::max(AdaptiveTiming::minWindowMs, slowest + AdaptiveTiming::marginMs));
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::Impl::learnContinuation(const KeyEvent& ke, timing::TimePoint now)
+{
+  if (!m_partialHitItem) { return; }
+
+  const auto item = m_partialHitItem;
+  m_partialHitItem = nullptr;
+
+  // Continuations after a shortened window are still counted, as long as they are within the
+  // configured sequence interval - this way the window grows again if it was too short.
+  const auto gapMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_partialHitTime);
+  if (gapMs.count() > m_sequenceIntervalMs || !DeviceKeyMap::continues(item, ke)) { return; }
+
+  auto& cadence = m_cadence[item];
+  if (cadence.gapsMs.size() < AdaptiveTiming::maxGapSamples) {
+    cadence.gapsMs.push_back(static_cast<int>(gapMs.count()));
+  } else {
+    cadence.gapsMs[cadence.nextGap] = static_cast<int>(gapMs.count());
+  }
+  cadence.nextGap = (cadence.nextGap + 1) % AdaptiveTiming::maxGapSamples;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::Impl::partialHit(const KeyEventItem* item, timing::TimePoint now)
+{
+  m_partialHitItem = item;
+  m_partialHitTime = now;
+  m_lastState = std::make_pair(DeviceKeyMap::Result::PartialHit, item);
+  m_seqTimer->start(partialHitWindow(item));
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::Impl::updateLatencyMetrics()
+{
+  if (!m_delayedMappings) { return; }
+
+  int64_t delayed = 0;
+  int64_t unreachable = 0;
+  int64_t maxDelay = 0;
+  for (const auto& latency : m_parent->analyzeLatency())
+  {
+    if (!latency.reachable) { ++unreachable; }
+    else if (latency.worstCaseDelay > 0) { ++delayed; }
+    maxDelay = std::max<int64_t>(maxDelay, latency.worstCaseDelay);
+  }
+
+  m_delayedMappings->set(delayed);
+  m_unreachableMappings->set(unreachable);
+  m_maxDispatchDelay->set(maxDelay);
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -709,7 +978,7 @@ void InputMapper::Impl::record(const struct input_event input_events[], size_t n
   if (!m_seqTimer->isActive()) {
     emit m_parent->recordingStarted();
   }
-  m_seqTimer->start();
+  m_seqTimer->start(m_sequenceIntervalMs);
   emit m_parent->keyEventRecorded(ev);
 }
 
@@ -735,17 +1004,137 @@ void InputMapper::Impl::forwardEvents(const struct input_event input_events[], s
   while (syn != end) {
     auto const len = std::distance(beg, syn) + 1;
 
-    if (isMouseEvent(beg, len)) {
+    const bool mouseEvent = isMouseEvent(beg, len);
+    if (mouseEvent) {
       m_vmouse->emitEvents(beg, len);
     } else {
       m_vkeyboard->emitEvents(beg, len);
     }
+    if (m_framesForwarded) { m_framesForwarded->inc(); }
+    trackForwardedKeys(beg, len, !mouseEvent);
 
     beg = syn + 1;
     syn = std::find_if(beg, end, predicate);
   }
 }
 
+// -------------------------------------------------------------------------------------------------
+bool InputMapper::Impl::handleAutorepeat(const struct input_event input_events[], size_t num)
+{
+  const int code = autorepeatCode(input_events, num);
+  if (code < 0) { return false; }
+
+  // A held button is recorded as a single press.
+  if (m_recordingMode) { return true; }
+
+  if (m_forwardedKeys.test(code))
+  {
+    if (m_regenerateAutorepeat) {
+      mapperMetrics().repeatsSuppressed.inc(); // repeated by m_repeatTimer
+    } else {
+      mapperMetrics().repeatsRelayed.inc();
+      forwardEvents(input_events, num);
+    }
+  }
+  else if (code == m_heldKey && m_repeatActions)
+  {
+    mapperMetrics().repeatedActions.inc();
+    execAction(m_heldAction, DeviceKeyMap::Result::Hit);
+  }
+  else if (m_mappedKeys.test(code))
+  { // The press either executed an action or is still part of a pending sequence.
+    mapperMetrics().repeatsSuppressed.inc();
+  }
+  else
+  { // Pressed before the key was mapped or before the virtual devices were available.
+    mapperMetrics().repeatsRelayed.inc();
+    forwardEvents(input_events, num);
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::Impl::trackForwardedKeys(const struct input_event input_events[], size_t num,
+                                           bool keyboard)
+{
+  for (size_t i = 0; i < num; ++i)
+  {
+    const auto& ev = input_events[i];
+    if (ev.type != EV_KEY || ev.code >= KEY_CNT) { continue; }
+
+    if (ev.value == 1)
+    {
+      m_forwardedKeys.set(ev.code);
+      // Like the kernel, only the most recently pressed key is repeated.
+      if (keyboard && m_regenerateAutorepeat && m_vkeyboard) {
+        m_repeatKey = ev.code;
+        m_repeatTimer->start(Autorepeat::delayMs);
+      }
+    }
+    else if (ev.value == 0)
+    {
+      m_forwardedKeys.reset(ev.code);
+      if (ev.code == m_repeatKey) { stopRepeat(); }
+    }
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::Impl::holdAction(const struct input_event input_events[], size_t num,
+                                   const std::shared_ptr<Action>& action)
+{
+  const auto end = input_events + num;
+  const auto press = std::find_if(input_events, end, [](const input_event& ev) {
+    return ev.type == EV_KEY && ev.value == 1;
+  });
+  if (press == end) { return; }
+
+  m_heldKey = press->code;
+  m_heldAction = action;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::Impl::regenerateRepeat()
+{
+  if (m_repeatKey < 0 || !m_vkeyboard) { stopRepeat(); return; }
+
+  const input_event events[] = {
+    {{}, EV_KEY, static_cast<uint16_t>(m_repeatKey), 2},
+    {{}, EV_SYN, SYN_REPORT, 0},
+  };
+  m_vkeyboard->emitEvents(events, 2);
+  mapperMetrics().repeatsRegenerated.inc();
+  m_repeatTimer->start(Autorepeat::periodMs);
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::Impl::stopRepeat()
+{
+  m_repeatTimer->stop();
+  m_repeatKey = -1;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::Impl::updateMappedKeys()
+{
+  m_mappedKeys.reset();
+  for (const auto& item : m_config)
+  {
+    const auto& kes = item.first;
+    if (std::find(m_firmwareSequences.cbegin(), m_firmwareSequences.cend(), kes)
+        != m_firmwareSequences.cend()) {
+      continue;
+    }
+
+    for (const auto& ke : kes) {
+      for (const auto& ev : ke) {
+        if (ev.type == EV_KEY && ev.code < KEY_CNT) { m_mappedKeys.set(ev.code); }
+      }
+    }
+  }
+  emit m_parent->directForwardingChanged();
+}
+
 // -------------------------------------------------------------------------------------------------
 // -------------------------------------------------------------------------------------------------
 InputMapper::InputMapper(
@@ -795,19 +1184,139 @@ void InputMapper::setRecordingMode(bool recording)
   impl->m_seqTimer->stop();
   resetState();
   emit recordingModeChanged(impl->m_recordingMode);
+  emit directForwardingChanged();
 }
 
 // -------------------------------------------------------------------------------------------------
 int InputMapper::keyEventInterval() const
 {
-  return impl->m_seqTimer->interval();
+  return impl->m_sequenceIntervalMs;
 }
 
 // -------------------------------------------------------------------------------------------------
 void InputMapper::setKeyEventInterval(int interval)
 {
-  impl->m_seqTimer->setInterval(std::min(Settings::inputSequenceIntervalRange().max,
-                                std::max(Settings::inputSequenceIntervalRange().min, interval)));
+  impl->m_sequenceIntervalMs = std::min(Settings::inputSequenceIntervalRange().max,
+                                        std::max(Settings::inputSequenceIntervalRange().min, interval));
+  impl->m_seqTimer->setInterval(impl->m_sequenceIntervalMs);
+  impl->updateLatencyMetrics();
+  emit sequenceTimingChanged();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputMapper::adaptiveSequenceTiming() const
+{
+  return impl->m_adaptiveTiming;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::setAdaptiveSequenceTiming(bool adaptive)
+{
+  if (impl->m_adaptiveTiming == adaptive) { return; }
+
+  impl->m_adaptiveTiming = adaptive;
+  emit sequenceTimingChanged();
+}
+
+// -------------------------------------------------------------------------------------------------
+MappingLatency InputMapper::analyzeLatency(const KeyEventSequence& kes) const
+{
+  MappingLatency latency;
+  latency.sequence = kes;
+
+  const auto& fwSequences = impl->m_firmwareSequences;
+  if (std::find(fwSequences.cbegin(), fwSequences.cend(), kes) != fwSequences.cend()) {
+    latency.reachable = latency.firmware = true;
+    return latency;
+  }
+
+  const auto item = impl->m_keymap.find(kes);
+  if (!item || !item->action) { return latency; }
+
+  latency.reachable = std::all_of(kes.cbegin(), kes.cend(), &DeviceKeyMap::isMatchable);
+  if (!latency.reachable || item->nextMap.empty()) { return latency; }
+
+  // The action waits for the possible continuation with one of the longer sequences.
+  auto sequence = kes;
+  DeviceKeyMap::collectSequences(item, sequence, latency.longerSequences);
+  latency.worstCaseDelay = impl->m_sequenceIntervalMs;
+  latency.expectedDelay = impl->partialHitWindow(item);
+  return latency;
+}
+
+// -------------------------------------------------------------------------------------------------
+std::vector<MappingLatency> InputMapper::analyzeLatency() const
+{
+  std::vector<MappingLatency> result;
+  result.reserve(impl->m_config.size());
+  for (const auto& item : impl->m_config) {
+    result.emplace_back(analyzeLatency(item.first));
+  }
+  return result;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputMapper::firmwareRemapping() const
+{
+  return impl->m_firmwareRemapping;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::setFirmwareRemapping(bool enabled)
+{
+  if (impl->m_firmwareRemapping == enabled) { return; }
+
+  impl->m_firmwareRemapping = enabled;
+  emit firmwareRemappingChanged(enabled);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputMapper::repeatMappedActions() const
+{
+  return impl->m_repeatActions;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::setRepeatMappedActions(bool repeat)
+{
+  impl->m_repeatActions = repeat;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputMapper::regenerateAutorepeat() const
+{
+  return impl->m_regenerateAutorepeat;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::setRegenerateAutorepeat(bool regenerate)
+{
+  if (impl->m_regenerateAutorepeat == regenerate) { return; }
+
+  impl->m_regenerateAutorepeat = regenerate;
+  if (!regenerate) { impl->stopRepeat(); }
+  emit directForwardingChanged();
+}
+
+// -------------------------------------------------------------------------------------------------
+const std::vector<KeyEventSequence>& InputMapper::firmwareMappedSequences() const
+{
+  return impl->m_firmwareSequences;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::setFirmwareMappedSequences(std::vector<KeyEventSequence> sequences)
+{
+  if (sequences == impl->m_firmwareSequences) { return; }
+
+  impl->m_firmwareSequences = std::move(sequences);
+  impl->resetState();
+  impl->m_cadence.clear();
+  impl->m_partialHitItem = nullptr;
+  impl->m_keymap.reconfigure(impl->m_config, impl->m_firmwareSequences);
+  impl->updateMappedKeys();
+  impl->updateLatencyMetrics();
+  emit sequenceTimingChanged();
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -815,6 +1324,9 @@ void InputMapper::addEvents(const input_event* input_events, size_t num)
 {
   if (num == 0 || (!hasVirtualDevice())) { return; }
 
+  // Held keys: autorepeat frames never reach the key map.
+  if (impl->handleAutorepeat(input_events, num)) { return; }
+
   // If no key mapping is configured ...
   if (!impl->m_recordingMode && !impl->m_keymap.hasConfig()) {
     // ... forward events to virtual device
@@ -850,6 +1362,12 @@ void InputMapper::addEvents(const input_event* input_events, size_t num)
     return;
   }
 
+  impl->m_heldKey = -1;
+  impl->m_heldAction.reset();
+
+  const auto now = timing::now();
+  const bool wasPending = impl->m_keymap.isPending();
+  impl->learnContinuation(KeyEvent(input_events, input_events + num - 1), now);
   const auto res = impl->m_keymap.feed(input_events, num-1); // exclude syn event for keymap feed
 
   // Add current events to the buffered events
@@ -858,6 +1376,7 @@ void InputMapper::addEvents(const input_event* input_events, size_t num)
 
   if (res == DeviceKeyMap::Result::Miss)
   { // key sequence miss, send all buffered events so far
+    mapperMetrics().misses.inc();
     impl->m_seqTimer->stop();
 
     impl->forwardEvents(impl->m_events);
@@ -866,9 +1385,11 @@ void InputMapper::addEvents(const input_event* input_events, size_t num)
   }
   else if (res == DeviceKeyMap::Result::Hit)
   { // Found a valid key sequence
+    mapperMetrics().hits.inc();
     impl->m_seqTimer->stop();
     if (const auto pos = impl->m_keymap.state()) {
       impl->execAction(pos->action, res);
+      impl->holdAction(input_events, num, pos->action);
     }
     else {
       impl->forwardEvents(impl->m_events);
@@ -876,12 +1397,51 @@ void InputMapper::addEvents(const input_event* input_events, size_t num)
 
     impl->resetState();
   }
-  else if (res == DeviceKeyMap::Result::Valid || res == DeviceKeyMap::Result::PartialHit)
-  { // KeyEvent is either a part of valid key sequence or Partial Hit.
-    // In both case, save the current state and start timer
+  else if (res == DeviceKeyMap::Result::Valid)
+  { // KeyEvent is part of valid key sequence, save the current state and start timer
+    mapperMetrics().valid.inc();
     impl->m_lastState = std::make_pair(res, impl->m_keymap.state());
-    impl->m_seqTimer->start();
+    impl->m_seqTimer->start(impl->m_sequenceIntervalMs);
+    if (!wasPending) { emit sequencePendingChanged(true); }
+  }
+  else if (res == DeviceKeyMap::Result::PartialHit)
+  { // KeyEvent has an action, but is also the beginning of longer sequences
+    mapperMetrics().partialHits.inc();
+    impl->partialHit(impl->m_keymap.state(), now);
+    if (!wasPending) { emit sequencePendingChanged(true); }
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputMapper::sequencePending() const
+{
+  return impl->m_keymap.isPending();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputMapper::isMappedKey(uint16_t code) const
+{
+  return code < KEY_CNT && impl->m_mappedKeys.test(code);
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapper::addForwardedEvents(const input_event* input_events, size_t num)
+{
+  if (num == 0) { return; }
+
+  if (autorepeatCode(input_events, num) >= 0) {
+    mapperMetrics().repeatsRelayed.inc();
+  }
+  else if (impl->m_keymap.hasConfig())
+  { // Same state changes as a key map miss without pending sequence.
+    mapperMetrics().misses.inc();
+    impl->m_heldKey = -1;
+    impl->m_heldAction.reset();
+    impl->learnContinuation(KeyEvent(input_events, input_events + num - 1), timing::now());
   }
+
+  if (impl->m_framesForwarded) { impl->m_framesForwarded->inc(); }
+  impl->trackForwardedKeys(input_events, num, !isMouseEvent(input_events, num));
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -912,6 +1472,7 @@ void InputMapper::addEvents(const KeyEvent& key_event)
 void InputMapper::resetState()
 {
   impl->resetState();
+  impl->stopRepeat();
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -921,7 +1482,11 @@ void InputMapper::setConfiguration(const InputMapConfig& config)
 
   impl->m_config = config;
   impl->resetState();
-  impl->m_keymap.reconfigure(impl->m_config);
+  impl->m_cadence.clear();
+  impl->m_partialHitItem = nullptr;
+  impl->m_keymap.reconfigure(impl->m_config, impl->m_firmwareSequences);
+  impl->updateMappedKeys();
+  impl->updateLatencyMetrics();
   emit configurationChanged();
 }
 
@@ -932,7 +1497,11 @@ void InputMapper::setConfiguration(InputMapConfig&& config)
 
   impl->m_config.swap(config);
   impl->resetState();
-  impl->m_keymap.reconfigure(impl->m_config);
+  impl->m_cadence.clear();
+  impl->m_partialHitItem = nullptr;
+  impl->m_keymap.reconfigure(impl->m_config, impl->m_firmwareSequences);
+  impl->updateMappedKeys();
+  impl->updateLatencyMetrics();
   emit configurationChanged();
 }
 
@@ -942,6 +1511,24 @@ const InputMapConfig& InputMapper::configuration() const
   return impl->m_config;
 }
 
+// -------------------------------------------------------------------------------------------------
+void InputMapper::setMetricsDeviceLabel(const QString& label)
+{
+  impl->m_framesForwarded = &metrics::counter("projecteur_input_frames_forwarded",
+                                              "Input event frames forwarded to virtual devices.",
+                                              {{"device", label}});
+  impl->m_delayedMappings = &metrics::gauge("projecteur_mapper_delayed_mappings",
+                                            "Mapped input sequences that wait for longer sequences.",
+                                            {{"device", label}});
+  impl->m_unreachableMappings = &metrics::gauge("projecteur_mapper_unreachable_mappings",
+                                                "Mapped input sequences the device input cannot trigger.",
+                                                {{"device", label}});
+  impl->m_maxDispatchDelay = &metrics::gauge("projecteur_mapper_max_dispatch_delay_ms",
+                                             "Worst-case delay of a mapped action in milliseconds.",
+                                             {{"device", label}});
+  impl->updateLatencyMetrics();
+}
+
 // -------------------------------------------------------------------------------------------------
 const InputMapper::SpecialMoveInputs& InputMapper::specialMoveInputs()
 {
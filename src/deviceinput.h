@@ -282,6 +282,18 @@ QDataStream& operator<<(QDataStream& s, const MappedAction& mia);
 // -------------------------------------------------------------------------------------------------
 class InputMapConfig : public std::map<KeyEventSequence, MappedAction>{};
 
+// -------------------------------------------------------------------------------------------------
+/// Dispatch latency of a mapped input sequence, see InputMapper::analyzeLatency.
+struct MappingLatency
+{
+  KeyEventSequence sequence;
+  bool reachable = false;   ///< Input from the device can trigger the mapped action at all.
+  bool firmware = false;    ///< Mapping is handled by the device firmware.
+  int worstCaseDelay = 0;   ///< Maximum delay in ms before the action is dispatched.
+  int expectedDelay = 0;    ///< Delay in ms with the currently learned input cadence.
+  std::vector<KeyEventSequence> longerSequences; ///< Mapped sequences that cause the delay.
+};
+
 // -------------------------------------------------------------------------------------------------
 class InputMapper : public QObject
 {
@@ -301,12 +313,49 @@ public:
   void addEvents(const struct input_event input_events[], size_t num);
   void addEvents(const KeyEvent& key_events);
 
+  // Direct forwarding: while no sequence is pending, frames with keys that are not part of any
+  // mapped sequence are forwarded unchanged. The input thread writes them to the virtual devices
+  // itself and hands them over with addForwardedEvents, which only updates the mapper state.
+  bool sequencePending() const;
+  bool isMappedKey(uint16_t code) const;
+  void addForwardedEvents(const struct input_event input_events[], size_t num);
+
   bool recordingMode() const;
   void setRecordingMode(bool recording);
 
   int keyEventInterval() const;
   void setKeyEventInterval(int interval);
 
+  // Latency optimized matching: If an input sequence is mapped and also the beginning of a longer
+  // sequence, the mapper waits only as long as the learned continuation cadence of the user
+  // suggests. Actions are only dispatched without waiting if no longer sequence can follow.
+  bool adaptiveSequenceTiming() const;
+  void setAdaptiveSequenceTiming(bool adaptive);
+
+  // Latency analysis of the compiled key map, for a single input sequence or for all mapped
+  // input sequences of the current configuration.
+  MappingLatency analyzeLatency(const KeyEventSequence& kes) const;
+  std::vector<MappingLatency> analyzeLatency() const;
+
+  // Offload simple one-to-one button mappings to the device firmware, if the device supports it.
+  bool firmwareRemapping() const;
+  void setFirmwareRemapping(bool enabled);
+
+  // Held keys: autorepeat frames (EV_KEY value 2) bypass the key map. Repeats of keys forwarded
+  // to the virtual devices are relayed, repeats of mapped keys are suppressed - or, if enabled,
+  // execute the action again that the press of the held key triggered.
+  bool repeatMappedActions() const;
+  void setRepeatMappedActions(bool repeat);
+
+  // Drop the autorepeat frames of the device and generate the repeats of forwarded keys on the
+  // virtual keyboard instead, at the default rate of the kernel input core.
+  bool regenerateAutorepeat() const;
+  void setRegenerateAutorepeat(bool regenerate);
+
+  // Mapped input sequences handled by the device firmware and excluded from the host key map.
+  const std::vector<KeyEventSequence>& firmwareMappedSequences() const;
+  void setFirmwareMappedSequences(std::vector<KeyEventSequence> sequences);
+
   using SpecialMoveInputs = std::vector<SpecialKeys::SpecialKeyEventSeqInfo>;
   const SpecialMoveInputs& specialMoveInputs();
   void setSpecialMoveInputs(SpecialMoveInputs moveInputs);
@@ -319,8 +368,13 @@ public:
   void setConfiguration(InputMapConfig&& config);
   const InputMapConfig& configuration() const;
 
+  // 'device' label value used for the per-device input metrics.
+  void setMetricsDeviceLabel(const QString& label);
+
 signals:
   void configurationChanged();
+  void sequenceTimingChanged(); // dispatch timing of the mapped input sequences changed
+  void firmwareRemappingChanged(bool enabled);
   void recordingModeChanged(bool recording);
   void keyEventRecorded(const KeyEvent&);
   // Right before first key event recorded:
@@ -330,6 +384,9 @@ signals:
 
   void actionMapped(std::shared_ptr<Action> action);
 
+  void sequencePendingChanged(bool pending);
+  void directForwardingChanged(); // mapped keys, recording mode or autorepeat handling changed
+
 private:
   struct Impl;
   std::unique_ptr<Impl> impl;
@@ -12,6 +12,7 @@
 #include "settings.h"
 #include "spotlight.h"
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QLabel>
 #include <QLayout>
@@ -36,6 +37,17 @@ namespace {
 
   const auto invalidDeviceId = DeviceId(); // vendorId = 0, productId = 0
 
+  // Key of the device UI state, see Spotlight::deviceUiState
+  constexpr char uiStatePageKey[] = "page";
+
+  QString featureString(uint16_t featureCode)
+  {
+    const auto code = QString("0x%1").arg(hexId(featureCode));
+    QString name = toString(static_cast<HIDPP::FeatureCode>(featureCode));
+    if (name.endsWith("(unknown)")) { return code; }
+    return QString("%1 (%2)").arg(name.remove("FeatureCode::"), code);
+  }
+
   bool removeTab(QTabWidget* tabWidget, QWidget* widget)
   {
     const auto idx = tabWidget->indexOf(widget);
@@ -108,6 +120,7 @@ QWidget* DevicesWidget::createDevicesWidget(Settings* settings, Spotlight* spotl
 
   m_tabWidget = new QTabWidget(dw);
   vLayout->addWidget(m_tabWidget);
+  connect(m_tabWidget, &QTabWidget::tabBarClicked, this, [this]() { m_pendingPage.clear(); });
 
   m_tabWidget->addTab(createInputMapperWidget(settings, spotlight), tr("Input Mapping"));
   m_timerTabWidget = createTimerTabWidget(settings, spotlight);
@@ -163,12 +176,43 @@ QWidget* DevicesWidget::createInputMapperWidget(Settings* settings, Spotlight* /
                                      : settings->deviceInputSeqInterval(currentDeviceId()));
   intervalSb->setSingleStep(50);
 
+  const auto adaptiveCb = new QCheckBox(tr("Adaptive"), imWidget);
+  adaptiveCb->setToolTip(tr("Learn how fast you continue input sequences and wait only as long as "
+                            "needed before executing an action that is also the beginning of a "
+                            "longer sequence."));
+  adaptiveCb->setChecked(m_inputMapper ? m_inputMapper->adaptiveSequenceTiming()
+                                       : settings->deviceAdaptiveInputSeq(currentDeviceId()));
+
+  const auto firmwareCb = new QCheckBox(tr("Device Remapping"), imWidget);
+  firmwareCb->setToolTip(tr("Let the device remap buttons that are mapped to the key of another "
+                            "button and do not use hold events. Only supported by some devices, "
+                            "e.g. the Logitech Spotlight."));
+  firmwareCb->setChecked(m_inputMapper ? m_inputMapper->firmwareRemapping()
+                                       : settings->deviceFirmwareRemapping(currentDeviceId()));
+
+  const auto repeatCb = new QCheckBox(tr("Repeat Actions"), imWidget);
+  repeatCb->setToolTip(tr("Execute the action of a mapped button again while the button is held "
+                          "and the device repeats it. Otherwise repeats of mapped buttons are "
+                          "ignored."));
+  repeatCb->setChecked(m_inputMapper ? m_inputMapper->repeatMappedActions()
+                                     : settings->deviceRepeatMappedActions(currentDeviceId()));
+
+  const auto regenerateCb = new QCheckBox(tr("Regenerate Repeats"), imWidget);
+  regenerateCb->setToolTip(tr("Ignore the key repeats of the device and repeat held keys that are "
+                              "not mapped on the virtual keyboard instead, at a steady rate."));
+  regenerateCb->setChecked(m_inputMapper ? m_inputMapper->regenerateAutorepeat()
+                                         : settings->deviceRegenerateAutorepeat(currentDeviceId()));
+
   intervalLayout->addWidget(addBtn);
   intervalLayout->addWidget(delBtn);
   intervalLayout->addStretch(1);
   intervalLayout->addWidget(intervalLbl);
   intervalLayout->addWidget(intervalSb);
   intervalLayout->addWidget(intervalUnitLbl);
+  intervalLayout->addWidget(adaptiveCb);
+  intervalLayout->addWidget(firmwareCb);
+  intervalLayout->addWidget(repeatCb);
+  intervalLayout->addWidget(regenerateCb);
 
   const auto tblView = new InputMapConfigView(imWidget);
   const auto imModel = new InputMapConfigModel(m_inputMapper, currentDeviceId(), imWidget);
@@ -183,11 +227,17 @@ QWidget* DevicesWidget::createInputMapperWidget(Settings* settings, Spotlight* /
   updateImWidget();
 
   connect(this, &DevicesWidget::currentDeviceChanged, this,
-  [this, imModel, intervalSb, updateImWidget=std::move(updateImWidget)](const DeviceId& dId)
+  [this, imModel, intervalSb, adaptiveCb, firmwareCb, repeatCb, regenerateCb,
+   updateImWidget=std::move(updateImWidget)]
+  (const DeviceId& dId)
   {
     imModel->setInputMapper(m_inputMapper);
     if (m_inputMapper) {
       intervalSb->setValue(m_inputMapper->keyEventInterval());
+      adaptiveCb->setChecked(m_inputMapper->adaptiveSequenceTiming());
+      firmwareCb->setChecked(m_inputMapper->firmwareRemapping());
+      repeatCb->setChecked(m_inputMapper->repeatMappedActions());
+      regenerateCb->setChecked(m_inputMapper->regenerateAutorepeat());
       imModel->setConfiguration(m_inputMapper->configuration());
       imModel->setDeviceId(dId);
     }
@@ -202,6 +252,34 @@ QWidget* DevicesWidget::createInputMapperWidget(Settings* settings, Spotlight* /
     }
   });
 
+  connect(adaptiveCb, &QCheckBox::toggled, this, [this, settings](bool adaptive) {
+    if (m_inputMapper) {
+      m_inputMapper->setAdaptiveSequenceTiming(adaptive);
+      settings->setDeviceAdaptiveInputSeq(currentDeviceId(), adaptive);
+    }
+  });
+
+  connect(firmwareCb, &QCheckBox::toggled, this, [this, settings](bool enabled) {
+    if (m_inputMapper) {
+      m_inputMapper->setFirmwareRemapping(enabled);
+      settings->setDeviceFirmwareRemapping(currentDeviceId(), enabled);
+    }
+  });
+
+  connect(repeatCb, &QCheckBox::toggled, this, [this, settings](bool repeat) {
+    if (m_inputMapper) {
+      m_inputMapper->setRepeatMappedActions(repeat);
+      settings->setDeviceRepeatMappedActions(currentDeviceId(), repeat);
+    }
+  });
+
+  connect(regenerateCb, &QCheckBox::toggled, this, [this, settings](bool regenerate) {
+    if (m_inputMapper) {
+      m_inputMapper->setRegenerateAutorepeat(regenerate);
+      settings->setDeviceRegenerateAutorepeat(currentDeviceId(), regenerate);
+    }
+  });
+
   connect(selectionModel, &QItemSelectionModel::selectionChanged, this,
   [delBtn, selectionModel](){
     delBtn->setEnabled(selectionModel->hasSelection());
@@ -244,21 +322,33 @@ void DevicesWidget::createDeviceComboBox(Spotlight* spotlight)
   }
 
   connect(spotlight, &Spotlight::deviceDisconnected, this,
-  [this](const DeviceId& id, const QString& /*name*/)
+  [this, spotlight](const DeviceId& id, const QString& /*name*/)
   {
     const auto idx = m_devicesCombo->findData(QVariant::fromValue(id));
-    if (idx >= 0) {
+    if (idx >= 0)
+    {
+      // Remember the page of the current device, to show it again if the device reconnects.
+      if (idx == m_devicesCombo->currentIndex() && m_tabWidget) {
+        spotlight->setDeviceUiState(id, {{uiStatePageKey,
+                                          m_tabWidget->tabText(m_tabWidget->currentIndex())}});
+      }
       m_devicesCombo->removeItem(idx);
     }
   });
 
   connect(spotlight, &Spotlight::deviceConnected, this,
-  [this](const DeviceId& id, const QString& name)
+  [this, spotlight](const DeviceId& id, const QString& name)
   {
     const auto data = QVariant::fromValue(id);
     if (m_devicesCombo->findData(data) < 0) {
       m_devicesCombo->addItem(descriptionString(name, id), data);
     }
+
+    if (currentDeviceId() == id)
+    {
+      m_pendingPage = spotlight->deviceUiState(id).value(uiStatePageKey).toString();
+      restorePendingPage();
+    }
   });
 
   connect(m_devicesCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this,
@@ -275,6 +365,7 @@ void DevicesWidget::createDeviceComboBox(Spotlight* spotlight)
     const auto currentConn = spotlight->deviceConnection(devId);
     m_inputMapper = currentConn ? currentConn->inputMapper().get() : nullptr;
 
+    m_pendingPage.clear();
     emit currentDeviceChanged(devId);
   });
 
@@ -374,6 +465,24 @@ void DevicesWidget::updateTimerTab(Spotlight* spotlight)
     });
   }
 
+  restorePendingPage();
+}
+
+// -------------------------------------------------------------------------------------------------
+void DevicesWidget::restorePendingPage()
+{
+  if (m_pendingPage.isEmpty() || !m_tabWidget) { return; }
+
+  // Pages like the vibration timer are only added when the device features are known.
+  for (int i = 0; i < m_tabWidget->count(); ++i)
+  {
+    if (m_tabWidget->tabText(i) == m_pendingPage)
+    {
+      m_tabWidget->setCurrentIndex(i);
+      m_pendingPage.clear();
+      return;
+    }
+  }
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -549,6 +658,12 @@ void DeviceInfoWidget::connectToSubdeviceUpdates(SubDeviceConnection* sdc)
         m_hidppInfo.presenterState = toString(s, false);
         const auto pv = hdc->protocolVersion();
         m_hidppInfo.protocolVersion = QString("%1.%2").arg(pv.major).arg(pv.minor);
+        updateHidppFeatures(hdc);
+        delayedTextEditUpdate();
+      });
+
+      connect(hdc, &SubHidppConnection::featureTableChanged, m_connectionContext, [this, hdc]() {
+        updateHidppFeatures(hdc);
         delayedTextEditUpdate();
       });
   }
@@ -656,6 +771,14 @@ void DeviceInfoWidget::updateTextEdit()
     cursor.insertText(" ", normalFormat);
     cursor.insertText(m_hidppInfo.hidppFlags.join(", "));
 
+    if (!m_hidppInfo.deviceFeatures.isEmpty())
+    {
+      cursor.insertBlock();
+      cursor.insertText(tr("Device features:"), italicFormat);
+      cursor.insertText(" ", normalFormat);
+      cursor.insertText(m_hidppInfo.deviceFeatures.join(", "));
+    }
+
     cursor.movePosition(QTextCursor::MoveOperation::NextBlock);
   }
 }
@@ -723,6 +846,28 @@ void DeviceInfoWidget::updateHidppInfo(SubHidppConnection* hdc)
   {
     if (hdc->hasFlags(flag)) { m_hidppInfo.hidppFlags.push_back(toString(flag, false)); }
   }
+
+  updateHidppFeatures(hdc);
+}
+
+// -------------------------------------------------------------------------------------------------
+void DeviceInfoWidget::updateHidppFeatures(SubHidppConnection* hdc)
+{
+  m_hidppInfo.deviceFeatures.clear();
+  if (hdc->presenterState() != SubHidppConnection::PresenterState::Initialized_Online) { return; }
+
+  // Only the features used by Projecteur are resolved on initialization, the complete
+  // feature table is read from the device when it is shown here for the first time.
+  const auto& featureSet = hdc->featureSet();
+  if (!featureSet.isComplete())
+  {
+    hdc->enumerateFeatures();
+    return;
+  }
+
+  for (const auto featureCode : featureSet.supportedFeatures()) {
+    m_hidppInfo.deviceFeatures.push_back(featureString(featureCode));
+  }
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -44,6 +44,7 @@ private:
   QWidget* createDeviceInfoWidget(Spotlight* spotlight);
   TimerTabWidget* createTimerTabWidget(Settings* settings, Spotlight* spotlight);
   void updateTimerTab(Spotlight* spotlight);
+  void restorePendingPage();
 
   QComboBox* m_devicesCombo = nullptr;
   QTabWidget* m_tabWidget = nullptr;
@@ -52,6 +53,7 @@ private:
   QWidget* m_deviceDetailsTabWidget = nullptr;
 
   QPointer<InputMapper> m_inputMapper;
+  QString m_pendingPage; ///< Page to show for a reconnected device, once it is available
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -88,6 +90,7 @@ private:
   void connectToSubdeviceUpdates(SubDeviceConnection* sdc);
   void connectToBatteryUpdates(SubHidppConnection* hdc);
   void updateHidppInfo(SubHidppConnection* hdc);
+  void updateHidppFeatures(SubHidppConnection* hdc);
   void updateBatteryInfo(SubHidppConnection* hdc);
 
   void delayedTextEditUpdate();
@@ -113,6 +116,7 @@ private:
     QString presenterState;
     QString protocolVersion;
     QStringList hidppFlags;
+    QStringList deviceFeatures;
 
     void clear()
     {
@@ -120,6 +124,7 @@ private:
       presenterState.clear();
       protocolVersion.clear();
       hidppFlags.clear();
+      deviceFeatures.clear();
     }
   };
 
@@ -0,0 +1,196 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "hid-descriptor.h"
+
+#include <map>
+
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  namespace ItemType {
+    constexpr uint8_t Main = 0;
+    constexpr uint8_t Global = 1;
+    constexpr uint8_t Local = 2;
+  }
+
+  namespace MainTag {
+    constexpr uint8_t Input = 0x8;
+  }
+
+  namespace GlobalTag {
+    constexpr uint8_t UsagePage = 0x0;
+    constexpr uint8_t ReportSize = 0x7;
+    constexpr uint8_t ReportId = 0x8;
+    constexpr uint8_t ReportCount = 0x9;
+    constexpr uint8_t Push = 0xa;
+    constexpr uint8_t Pop = 0xb;
+  }
+
+  namespace LocalTag {
+    constexpr uint8_t Usage = 0x0;
+    constexpr uint8_t UsageMinimum = 0x1;
+    constexpr uint8_t UsageMaximum = 0x2;
+  }
+
+  constexpr uint8_t LongItemPrefix = 0xfe;
+  constexpr uint32_t MaxReportBits = 0xffff;
+  constexpr uint32_t MaxFieldBits = 32;
+  constexpr size_t MaxFields = 4096; // per descriptor
+
+  // -----------------------------------------------------------------------------------------------
+  struct GlobalState
+  {
+    uint16_t usagePage = 0;
+    uint32_t reportSize = 0;
+    uint32_t reportCount = 0;
+    uint8_t reportId = 0;
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  struct LocalState
+  {
+    std::vector<uint32_t> usages;
+    uint32_t usageMinimum = 0;
+    uint32_t usageMaximum = 0;
+    bool hasUsageRange = false;
+
+    /// Extended (32 bit) usage for the field at index i, the upper 16 bits are the usage page.
+    uint32_t usage(size_t i) const
+    {
+      if (i < usages.size()) { return usages[i]; }
+      if (hasUsageRange && usageMinimum + i <= usageMaximum) {
+        return usageMinimum + static_cast<uint32_t>(i);
+      }
+      if (hasUsageRange) { return usageMaximum; }
+      return usages.empty() ? 0 : usages.back();
+    }
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  uint32_t itemData(const uint8_t* data, size_t size)
+  {
+    uint32_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+      value |= static_cast<uint32_t>(data[i]) << (8 * i);
+    }
+    return value;
+  }
+} // end anonymous namespace
+
+namespace HidDescriptor {
+// -------------------------------------------------------------------------------------------------
+uint32_t Field::extract(const uint8_t* report, size_t size) const
+{
+  uint32_t value = 0;
+  for (uint32_t bit = 0; bit < bitSize && bit < 32; ++bit)
+  {
+    const uint32_t pos = bitOffset + bit;
+    if (pos / 8 >= size) { break; }
+    value |= static_cast<uint32_t>((report[pos / 8] >> (pos % 8)) & 0x1) << bit;
+  }
+  return value;
+}
+
+// -------------------------------------------------------------------------------------------------
+InputReports parseInputReports(const uint8_t* descriptor, size_t size)
+{
+  InputReports result;
+  std::vector<GlobalState> globalStack;
+  GlobalState global;
+  LocalState local;
+  std::map<uint8_t, uint32_t> reportBits; // current input report length in bits per report ID
+
+  size_t pos = 0;
+  while (pos < size)
+  {
+    const uint8_t prefix = descriptor[pos];
+    if (prefix == LongItemPrefix)
+    { // Long items are reserved and carry no information for us, just skip them.
+      if (pos + 1 >= size) { return InputReports(); }
+      pos += 3 + descriptor[pos + 1];
+      continue;
+    }
+
+    const size_t dataSize = (prefix & 0x3) == 3 ? 4 : (prefix & 0x3);
+    const uint8_t type = (prefix >> 2) & 0x3;
+    const uint8_t tag = (prefix >> 4) & 0xf;
+    if (pos + 1 + dataSize > size) { return InputReports(); }
+    const uint32_t data = itemData(&descriptor[pos + 1], dataSize);
+    pos += 1 + dataSize;
+
+    if (type == ItemType::Main)
+    {
+      if (tag == MainTag::Input)
+      {
+        auto& bits = reportBits[global.reportId];
+        if (bits == 0 && global.reportId != 0) { bits = 8; } // report ID byte
+
+        // Reject field sizes we cannot extract and reports or field counts that no real device
+        // has, before anything is allocated for them.
+        if (global.reportCount > 0)
+        {
+          if (global.reportSize == 0 || global.reportSize > MaxFieldBits) { return InputReports(); }
+          const auto inputBits = static_cast<uint64_t>(global.reportCount) * global.reportSize;
+          if (bits + inputBits > MaxReportBits) { return InputReports(); }
+          if (result.fields.size() + global.reportCount > MaxFields) { return InputReports(); }
+        }
+
+        for (uint32_t i = 0; i < global.reportCount; ++i)
+        {
+          const uint32_t usage = local.usage(i);
+          Field field;
+          field.reportId = global.reportId;
+          field.bitOffset = static_cast<uint16_t>(bits);
+          field.bitSize = static_cast<uint8_t>(global.reportSize);
+          field.usagePage = (usage > 0xffff) ? static_cast<uint16_t>(usage >> 16) : global.usagePage;
+          field.usage = static_cast<uint16_t>(usage & 0xffff);
+          field.isConstant = (data & 0x1) != 0;
+          field.isVariable = (data & 0x2) != 0;
+          result.fields.push_back(field);
+
+          bits += global.reportSize;
+        }
+      }
+      // Local items only apply to the next main item
+      local = LocalState();
+    }
+    else if (type == ItemType::Global)
+    {
+      switch (tag)
+      {
+      case GlobalTag::UsagePage: global.usagePage = static_cast<uint16_t>(data); break;
+      case GlobalTag::ReportSize: global.reportSize = data; break;
+      case GlobalTag::ReportCount: global.reportCount = data; break;
+      case GlobalTag::ReportId:
+        global.reportId = static_cast<uint8_t>(data);
+        result.usesReportIds = true;
+        break;
+      case GlobalTag::Push: globalStack.push_back(global); break;
+      case GlobalTag::Pop:
+        if (globalStack.empty()) { return InputReports(); }
+        global = globalStack.back();
+        globalStack.pop_back();
+        break;
+      }
+    }
+    else if (type == ItemType::Local)
+    {
+      // Usages with a size of 4 bytes contain the usage page in the upper 16 bits, otherwise the
+      // usage page in effect at the next main item applies.
+      switch (tag)
+      {
+      case LocalTag::Usage: local.usages.push_back(data); break;
+      case LocalTag::UsageMinimum: local.usageMinimum = data; local.hasUsageRange = true; break;
+      case LocalTag::UsageMaximum: local.usageMaximum = data; local.hasUsageRange = true; break;
+      }
+    }
+  }
+
+  for (const auto& report : reportBits) {
+    const size_t bytes = (report.second + 7) / 8;
+    if (bytes > result.maxReportSize) { result.maxReportSize = bytes; }
+  }
+
+  return result;
+}
+} // end namespace HidDescriptor
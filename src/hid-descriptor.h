@@ -0,0 +1,48 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// HID report descriptor parsing
+// - see 'Device Class Definition for HID 1.11', chapter 6.2.2 Report Descriptor
+
+namespace HidDescriptor {
+  // -----------------------------------------------------------------------------------------------
+  /// Location and usage of a single input field within a report.
+  struct Field
+  {
+    uint8_t reportId = 0;   ///< Report ID, 0 if the device does not use report IDs.
+    uint16_t bitOffset = 0; ///< Bit offset from the start of the report, including the report ID.
+    uint8_t bitSize = 0;
+    uint16_t usagePage = 0;
+    uint16_t usage = 0;
+    bool isConstant = false;
+    bool isVariable = false;
+
+    /// Vendor defined usage page, these usages are usually not mapped by the kernel to evdev.
+    bool isVendorDefined() const { return usagePage >= 0xff00; }
+    bool isVendorButton() const { return isVendorDefined() && isVariable && !isConstant && bitSize == 1; }
+
+    /// Extract the (unsigned) field value from the given report.
+    uint32_t extract(const uint8_t* report, size_t size) const;
+  };
+
+  using FieldTable = std::vector<Field>;
+
+  // -----------------------------------------------------------------------------------------------
+  /// Result of parsing a report descriptor.
+  struct InputReports
+  {
+    FieldTable fields;
+    bool usesReportIds = false;
+    size_t maxReportSize = 0; ///< Size in bytes of the largest input report, including the ID.
+  };
+
+  /// Parse the input items of a report descriptor. Malformed descriptors, including field sizes
+  /// of 0 or more than 32 bits, reports above 64k bits and descriptors with more than 4096 input
+  /// fields, result in an empty field table.
+  InputReports parseInputReports(const uint8_t* descriptor, size_t size);
+} // end namespace HidDescriptor
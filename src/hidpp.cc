@@ -8,6 +8,8 @@
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
 #include <random>
 
@@ -29,12 +31,24 @@ namespace {
   constexpr char featureSetFilename[] = "DeviceFeatureSet.conf";
   constexpr char firmwareKey[] = "firmwareVersion";
   constexpr char featureTableKey[] = "featureTable";
+  constexpr char featureTableCompleteKey[] = "featureTableComplete";
 
   // -----------------------------------------------------------------------------------------------
   namespace Defaults {
     constexpr uint8_t HidppSoftwareId = 7;
+    constexpr uint8_t MaxSoftwareId = 0xf;
   } // end namespace Defaults
 
+  // -----------------------------------------------------------------------------------------------
+  /// Next software id for concurrent requests, skipping 0 (notifications) and the default id.
+  uint8_t nextSoftwareId(uint8_t swId)
+  {
+    do {
+      swId = (swId >= Defaults::MaxSoftwareId) ? 1 : swId + 1;
+    } while (swId == Defaults::HidppSoftwareId);
+    return swId;
+  }
+
   // -----------------------------------------------------------------------------------------------
   // -- HID++ message offsets
   namespace Offset {
@@ -356,6 +370,42 @@ void FeatureSet::setState(State s)
   emit stateChanged(m_state);
 }
 
+// -------------------------------------------------------------------------------------------------
+FeatureSet::Snapshot FeatureSet::snapshot() const
+{
+  if (m_state != State::Initialized) { return Snapshot(); }
+  return Snapshot{m_mainFirmwareInfo, m_featureTable, m_complete};
+}
+
+// -------------------------------------------------------------------------------------------------
+bool FeatureSet::restore(const Snapshot& snapshot)
+{
+  if (m_state != State::Uninitialized || !snapshot.isValid()) { return false; }
+
+  m_snapshot = snapshot;
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool FeatureSet::loadFromSnapshot()
+{
+  const auto snapshot = std::move(m_snapshot);
+  m_snapshot = Snapshot();
+  if (!snapshot.isValid() || !m_mainFirmwareInfo.isValid()) { return false; }
+
+  // The device could have been updated in between, with a different feature table.
+  if (!(snapshot.mainFirmwareInfo == m_mainFirmwareInfo))
+  {
+    logDebug(hid) << tr("Firmware changed, discarded feature set from memory");
+    return false;
+  }
+
+  m_featureTable = snapshot.featureTable;
+  m_complete = snapshot.complete;
+  logDebug(hid) << tr("Restored feature set with %1 entries from memory").arg(m_featureTable.size());
+  return true;
+}
+
 // -------------------------------------------------------------------------------------------------
 void FeatureSet::getFeatureIndex(FeatureCode fc, std::function<void(MsgResult, uint8_t)> cb)
 {
@@ -489,9 +539,108 @@ void FeatureSet::getMainFirmwareInfo(uint8_t fwIndex, uint8_t max, uint8_t curre
 }
 
 // -------------------------------------------------------------------------------------------------
-void FeatureSet::initFromDevice(DeviceId dId, std::function<void(State)> cb)
+void FeatureSet::getFeatureIndexes(const FeatureCodes& features,
+                                   std::function<void(MsgResult, FeatureTable&&)> cb)
 {
-  postSelf([this, dId, cb=std::move(cb)]() mutable
+  if (m_connection == nullptr)
+  {
+    if (cb) { cb(MsgResult::WriteError, FeatureTable{}); }
+    return;
+  }
+
+  if (features.empty())
+  {
+    if (cb) { cb(MsgResult::Ok, FeatureTable{}); }
+    return;
+  }
+
+  struct Resolution {
+    FeatureTable featureTable;
+    MsgResult result = MsgResult::Ok;
+    size_t pending = 0;
+    std::function<void(MsgResult, FeatureTable&&)> cb;
+  };
+
+  auto resolution = std::make_shared<Resolution>();
+  resolution->pending = features.size();
+  resolution->cb = std::move(cb);
+
+  // All requests are sent at once, instead of one after another. Requests to the root feature
+  // only differ in the payload, a distinct software id for each request makes sure the replies
+  // are matched with the right request.
+  uint8_t swId = 0;
+  for (const auto fc : features)
+  {
+    swId = nextSoftwareId(swId);
+    const auto fcMSB = static_cast<uint8_t>(to_integral(fc) >> 8);
+    const auto fcLSB = static_cast<uint8_t>(to_integral(fc) & 0x00ff);
+
+    Message featureIndexReqMsg(Message::Type::Long, DeviceIndex::WirelessDevice1, 0, 0, swId,
+                               Message::Data{fcMSB, fcLSB});
+
+    m_connection->sendRequest(std::move(featureIndexReqMsg),
+    [resolution, fc](MsgResult result, Message&& msg)
+    {
+      logDebug(hid) << tr("getFeatureIndex(%1) => %2, %3")
+                       .arg(to_integral(fc)).arg(toString(result))
+                       .arg((result != MsgResult::Ok) ? 0 : msg[4]);
+
+      if (result == MsgResult::Ok) {
+        resolution->featureTable[to_integral(fc)] = msg[4];
+      }
+      else if (resolution->result == MsgResult::Ok) {
+        resolution->result = result;
+      }
+
+      if (--resolution->pending == 0 && resolution->cb) {
+        resolution->cb(resolution->result, std::move(resolution->featureTable));
+      }
+    });
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool FeatureSet::loadFromCache(DeviceId dId)
+{
+  const auto cacheFile = QStandardPaths::locate(
+    QStandardPaths::StandardLocation::AppLocalDataLocation, featureSetFilename);
+
+  if (cacheFile.isEmpty() || !m_mainFirmwareInfo.isValid()) { return false; }
+
+  QSettings settings(cacheFile, QSettings::NativeFormat);
+  const auto fw = settings.value(settingsKey(dId, firmwareKey));
+  if (!fw.canConvert<FirmwareInfo>() || !(fw.value<FirmwareInfo>() == m_mainFirmwareInfo)) {
+    return false;
+  }
+
+  const auto table = settings.value(settingsKey(dId, featureTableKey));
+  if (!table.canConvert<FeatureTable>()) { return false; }
+
+  m_featureTable = table.value<FeatureTable>();
+  m_complete = settings.value(settingsKey(dId, featureTableCompleteKey), false).toBool();
+  logDebug(hid) << tr("Loaded feature set with %1 entries from local cache").arg(m_featureTable.size());
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void FeatureSet::storeInCache(DeviceId dId) const
+{
+  const auto dataPath = QStandardPaths::writableLocation(
+    QStandardPaths::StandardLocation::AppLocalDataLocation);
+
+  if (dataPath.isEmpty() || !m_mainFirmwareInfo.isValid()) { return; }
+
+  const auto cacheFile = QDir(dataPath).filePath(featureSetFilename);
+  QSettings settings(cacheFile, QSettings::NativeFormat);
+  settings.setValue(settingsKey(dId, firmwareKey), QVariant::fromValue(m_mainFirmwareInfo));
+  settings.setValue(settingsKey(dId, featureTableKey), QVariant::fromValue(m_featureTable));
+  settings.setValue(settingsKey(dId, featureTableCompleteKey), m_complete);
+}
+
+// -------------------------------------------------------------------------------------------------
+void FeatureSet::initFromDevice(DeviceId dId, FeatureCodes features, std::function<void(State)> cb)
+{
+  postSelf([this, dId, features=std::move(features), cb=std::move(cb)]() mutable
   {
     if (m_connection == nullptr || m_state == State::Initialized || m_state == State::Initializing)
     {
@@ -500,9 +649,12 @@ void FeatureSet::initFromDevice(DeviceId dId, std::function<void(State)> cb)
     }
 
     setState(State::Initializing);
+    m_featureTable.clear();
+    m_complete = false;
 
     getMainFirmwareInfo(makeSafeCallback(
-    [this, dId, cb=std::move(cb)](MsgResult res, FirmwareInfo&& fi) mutable
+    [this, dId, features=std::move(features), cb=std::move(cb)]
+    (MsgResult res, FirmwareInfo&& fi) mutable
     {
       logDebug(hid) << tr("getMainFirmwareInfo() => %1, fi.type = %2").arg(toString(res))
       .arg(to_integral(fi.firmwareType()));
@@ -511,74 +663,85 @@ void FeatureSet::initFromDevice(DeviceId dId, std::function<void(State)> cb)
         m_mainFirmwareInfo = std::move(fi);
       }
 
-      // --- Try to load feature set from cache file
-      const auto cacheFile = QStandardPaths::locate(
-        QStandardPaths::StandardLocation::AppLocalDataLocation, featureSetFilename);
+      // --- Try to restore the feature set from memory or to load it from the cache file
+      const bool cached = (res == MsgResult::Ok) && (loadFromSnapshot() || loadFromCache(dId));
 
-      if (!cacheFile.isEmpty() && res == MsgResult::Ok && m_mainFirmwareInfo.isValid())
+      // Only resolve features that are not known yet, instead of reading the complete table.
+      FeatureCodes unresolved;
+      if (!m_complete)
       {
-        // load feature set and return
-        QSettings settings(cacheFile, QSettings::NativeFormat);
-        const auto fw = settings.value(settingsKey(dId, firmwareKey));
-        if (fw.canConvert<FirmwareInfo>())
-        {
-          auto cacheFirmwareInfo = fw.value<FirmwareInfo>();
-          if (cacheFirmwareInfo == m_mainFirmwareInfo)
-          {
-            const auto table = settings.value(settingsKey(dId, featureTableKey));
-            if (table.canConvert<FeatureTable>())
-            {
-              m_featureTable = table.value<FeatureTable>();
-              logDebug(hid) << tr("Loaded feature set with %1 entries from local cache").arg(m_featureTable.size());
-              setState(State::Initialized);
-              if (cb) { cb(m_state); }
-              return;
-            }
-          }
-        }
+        std::copy_if(features.cbegin(), features.cend(), std::back_inserter(unresolved),
+        [this](FeatureCode fc) { return m_featureTable.count(to_integral(fc)) == 0; });
       }
 
-      getFeatureCount(makeSafeCallback(
-      [this, dId, cb=std::move(cb)](MsgResult res, uint8_t featureIndex, uint8_t count) mutable
+      if (cached && unresolved.empty())
       {
-        logDebug(hid) << tr("getFeatureCount() => %1, featureIndex = %2, count = %3")
-                         .arg(toString(res)).arg(featureIndex).arg(count);
+        setState(State::Initialized);
+        if (cb) { cb(m_state); }
+        return;
+      }
 
-        if (res != MsgResult::Ok)
-        {
+      getFeatureIndexes(unresolved, makeSafeCallback(
+      [this, dId, cb=std::move(cb)](MsgResult res, FeatureTable&& ft)
+      {
+        if (res != MsgResult::Ok) {
           setState(State::Error);
-          if (cb) { cb(m_state); }
-          return;
         }
+        else
+        {
+          m_featureTable.insert(ft.cbegin(), ft.cend());
+          setState(State::Initialized);
+          // Store feature table in cache file
+          storeInCache(dId);
+        }
+
+        if (cb) { cb(m_state); }
+      })); // getFeatureIndexes
+    })); // getMainFwInfo
+  }); // postSelf
+}
 
-        getFeatureIds(featureIndex, count, makeSafeCallback(
-        [this, dId, cb=std::move(cb)](MsgResult res, FeatureTable&& ft)
+// -------------------------------------------------------------------------------------------------
+void FeatureSet::enumerateFeatures(DeviceId dId, std::function<void(bool)> cb)
+{
+  postSelf([this, dId, cb=std::move(cb)]() mutable
+  {
+    if (m_complete || m_state != State::Initialized)
+    {
+      if (cb) { cb(m_complete); }
+      return;
+    }
+
+    getFeatureCount(makeSafeCallback(
+    [this, dId, cb=std::move(cb)](MsgResult res, uint8_t featureIndex, uint8_t count) mutable
+    {
+      logDebug(hid) << tr("getFeatureCount() => %1, featureIndex = %2, count = %3")
+                       .arg(toString(res)).arg(featureIndex).arg(count);
+
+      if (res != MsgResult::Ok)
+      {
+        if (cb) { cb(false); }
+        return;
+      }
+
+      getFeatureIds(featureIndex, count, makeSafeCallback(
+      [this, dId, cb=std::move(cb)](MsgResult res, FeatureTable&& ft)
+      {
+        if (res == MsgResult::Ok)
         {
-          if (res != MsgResult::Ok) {
-            setState(State::Error);
-          }
-          else
-          {
-            m_featureTable = std::move(ft);
-            setState(State::Initialized);
-
-            // Store feature table in cache file
-            const auto dataPath = QStandardPaths::writableLocation(
-              QStandardPaths::StandardLocation::AppLocalDataLocation);
-
-            if (!dataPath.isEmpty() && m_mainFirmwareInfo.isValid())
-            {
-              const auto cacheFile = QDir(dataPath).filePath(featureSetFilename);
-              QSettings settings(cacheFile, QSettings::NativeFormat);
-              settings.setValue(settingsKey(dId, firmwareKey), QVariant::fromValue(m_mainFirmwareInfo));
-              settings.setValue(settingsKey(dId, featureTableKey), QVariant::fromValue(m_featureTable));
-            }
+          // Features not in the table are not supported, keep them marked as such.
+          for (auto& feature : m_featureTable) {
+            const auto it = ft.find(feature.first);
+            feature.second = (it == ft.cend()) ? 0 : it->second;
           }
+          m_featureTable.insert(ft.cbegin(), ft.cend());
+          m_complete = true;
+          storeInCache(dId);
+        }
 
-          if (cb) { cb(m_state); }
-        })); // getFeatureIds (table)
-      })); // getFeatureCount
-    })); // getMainFwInfo
+        if (cb) { cb(m_complete); }
+      })); // getFeatureIds (table)
+    })); // getFeatureCount
   }); // postSelf
 }
 
@@ -630,8 +793,24 @@ void FeatureSet::getFeatureIds(uint8_t featureSetIndex, uint8_t count,
 // -------------------------------------------------------------------------------------------------
 bool FeatureSet::featureCodeSupported(FeatureCode fc) const
 {
-  const auto featurePair = m_featureTable.find(to_integral(fc));
-  return (featurePair != m_featureTable.end());
+  return featureIndex(fc) != 0x00;
+}
+
+// -------------------------------------------------------------------------------------------------
+size_t FeatureSet::featureCount() const
+{
+  return static_cast<size_t>(std::count_if(m_featureTable.cbegin(), m_featureTable.cend(),
+    [](const FeatureTable::value_type& f) { return f.second != 0x00; }));
+}
+
+// -------------------------------------------------------------------------------------------------
+std::vector<uint16_t> FeatureSet::supportedFeatures() const
+{
+  std::vector<uint16_t> features;
+  for (const auto& feature : m_featureTable) {
+    if (feature.second != 0x00) { features.push_back(feature.first); }
+  }
+  return features;
 }
 
 // -------------------------------------------------------------------------------------------------
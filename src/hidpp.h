@@ -51,6 +51,24 @@ namespace HIDPP {
     PointerSpeed         = 0x2205,
   };
 
+  // -----------------------------------------------------------------------------------------------
+  /// Functions, control IDs and reporting flags of the ReprogramControlsV4 feature (0x1b04)
+  namespace ReprogramControls {
+    constexpr uint8_t SetCidReporting = 3;
+
+    namespace ControlId { // Logitech Spotlight
+      constexpr uint16_t Next = 0x00da;
+      constexpr uint16_t Back = 0x00dc;
+    }
+
+    namespace Flags {
+      constexpr uint8_t Divert = 0x01;
+      constexpr uint8_t DivertValid = 0x02;
+      constexpr uint8_t RawXY = 0x10;
+      constexpr uint8_t RawXYValid = 0x20;
+    }
+  } // end namespace ReprogramControls
+
   // -----------------------------------------------------------------------------------------------
   /// Hid++ 2.0 error codes
   enum class Error : uint8_t {
@@ -336,17 +354,41 @@ namespace HIDPP {
     Q_OBJECT
 
   public:
+    /// Feature code to feature index, an index of 0 marks a feature not supported by the device.
     using FeatureTable = std::map<uint16_t, uint8_t>;
+    using FeatureCodes = std::vector<FeatureCode>;
     enum class State : uint8_t { Uninitialized, Initializing, Initialized, Error };
 
+    /// Resolved features of an initialized feature set, e.g. to keep them across reconnects.
+    struct Snapshot {
+      FirmwareInfo mainFirmwareInfo;
+      FeatureTable featureTable;
+      bool complete = false;
+      bool isValid() const { return !featureTable.empty(); }
+    };
+
     FeatureSet(HidppConnectionInterface* connection, QObject* parent = nullptr);
 
-    void initFromDevice(DeviceId dId, std::function<void(State)> cb);
+    /// Resolves the feature indexes of the given features, from the local cache if possible.
+    /// Other features of the device stay unknown until enumerateFeatures() is called.
+    void initFromDevice(DeviceId dId, FeatureCodes features, std::function<void(State)> cb);
+    /// Reads the complete feature table from the device, e.g. for diagnostics.
+    void enumerateFeatures(DeviceId dId, std::function<void(bool success)> cb);
     State state() const;
 
+    /// Snapshot of the resolved features, invalid if the feature set is not initialized.
+    Snapshot snapshot() const;
+    /// Uses a snapshot instead of resolving the features on the next initFromDevice(), if the
+    /// main firmware of the device still matches the firmware of the snapshot.
+    bool restore(const Snapshot& snapshot);
+
     uint8_t featureIndex(FeatureCode fc) const;
     bool featureCodeSupported(FeatureCode fc) const;
-    auto featureCount() const { return m_featureTable.size(); }
+    size_t featureCount() const;
+    /// True if the feature table was read completely from the device.
+    bool isComplete() const { return m_complete; }
+    /// Supported feature codes known so far, all supported features if isComplete().
+    std::vector<uint16_t> supportedFeatures() const;
 
   signals:
     void stateChanged(State s);
@@ -355,6 +397,8 @@ namespace HIDPP {
     using MsgResult = HidppConnectionInterface::MsgResult;
 
     void getFeatureIndex(FeatureCode fc, std::function<void(MsgResult, uint8_t)> cb);
+    void getFeatureIndexes(const FeatureCodes& features,
+                           std::function<void(MsgResult, FeatureTable&&)> cb);
     void getFeatureCount(std::function<void(MsgResult, uint8_t featureIndex, uint8_t count)> cb);
     void getFirmwareCount(std::function<void(MsgResult, uint8_t featureIndex, uint8_t count)> cb);
     void getFeatureIds(uint8_t featureSetIndex, uint8_t count,
@@ -366,10 +410,15 @@ namespace HIDPP {
                          std::function<void(MsgResult, FirmwareInfo&&)> cb);
 
     void setState(State s);
+    bool loadFromSnapshot();
+    bool loadFromCache(DeviceId dId);
+    void storeInCache(DeviceId dId) const;
 
     HidppConnectionInterface* m_connection = nullptr;
     FeatureTable m_featureTable;
+    bool m_complete = false;
     FirmwareInfo m_mainFirmwareInfo;
+    Snapshot m_snapshot; // restored, until the firmware of the device is checked
 
     State m_state = State::Uninitialized;
   };
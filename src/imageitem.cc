@@ -3,33 +3,146 @@
 
 #include "imageitem.h"
 
-#include <QPainter>
+#include <QQuickWindow>
+#include <QSGGeometryNode>
+#include <QSGTexture>
+#include <QSGTextureMaterial>
+
+#include <cmath>
+#include <memory>
 
 namespace {
   const bool registered = [](){
     ProjecteurImage::qmlRegister();
     return true;
   }();
-}
 
+  namespace Defaults {
+    // Above this on-screen scale the texture is always sampled with nearest filtering, below it
+    // only for integral scales. Linear filtering would blur the magnified pixels too much.
+    constexpr qreal nearestFilterMinScale = 3.0;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  class TextureNode : public QSGGeometryNode
+  {
+  public:
+    TextureNode()
+      : m_geometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), 4)
+    {
+      setGeometry(&m_geometry);
+      setMaterial(&m_material);
+      setOpaqueMaterial(&m_opaqueMaterial);
+    }
+
+    void setTexture(QSGTexture* texture)
+    {
+      m_texture.reset(texture);
+      m_material.setTexture(texture);
+      m_opaqueMaterial.setTexture(texture);
+      markDirty(DirtyMaterial);
+    }
+
+    QSGTexture* texture() const { return m_texture.get(); }
+
+    void setFiltering(QSGTexture::Filtering filtering, QSGTexture::Filtering mipmapFiltering)
+    {
+      if (m_material.filtering() == filtering && m_material.mipmapFiltering() == mipmapFiltering) {
+        return;
+      }
+
+      for (auto material : {static_cast<QSGOpaqueTextureMaterial*>(&m_material), &m_opaqueMaterial})
+      {
+        material->setFiltering(filtering);
+        material->setMipmapFiltering(mipmapFiltering);
+      }
+      markDirty(DirtyMaterial);
+    }
+
+    void setRect(const QRectF& rect)
+    {
+      QSGGeometry::updateTexturedRectGeometry(&m_geometry, rect,
+                                              m_texture->normalizedTextureSubRect());
+      markDirty(DirtyGeometry);
+    }
+
+  private:
+    QSGGeometry m_geometry;
+    QSGTextureMaterial m_material;
+    QSGOpaqueTextureMaterial m_opaqueMaterial;
+    std::unique_ptr<QSGTexture> m_texture;
+  };
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
 ProjecteurImage::ProjecteurImage(QQuickItem *parent)
-  : QQuickPaintedItem(parent)
+  : QQuickItem(parent)
 {
-  setRenderTarget(QQuickPaintedItem::FramebufferObject);
+  setFlag(QQuickItem::ItemHasContents);
 }
 
+// -------------------------------------------------------------------------------------------------
 int ProjecteurImage::qmlRegister()
 {
   return qmlRegisterType<ProjecteurImage>("Projecteur.Utils", 1, 0, "Image");
 }
 
+// -------------------------------------------------------------------------------------------------
 void ProjecteurImage::setPixmap(QPixmap pm)
 {
   m_pixmap = pm;
+  m_pixmapChanged = true;
   update();
 }
 
-void ProjecteurImage::paint(QPainter *painter)
+// -------------------------------------------------------------------------------------------------
+void ProjecteurImage::setMagnification(qreal magnification)
 {
-  painter->drawPixmap(QRectF(0, 0, width(), height()), m_pixmap, m_pixmap.rect());
+  if (qFuzzyCompare(m_magnification, magnification)) { return; }
+
+  m_magnification = magnification;
+  update();
+  emit magnificationChanged(m_magnification);
+}
+
+// -------------------------------------------------------------------------------------------------
+QSGNode* ProjecteurImage::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* /* data */)
+{
+  auto node = static_cast<TextureNode*>(oldNode);
+
+  if (m_pixmap.isNull() || width() <= 0 || height() <= 0)
+  {
+    delete node;
+    m_pixmapChanged = false;
+    return nullptr;
+  }
+
+  if (!node) {
+    node = new TextureNode();
+    m_pixmapChanged = true;
+  }
+
+  if (m_pixmapChanged)
+  { // Upload the capture with its native device pixels, no CPU side scaling.
+    node->setTexture(window()->createTextureFromImage(m_pixmap.toImage(),
+                                                      QQuickWindow::TextureHasMipmaps));
+    m_pixmapChanged = false;
+  }
+
+  // On-screen device pixels per texture pixel
+  const qreal scale = m_magnification * window()->devicePixelRatio() * width() / m_pixmap.width();
+
+  if (scale < 1.0) {
+    node->setFiltering(QSGTexture::Linear, QSGTexture::Linear);
+  }
+  else if (smooth() || (scale < Defaults::nearestFilterMinScale
+                        && !qFuzzyCompare(scale, std::round(scale)))) {
+    node->setFiltering(QSGTexture::Linear, QSGTexture::None);
+  }
+  else {
+    node->setFiltering(QSGTexture::Nearest, QSGTexture::None);
+  }
+
+  node->setRect(boundingRect());
+  return node;
 }
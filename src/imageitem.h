@@ -2,13 +2,16 @@
 // - See LICENSE.md and README.md
 #pragma once
 
-#include <QQuickPaintedItem>
+#include <QQuickItem>
 #include <QPixmap>
 
-class ProjecteurImage : public QQuickPaintedItem
+/// Displays a pixmap at its native resolution as a mipmapped texture. The texture filter is chosen
+/// depending on the on-screen scale of the texture (e.g. by the zoom factor set as magnification).
+class ProjecteurImage : public QQuickItem
 {
   Q_OBJECT
   Q_PROPERTY(QPixmap pixmap READ pixmap WRITE setPixmap)
+  Q_PROPERTY(qreal magnification READ magnification WRITE setMagnification NOTIFY magnificationChanged)
 
 public:
   static int qmlRegister();
@@ -16,10 +19,20 @@ public:
   explicit ProjecteurImage(QQuickItem *parent = nullptr);
   virtual ~ProjecteurImage() override = default;
 
-  virtual void paint(QPainter *painter) override;
   void setPixmap(QPixmap pm);
   QPixmap pixmap() const { return m_pixmap; }
 
+  void setMagnification(qreal magnification);
+  qreal magnification() const { return m_magnification; }
+
+signals:
+  void magnificationChanged(qreal magnification);
+
+protected:
+  QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data) override;
+
 private:
   QPixmap m_pixmap;
+  bool m_pixmapChanged = false;
+  qreal m_magnification = 1.0;
 };
@@ -0,0 +1,325 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "inputbenchmark.h"
+
+#include "logging.h"
+#include "spotlight.h"
+#include "virtualdevice.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <unistd.h>
+
+LOGGING_CATEGORY(benchmark, "benchmark")
+
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  namespace Defaults {
+    constexpr std::chrono::milliseconds drainTimeout{500};
+    constexpr int pollIntervalMs = 100;
+    constexpr int maxRate = 100000;
+    constexpr int maxDuration = 3600;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  int64_t nowUs()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  void setTimestampUs(input_event& ev, int64_t us)
+  {
+  #if defined(input_event_sec)
+    ev.input_event_sec = us / 1000000;
+    ev.input_event_usec = us % 1000000;
+  #else
+    ev.time.tv_sec = us / 1000000;
+    ev.time.tv_usec = us % 1000000;
+  #endif
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  int64_t timestampUs(const input_event& ev)
+  {
+  #if defined(input_event_sec)
+    return static_cast<int64_t>(ev.input_event_sec) * 1000000 + ev.input_event_usec;
+  #else
+    return static_cast<int64_t>(ev.time.tv_sec) * 1000000 + ev.time.tv_usec;
+  #endif
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Events (without EV_SYN) of the frame at the given step of a pattern, empty for idle steps.
+  std::vector<input_event> patternFrame(InputBenchmark::Pattern pattern, uint64_t step)
+  {
+    using Pattern = InputBenchmark::Pattern;
+    const auto key = [](int32_t value) {
+      return std::vector<input_event>{ input_event{{}, EV_KEY, KEY_RIGHT, value} };
+    };
+
+    switch (pattern)
+    {
+    case Pattern::Motion: { // Move back and forth, so the cursor does not drift away
+      const int32_t delta = (step % 2) ? -1 : 1;
+      return { input_event{{}, EV_REL, REL_X, delta}, input_event{{}, EV_REL, REL_Y, delta} };
+    }
+    case Pattern::Press:
+      return key((step % 2) ? 0 : 1);
+    case Pattern::DoublePress: { // press, release, press, release, 4x idle
+      const auto pos = step % 8;
+      return (pos < 4) ? key((pos % 2) ? 0 : 1) : std::vector<input_event>();
+    }
+    case Pattern::Hold: { // press, 18x autorepeat, release
+      const auto pos = step % 20;
+      return key(pos == 0 ? 1 : pos == 19 ? 0 : 2);
+    }
+    }
+    return {};
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  const char* toString(InputBenchmark::Pattern pattern)
+  {
+    switch (pattern) {
+    case InputBenchmark::Pattern::Motion: return "motion";
+    case InputBenchmark::Pattern::Press: return "press";
+    case InputBenchmark::Pattern::DoublePress: return "double-press";
+    case InputBenchmark::Pattern::Hold: return "hold";
+    }
+    return "unknown";
+  }
+
+  class i18n : public QObject {}; // for i18n and logging
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+bool InputBenchmark::parseOptions(const QString& spec, Options& options, QString& error)
+{
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    const auto items = spec.split(QLatin1Char(','), Qt::SkipEmptyParts);
+  #else
+    const auto items = spec.split(QLatin1Char(','), QString::SkipEmptyParts);
+  #endif
+
+  for (const auto& item : items)
+  {
+    const auto keyValue = item.split('=');
+    const auto key = keyValue[0].trimmed().toLower();
+    const auto value = keyValue.size() > 1 ? keyValue[1].trimmed().toLower() : QString();
+    bool ok = true;
+
+    if (key == "pattern")
+    {
+      const std::array<Pattern, 4> patterns{{ Pattern::Motion, Pattern::Press,
+                                              Pattern::DoublePress, Pattern::Hold }};
+      const auto it = std::find_if(patterns.cbegin(), patterns.cend(), [&value](Pattern p) {
+        return value == toString(p);
+      });
+      ok = (it != patterns.cend());
+      if (ok) { options.pattern = *it; }
+    }
+    else if (key == "rate") {
+      options.rate = value.toInt(&ok);
+      ok = ok && options.rate > 0 && options.rate <= Defaults::maxRate;
+    }
+    else if (key == "duration") {
+      options.duration = value.toInt(&ok);
+      ok = ok && options.duration > 0 && options.duration <= Defaults::maxDuration;
+    }
+    else if (key == "overlay") {
+      options.overlay = (value == "on" || value == "true" || value == "1");
+      ok = options.overlay || value == "off" || value == "false" || value == "0";
+    }
+    else {
+      ok = false;
+    }
+
+    if (!ok)
+    {
+      error = i18n::tr("Invalid benchmark option: '%1'").arg(item);
+      return false;
+    }
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+InputBenchmark::InputBenchmark(const Options& options, QObject* parent)
+  : QObject(parent)
+  , m_options(options)
+{
+  connect(this, &InputBenchmark::measurementDone, this, &InputBenchmark::onMeasurementDone,
+          Qt::QueuedConnection);
+}
+
+// -------------------------------------------------------------------------------------------------
+InputBenchmark::~InputBenchmark()
+{
+  m_stop = true;
+  if (m_generatorThread.joinable()) { m_generatorThread.join(); }
+  if (m_sinkThread.joinable()) { m_sinkThread.join(); }
+  if (m_sourceWriteFd != -1) { ::close(m_sourceWriteFd); }
+  if (m_sinkReadFd != -1) { ::close(m_sinkReadFd); }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputBenchmark::start(Spotlight* spotlight)
+{
+  int sourcePipe[2] = {-1, -1};
+  int sinkPipe[2] = {-1, -1};
+  if (::pipe2(sourcePipe, O_CLOEXEC) != 0 || ::pipe2(sinkPipe, O_CLOEXEC) != 0)
+  {
+    logError(benchmark) << i18n::tr("Cannot create pipes for the input benchmark.");
+    for (const int fd : {sourcePipe[0], sourcePipe[1], sinkPipe[0], sinkPipe[1]}) {
+      if (fd != -1) { ::close(fd); }
+    }
+    return false;
+  }
+
+  m_sourceWriteFd = sourcePipe[1];
+  m_sinkReadFd = sinkPipe[0];
+  fcntl(m_sourceWriteFd, F_SETFL, fcntl(m_sourceWriteFd, F_GETFL, 0) | O_NONBLOCK);
+
+  // Spotlight takes ownership of the source read and the sink write descriptor.
+  auto sinkDevice = VirtualDevice::createFromFd(sinkPipe[1], "Projecteur_benchmark_sink");
+  if (!spotlight->connectBenchmarkDevice(sourcePipe[0], std::move(sinkDevice)))
+  {
+    logError(benchmark) << i18n::tr("Cannot connect the input benchmark device.");
+    return false;
+  }
+
+  logInfo(benchmark) << i18n::tr("Input benchmark started: pattern=%1, rate=%2/s, duration=%3s")
+                        .arg(toString(m_options.pattern)).arg(m_options.rate).arg(m_options.duration);
+
+  m_startTime = Clock::now();
+  m_sinkThread = std::thread([this](){ sink(); });
+  m_generatorThread = std::thread([this](){ generate(); });
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputBenchmark::generate()
+{
+  const auto interval = std::chrono::nanoseconds(std::chrono::seconds(1)) / m_options.rate;
+  const auto end = m_startTime + std::chrono::seconds(m_options.duration);
+  auto next = m_startTime;
+  std::vector<input_event> frame;
+
+  for (uint64_t step = 0; !m_stop && next < end; ++step, next += interval)
+  {
+    std::this_thread::sleep_until(next);
+
+    frame = patternFrame(m_options.pattern, step);
+    if (frame.empty()) { continue; }
+
+    frame.push_back(input_event{{}, EV_SYN, SYN_REPORT, 0});
+    const auto stamp = nowUs();
+    for (auto& ev : frame) { setTimestampUs(ev, stamp); }
+
+    // If Projecteur cannot keep up and the pipe is full, the generator is throttled.
+    const auto size = static_cast<ssize_t>(frame.size() * sizeof(input_event));
+    ssize_t res = -1;
+    while (!m_stop && (res = ::write(m_sourceWriteFd, frame.data(), static_cast<size_t>(size))) < 0
+           && errno == EAGAIN)
+    {
+      pollfd pfd{m_sourceWriteFd, POLLOUT, 0};
+      ::poll(&pfd, 1, Defaults::pollIntervalMs);
+    }
+    if (res != size) { break; }
+    ++m_framesInjected;
+  }
+
+  m_generatorEndTime = Clock::now().time_since_epoch().count();
+  m_generatorDone = true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputBenchmark::sink()
+{
+  std::array<input_event, 64> events;
+  int64_t frameStamp = 0;
+  auto lastData = Clock::now();
+
+  while (!m_stop)
+  {
+    pollfd pfd{m_sinkReadFd, POLLIN, 0};
+    const int res = ::poll(&pfd, 1, Defaults::pollIntervalMs);
+    const auto now = Clock::now();
+
+    if (res <= 0)
+    {
+      // Done when the generator finished and nothing arrived for a while.
+      if (m_generatorDone && now - lastData > Defaults::drainTimeout) { break; }
+      continue;
+    }
+
+    const auto bytes = ::read(m_sinkReadFd, events.data(), sizeof(events));
+    if (bytes <= 0) { break; }
+
+    const int64_t arrivalUs = nowUs();
+    lastData = now;
+    for (size_t i = 0; i < static_cast<size_t>(bytes) / sizeof(input_event); ++i)
+    {
+      const auto& ev = events[i];
+      if (frameStamp == 0) { frameStamp = timestampUs(ev); }
+      if (ev.type != EV_SYN || ev.code != SYN_REPORT) { continue; }
+
+      // Events created by actions do not carry the timestamp of the input frame.
+      ++m_framesReceived;
+      if (frameStamp != 0) {
+        m_latenciesUs.push_back(arrivalUs - frameStamp);
+      } else {
+        ++m_framesUnstamped;
+      }
+      frameStamp = 0;
+    }
+  }
+
+  emit measurementDone();
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputBenchmark::onMeasurementDone()
+{
+  m_stop = true;
+  if (m_generatorThread.joinable()) { m_generatorThread.join(); }
+  if (m_sinkThread.joinable()) { m_sinkThread.join(); }
+  std::sort(m_latenciesUs.begin(), m_latenciesUs.end());
+  emit finished();
+}
+
+// -------------------------------------------------------------------------------------------------
+QString InputBenchmark::report() const
+{
+  const auto end = Clock::time_point(Clock::duration(m_generatorEndTime.load()));
+  const double seconds = std::chrono::duration<double>(end - m_startTime).count();
+  const auto percentile = [this](double p) -> int64_t {
+    if (m_latenciesUs.empty()) { return 0; }
+    const auto index = static_cast<size_t>(std::ceil(p / 100.0 * m_latenciesUs.size())) - 1;
+    return m_latenciesUs[std::min(index, m_latenciesUs.size() - 1)];
+  };
+
+  QStringList lines;
+  lines << QString("pattern: %1, rate: %2/s, duration: %3s, overlay: %4")
+           .arg(toString(m_options.pattern)).arg(m_options.rate).arg(m_options.duration)
+           .arg(m_options.overlay ? "on" : "off");
+  lines << QString("frames injected: %1, received: %2 (%3 without input timestamp)")
+           .arg(m_framesInjected.load()).arg(m_framesReceived).arg(m_framesUnstamped);
+  lines << QString("throughput: %1 frames/s")
+           .arg(seconds > 0 ? m_framesReceived / seconds : 0.0, 0, 'f', 1);
+  lines << QString("latency (us): p50=%1 p90=%2 p99=%3 p99.9=%4 max=%5")
+           .arg(percentile(50)).arg(percentile(90)).arg(percentile(99)).arg(percentile(99.9))
+           .arg(m_latenciesUs.empty() ? 0 : m_latenciesUs.back());
+  return lines.join('\n');
+}
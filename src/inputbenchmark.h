@@ -0,0 +1,79 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QObject>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+class Spotlight;
+
+// -------------------------------------------------------------------------------------------------
+/// End-to-end benchmark of the input pipeline without hardware and root permissions.
+///
+/// A generator thread writes timestamped input event frames into a pipe that is read by a
+/// synthetic Spotlight event device. All events that leave Projecteur through the virtual devices
+/// are written to a second pipe, where a sink thread measures the latency from the timestamp of
+/// each frame. Everything in between - socket notifier, Spotlight, InputMapper, action dispatch
+/// and virtual device write - runs in the regular Qt event loop.
+class InputBenchmark : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum class Pattern : uint8_t { Motion, Press, DoublePress, Hold };
+
+  struct Options {
+    Pattern pattern = Pattern::Motion;
+    int rate = 500;       ///< Frames per second
+    int duration = 10;    ///< Seconds
+    bool overlay = false; ///< Keep the spot overlay enabled while benchmarking.
+  };
+
+  /// Parse a benchmark specification, e.g. 'pattern=hold,rate=1000,duration=5,overlay=on'
+  static bool parseOptions(const QString& spec, Options& options, QString& error);
+
+  explicit InputBenchmark(const Options& options, QObject* parent = nullptr);
+  ~InputBenchmark() override;
+
+  const Options& options() const { return m_options; }
+
+  /// Connect the benchmark device to spotlight and start generating input.
+  bool start(Spotlight* spotlight);
+
+  /// Human readable summary with throughput and latency percentiles, valid after finished().
+  QString report() const;
+
+signals:
+  void finished();
+  void measurementDone(); // emitted by the sink thread
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  void generate();
+  void sink();
+  void onMeasurementDone();
+
+  const Options m_options;
+  int m_sourceWriteFd = -1;
+  int m_sinkReadFd = -1;
+
+  std::atomic<bool> m_stop{false};
+  std::atomic<bool> m_generatorDone{false};
+  std::atomic<uint64_t> m_framesInjected{0};
+  Clock::time_point m_startTime;
+  std::atomic<Clock::rep> m_generatorEndTime{0};
+
+  // Only accessed by the sink thread until measurementDone()
+  uint64_t m_framesReceived = 0;
+  uint64_t m_framesUnstamped = 0;
+  std::vector<int64_t> m_latenciesUs;
+
+  std::thread m_generatorThread;
+  std::thread m_sinkThread;
+};
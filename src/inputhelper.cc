@@ -0,0 +1,456 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "inputhelper.h"
+
+#include "device-command-helper.h"
+#include "logging.h"
+#include "metrics.h"
+#include "settings.h"
+#include "spotlight.h"
+
+#include <QDataStream>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTimer>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+LOGGING_CATEGORY(inputhelper, "inputhelper")
+
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  constexpr char wakeupByte = '!';
+
+  // -----------------------------------------------------------------------------------------------
+  QByteArray sharedMemoryName() {
+    return QString("/%1-input-%2").arg(QCoreApplication::applicationName().toLower())
+                                  .arg(getuid()).toLocal8Bit();
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  int64_t monotonicUs()
+  {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  template<size_t N>
+  void copyText(char (&dest)[N], const QString& text)
+  {
+    const auto utf8 = text.toUtf8();
+    const auto size = std::min(static_cast<size_t>(utf8.size()), N - 1);
+    std::memcpy(dest, utf8.constData(), size);
+    dest[size] = '\0';
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Map the shared memory ring of a running input helper, nullptr if not available.
+  InputHelperShared* mapSharedMemory()
+  {
+    const int fd = shm_open(sharedMemoryName().constData(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) { return nullptr; }
+
+    struct stat st{};
+    void* mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(InputHelperShared)) {
+      mem = mmap(nullptr, sizeof(InputHelperShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mem == MAP_FAILED) { return nullptr; }
+
+    const auto shared = static_cast<InputHelperShared*>(mem);
+    if (shared->magic.load(std::memory_order_acquire) != InputHelperShared::Magic
+        || shared->version != InputHelperShared::Version
+        || shared->capacity != InputHelperShared::Capacity)
+    {
+      munmap(mem, sizeof(InputHelperShared));
+      return nullptr;
+    }
+    return shared;
+  }
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+InputHelperServer::InputHelperServer(Spotlight* spotlight, DeviceCommandHelper* commandHelper,
+                                     QObject* parent)
+  : QObject(parent)
+  , m_spotlight(spotlight)
+  , m_commandHelper(commandHelper)
+  , m_controlServer(new QLocalServer(this))
+{
+  // Create a new shared memory ring, a stale one from a crashed helper is replaced.
+  const auto shmName = sharedMemoryName();
+  shm_unlink(shmName.constData());
+  const int fd = shm_open(shmName.constData(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+  if (fd >= 0)
+  {
+    if (ftruncate(fd, sizeof(InputHelperShared)) == 0)
+    {
+      void* mem = mmap(nullptr, sizeof(InputHelperShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (mem != MAP_FAILED)
+      {
+        m_shared = new (mem) InputHelperShared();
+        m_shared->helperPid.store(static_cast<uint32_t>(getpid()), std::memory_order_relaxed);
+        m_shared->magic.store(InputHelperShared::Magic, std::memory_order_release);
+      }
+    }
+    ::close(fd);
+  }
+
+  if (!m_shared) {
+    logError(inputhelper) << tr("Could not create the input helper shared memory: %1")
+                             .arg(strerror(errno));
+  }
+
+  using Type = InputHelperShared::Event::Type;
+
+  connect(spotlight, &Spotlight::spotActiveChanged, this, [this](bool active)
+  {
+    if (m_shared) { m_shared->spotActive.store(active ? 1 : 0, std::memory_order_relaxed); }
+    InputHelperShared::Event event;
+    event.type = Type::SpotActive;
+    event.value = active ? 1 : 0;
+    publish(event);
+  });
+
+  connect(spotlight, &Spotlight::deviceConnected, this,
+  [this](const DeviceId& id, const QString& name) {
+    publishDevice(Type::DeviceConnected, id.vendorId, id.productId, name);
+  });
+
+  connect(spotlight, &Spotlight::deviceDisconnected, this,
+  [this](const DeviceId& id, const QString& name) {
+    publishDevice(Type::DeviceDisconnected, id.vendorId, id.productId, name);
+  });
+
+  // Actions of the input mapping that change the settings (cycle presets, toggle spotlight) are
+  // executed by the user interface: the settings of the helper do not follow its changes.
+  connect(spotlight, &Spotlight::cyclePresetsMapped, this, [this]()
+  {
+    InputHelperShared::Event event;
+    event.type = Type::CyclePresets;
+    publish(event);
+  });
+
+  connect(spotlight, &Spotlight::toggleSpotlightMapped, this, [this]()
+  {
+    InputHelperShared::Event event;
+    event.type = Type::ToggleSpotlight;
+    publish(event);
+  });
+
+  QLocalServer::removeServer(ProjecteurInputHelperApp::controlServerName());
+  if (m_controlServer->listen(ProjecteurInputHelperApp::controlServerName()))
+  {
+    connect(m_controlServer, &QLocalServer::newConnection, this, [this]()
+    {
+      while (QLocalSocket *client = m_controlServer->nextPendingConnection())
+      {
+        connect(client, &QLocalSocket::readyRead, this, [this, client]() {
+          readCommand(client);
+        });
+        connect(client, &QLocalSocket::disconnected, this, [this, client]() {
+          m_clients.erase(client);
+          client->deleteLater();
+        });
+        m_clients.emplace(client, 0);
+        logDebug(inputhelper) << tr("User interface connected to the input helper.");
+      }
+    });
+  }
+  else
+  {
+    logError(inputhelper) << tr("Error starting the input helper control socket.");
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+InputHelperServer::~InputHelperServer()
+{
+  m_controlServer->close();
+  if (m_shared)
+  {
+    munmap(m_shared, sizeof(InputHelperShared));
+    shm_unlink(sharedMemoryName().constData());
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputHelperServer::isListening() const {
+  return m_shared && m_controlServer->isListening();
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputHelperServer::publish(const InputHelperShared::Event& event)
+{
+  if (!m_shared) { return; }
+
+  const auto head = m_shared->head.load(std::memory_order_relaxed);
+  if (head - m_shared->tail.load(std::memory_order_acquire) >= InputHelperShared::Capacity)
+  { // No user interface running or it does not keep up; the current state is in the header.
+    m_shared->droppedEvents.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto& item = m_shared->events[head & (InputHelperShared::Capacity - 1)];
+  item = event;
+  item.timeUs = monotonicUs();
+
+  // Sequentially consistent with the tail store of the consumer: either the consumer sees the new
+  // head or we see that the ring was empty and wake it up.
+  m_shared->head.store(head + 1, std::memory_order_seq_cst);
+  if (m_shared->tail.load(std::memory_order_seq_cst) != head) { return; }
+
+  for (const auto& client : m_clients)
+  {
+    client.first->write(&wakeupByte, 1);
+    client.first->flush();
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputHelperServer::publishDevice(InputHelperShared::Event::Type type, uint16_t vendorId,
+                                      uint16_t productId, const QString& name)
+{
+  if (m_shared && m_spotlight) {
+    m_shared->connectedDevices.store(m_spotlight->connectedDeviceCount(), std::memory_order_relaxed);
+  }
+
+  InputHelperShared::Event event;
+  event.type = type;
+  event.vendorId = vendorId;
+  event.productId = productId;
+  copyText(event.text, name);
+  publish(event);
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputHelperServer::readCommand(QLocalSocket* client)
+{
+  const auto it = m_clients.find(client);
+  if (it == m_clients.end()) { return; }
+
+  quint32& commandSize = it->second;
+  while (true)
+  {
+    // Same framing as the commands of the main application: quint32 size, then the command.
+    if (commandSize == 0)
+    {
+      if (client->bytesAvailable() < static_cast<int>(sizeof(quint32))) { return; }
+
+      QDataStream in(client);
+      in >> commandSize;
+      if (commandSize == 0 || commandSize > 256)
+      {
+        logWarning(inputhelper) << tr("Received invalid command size (%1)").arg(commandSize);
+        client->disconnectFromServer();
+        return;
+      }
+    }
+
+    if (client->bytesAvailable() < commandSize) { return; }
+
+    const auto command = QString::fromLocal8Bit(client->read(commandSize));
+    commandSize = 0;
+
+    const QString cmdKey = command.section('=', 0, 0).trimmed();
+    const QString cmdValue = command.section('=', 1).trimmed();
+
+    if (cmdKey == "quit")
+    {
+      logDebug(inputhelper) << tr("Received quit command.");
+      QCoreApplication::quit();
+    }
+    else if (cmdKey == "vibrate" && m_commandHelper)
+    {
+      const auto args = cmdValue.split(QLatin1Char(','));
+      const int intensity = args.size() >= 1 ? args[0].toInt() : 128;
+      const int length = args.size() >= 2 ? args[1].toInt() : 0;
+      m_commandHelper->sendVibrateCommand(static_cast<uint8_t>(qBound(0, intensity, 255)),
+                                          static_cast<uint8_t>(qBound(0, length, 10)));
+    }
+    else {
+      logWarning(inputhelper) << tr("Received unknown command: '%1'").arg(command);
+    }
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+InputHelperClient::InputHelperClient(Spotlight* spotlight, QObject* parent)
+  : QObject(parent)
+  , m_spotlight(spotlight)
+  , m_control(new QLocalSocket(this))
+  , m_reconnectTimer(new QTimer(this))
+  , m_eventDelay(metrics::histogram("projecteur_input_helper_event_delay_seconds",
+                                    "Delay from an event in the input helper until it was "
+                                    "processed by the user interface."))
+{
+  constexpr int reconnectIntervalMs = 1000;
+  m_reconnectTimer->setInterval(reconnectIntervalMs);
+  connect(m_reconnectTimer, &QTimer::timeout, this, &InputHelperClient::connectToHelper);
+
+  connect(m_control, &QLocalSocket::connected, this, &InputHelperClient::onConnected);
+  connect(m_control, &QLocalSocket::disconnected, this, &InputHelperClient::onDisconnected);
+  connect(m_control, &QLocalSocket::readyRead, this, [this]() {
+    m_control->readAll(); // wakeup bytes only
+    drainEvents();
+  });
+
+  connectToHelper();
+  m_reconnectTimer->start();
+}
+
+// -------------------------------------------------------------------------------------------------
+InputHelperClient::~InputHelperClient()
+{
+  if (m_shared) { munmap(m_shared, sizeof(InputHelperShared)); }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputHelperClient::isConnected() const {
+  return m_shared != nullptr;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputHelperClient::sendCommand(const QString& command)
+{
+  if (!isConnected()) { return false; }
+
+  const auto data = command.toLocal8Bit();
+  QByteArray block;
+  QDataStream out(&block, QIODevice::WriteOnly);
+  out << static_cast<quint32>(data.size());
+  block.append(data);
+  return m_control->write(block) == block.size();
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputHelperClient::connectToHelper()
+{
+  if (m_control->state() != QLocalSocket::UnconnectedState) { return; }
+  m_control->connectToServer(ProjecteurInputHelperApp::controlServerName());
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputHelperClient::onConnected()
+{
+  m_shared = mapSharedMemory();
+  if (!m_shared)
+  {
+    logWarning(inputhelper) << tr("Input helper shared memory not available.");
+    m_control->disconnectFromServer();
+    return;
+  }
+
+  m_reconnectTimer->stop();
+
+  // Skip events from before this connection, the current state is in the header.
+  m_shared->tail.store(m_shared->head.load(std::memory_order_acquire), std::memory_order_seq_cst);
+  if (m_spotlight) {
+    m_spotlight->setSpotActive(m_shared->spotActive.load(std::memory_order_relaxed) != 0);
+  }
+
+  logInfo(inputhelper) << tr("Connected to the input helper (pid %1, %2 device(s)).")
+                          .arg(m_shared->helperPid.load(std::memory_order_relaxed))
+                          .arg(m_shared->connectedDevices.load(std::memory_order_relaxed));
+  emit connectedChanged(true);
+  drainEvents();
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputHelperClient::onDisconnected()
+{
+  if (m_shared)
+  {
+    munmap(m_shared, sizeof(InputHelperShared));
+    m_shared = nullptr;
+    logWarning(inputhelper) << tr("Disconnected from the input helper.");
+    if (m_spotlight) { m_spotlight->setSpotActive(false); }
+    emit connectedChanged(false);
+  }
+  m_reconnectTimer->start();
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputHelperClient::drainEvents()
+{
+  if (!m_shared) { return; }
+
+  auto tail = m_shared->tail.load(std::memory_order_relaxed);
+  while (tail != m_shared->head.load(std::memory_order_seq_cst))
+  {
+    const auto event = m_shared->events[tail & (InputHelperShared::Capacity - 1)];
+    m_shared->tail.store(++tail, std::memory_order_seq_cst);
+
+    m_eventDelay.observe(static_cast<uint64_t>(std::max<int64_t>(0, monotonicUs() - event.timeUs)));
+    applyEvent(event);
+    if (!m_shared) { return; } // disconnected while applying the event
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputHelperClient::applyEvent(const InputHelperShared::Event& event)
+{
+  using Type = InputHelperShared::Event::Type;
+
+  const auto text = QString::fromUtf8(event.text, static_cast<int>(strnlen(event.text, sizeof(event.text))));
+  switch (event.type)
+  {
+  case Type::SpotActive:
+    if (m_spotlight) { m_spotlight->setSpotActive(event.value != 0); }
+    break;
+  case Type::DeviceConnected:
+    logInfo(inputhelper) << tr("Input helper connected device: %1 (%2:%3)")
+                            .arg(text, logging::hexId(event.vendorId), logging::hexId(event.productId));
+    break;
+  case Type::DeviceDisconnected:
+    logInfo(inputhelper) << tr("Input helper disconnected device: %1 (%2:%3)")
+                            .arg(text, logging::hexId(event.vendorId), logging::hexId(event.productId));
+    break;
+  case Type::CyclePresets:
+    if (m_spotlight) { m_spotlight->cyclePresets(); }
+    break;
+  case Type::ToggleSpotlight:
+    if (m_spotlight) { m_spotlight->toggleSpotlight(); }
+    break;
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+ProjecteurInputHelperApp::ProjecteurInputHelperApp(int &argc, char **argv, const Options& options)
+  : QGuiApplication(argc, argv)
+{
+  m_settings = options.configFile.isEmpty() ? new Settings(this)
+                                            : new Settings(options.configFile, this);
+  m_spotlight = new Spotlight(this, Spotlight::Options{options.enableUInput, options.additionalDevices,
+                                                       options.inputThread, true, false},
+                              m_settings);
+  m_deviceCommandHelper = new DeviceCommandHelper(this, m_spotlight);
+  m_server = new InputHelperServer(m_spotlight, m_deviceCommandHelper, this);
+
+  if (!m_server->isListening()) {
+    QTimer::singleShot(0, this, [this](){ this->exit(2); });
+    return;
+  }
+  logInfo(inputhelper) << tr("Input helper started.");
+}
+
+// -------------------------------------------------------------------------------------------------
+ProjecteurInputHelperApp::~ProjecteurInputHelperApp() = default;
+
+// -------------------------------------------------------------------------------------------------
+QString ProjecteurInputHelperApp::controlServerName() {
+  return QCoreApplication::applicationName() + "_input_helper";
+}
@@ -0,0 +1,155 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QGuiApplication>
+#include <QObject>
+#include <QPointer>
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "devicescan.h"
+#include "inputthread.h"
+
+class DeviceCommandHelper;
+class QLocalServer;
+class QLocalSocket;
+class QTimer;
+class Settings;
+class Spotlight;
+
+namespace metrics { class Histogram; }
+
+// -------------------------------------------------------------------------------------------------
+/// Shared memory layout between the input helper process (single producer) and the user
+/// interface process (single consumer). Only lock-free atomics and plain data are used.
+struct InputHelperShared
+{
+  static_assert(ATOMIC_INT_LOCK_FREE == 2, "Lock-free 32 bit atomics required.");
+
+  static constexpr uint32_t Magic = 0x50524a49; // 'PRJI'
+  static constexpr uint32_t Version = 2;
+  static constexpr uint32_t Capacity = 256;     ///< Number of events, must be a power of two
+
+  struct Event
+  {
+    enum class Type : uint8_t {
+      SpotActive,         ///< value: active
+      DeviceConnected,    ///< vendorId, productId, text: device name
+      DeviceDisconnected, ///< vendorId, productId, text: device name
+      CyclePresets,       ///< Mapped action, applied to the settings of the user interface
+      ToggleSpotlight,    ///< Mapped action, applied to the settings of the user interface
+    };
+
+    Type type = Type::SpotActive;
+    uint8_t value = 0;
+    uint16_t vendorId = 0;
+    uint16_t productId = 0;
+    int64_t timeUs = 0; ///< CLOCK_MONOTONIC time of the event in the helper
+    char text[96] = {};
+  };
+
+  std::atomic<uint32_t> magic{0}; ///< Written last by the helper, after initialization
+  uint32_t version = Version;
+  uint32_t capacity = Capacity;
+  std::atomic<uint32_t> helperPid{0};
+  std::atomic<uint32_t> spotActive{0}; ///< Current state, for a newly connected user interface
+  std::atomic<uint32_t> connectedDevices{0};
+  std::atomic<uint32_t> droppedEvents{0};
+  std::atomic<uint32_t> head{0}; ///< Written by the helper only
+  std::atomic<uint32_t> tail{0}; ///< Written by the user interface only
+  Event events[Capacity];
+};
+
+// -------------------------------------------------------------------------------------------------
+/// Runs in the input helper process: publishes the spotlight state and actions to the shared
+/// memory ring and serves the control socket.
+class InputHelperServer : public QObject
+{
+  Q_OBJECT
+
+public:
+  InputHelperServer(Spotlight* spotlight, DeviceCommandHelper* commandHelper,
+                    QObject* parent = nullptr);
+  ~InputHelperServer() override;
+
+  bool isListening() const;
+
+private:
+  void publish(const InputHelperShared::Event& event);
+  void publishDevice(InputHelperShared::Event::Type type, uint16_t vendorId, uint16_t productId,
+                     const QString& name);
+  void readCommand(QLocalSocket* client);
+
+  QPointer<Spotlight> m_spotlight;
+  QPointer<DeviceCommandHelper> m_commandHelper;
+  QLocalServer* const m_controlServer = nullptr;
+  std::map<QLocalSocket*, quint32> m_clients; // client -> size of the pending command
+  InputHelperShared* m_shared = nullptr;
+};
+
+// -------------------------------------------------------------------------------------------------
+/// Runs in the user interface process: applies the events of the input helper and reconnects
+/// if the helper restarts. Mapped settings actions of the helper change the settings of the
+/// user interface, which owns the presets and the overlay state.
+class InputHelperClient : public QObject
+{
+  Q_OBJECT
+
+public:
+  InputHelperClient(Spotlight* spotlight, QObject* parent = nullptr);
+  ~InputHelperClient() override;
+
+  bool isConnected() const;
+
+  /// Send a command (e.g. 'vibrate=128,0') to the input helper.
+  bool sendCommand(const QString& command);
+
+signals:
+  void connectedChanged(bool connected);
+
+private:
+  void connectToHelper();
+  void onConnected();
+  void onDisconnected();
+  void drainEvents();
+  void applyEvent(const InputHelperShared::Event& event);
+
+  QPointer<Spotlight> m_spotlight;
+  QLocalSocket* const m_control = nullptr;
+  QTimer* const m_reconnectTimer = nullptr;
+  InputHelperShared* m_shared = nullptr;
+  metrics::Histogram& m_eventDelay;
+};
+
+// -------------------------------------------------------------------------------------------------
+/// Headless application for the input helper process (--input-helper): device connections,
+/// HID++, input mapping and the virtual uinput devices, without any user interface.
+class ProjecteurInputHelperApp : public QGuiApplication
+{
+  Q_OBJECT
+
+public:
+  struct Options {
+    QString configFile;
+    bool enableUInput = true;
+    InputThread::Options inputThread;
+    std::vector<SupportedDevice> additionalDevices;
+  };
+
+  explicit ProjecteurInputHelperApp(int &argc, char **argv, const Options& options);
+  ~ProjecteurInputHelperApp() override;
+
+  /// Name of the control socket of the input helper.
+  static QString controlServerName();
+
+private:
+  Settings* m_settings = nullptr;
+  Spotlight* m_spotlight = nullptr;
+  DeviceCommandHelper* m_deviceCommandHelper = nullptr;
+  InputHelperServer* m_server = nullptr;
+};
@@ -4,12 +4,15 @@
 #include "inputmapconfig.h"
 
 #include "actiondelegate.h"
+#include "device-key-lookup.h"
 #include "inputseqedit.h"
 #include "logging.h"
 
 #include <QHeaderView>
 #include <QKeyEvent>
 
+#include <linux/input.h>
+
 // -------------------------------------------------------------------------------------------------
 namespace  {
   const InputMapModelItem invalidItem_;
@@ -20,7 +23,9 @@ InputMapConfigModel::InputMapConfigModel(InputMapper* im, const DeviceId& dId, Q
   : QAbstractTableModel(parent)
   , m_currentDeviceId(dId)
   , m_inputMapper(im)
-{}
+{
+  connectInputMapper();
+}
 
 // -------------------------------------------------------------------------------------------------
 int InputMapConfigModel::rowCount(const QModelIndex& parent) const
@@ -45,10 +50,34 @@ Qt::ItemFlags InputMapConfigModel::flags(const QModelIndex &index) const
 }
 
 // -------------------------------------------------------------------------------------------------
-QVariant InputMapConfigModel::data(const QModelIndex& /*index*/, int /*role*/) const
+QVariant InputMapConfigModel::data(const QModelIndex& index, int role) const
 {
-//  if (index.row() >= static_cast<int>(m_configItems.size()))
-//    return QVariant();
+  if (index.row() >= static_cast<int>(m_configItems.size())) { return QVariant(); }
+  if (index.column() != DelayCol && !(index.column() == InputSeqCol && role == Qt::ToolTipRole)) {
+    return QVariant();
+  }
+
+  const auto& item = m_configItems[index.row()];
+  if (item.deviceSequence.empty() || !m_inputMapper) { return QVariant(); }
+
+  if (role == Qt::ToolTipRole) { return latencyToolTip(index.row()); }
+
+  const auto latency = m_inputMapper->analyzeLatency(item.deviceSequence);
+  const bool reachable = latency.reachable && !isShadowed(index.row());
+
+  if (role == Qt::DisplayRole)
+  {
+    if (!reachable) { return tr("Unreachable"); }
+    if (latency.firmware) { return tr("Device"); }
+    if (latency.expectedDelay != latency.worstCaseDelay) {
+      return tr("%1 - %2 ms").arg(latency.expectedDelay).arg(latency.worstCaseDelay);
+    }
+    return tr("%1 ms").arg(latency.worstCaseDelay);
+  }
+  else if (role == Qt::ForegroundRole && !reachable)
+  {
+    return QColor(Qt::red);
+  }
 
   return QVariant();
 }
@@ -63,6 +92,7 @@ QVariant InputMapConfigModel::headerData(int section, Qt::Orientation orientatio
     case InputSeqCol: return tr("Input Sequence");
     case ActionTypeCol: return "Type";
     case ActionCol: return tr("Mapped Action");
+    case DelayCol: return tr("Delay");
     default: return "Invalid";
     }
   }
@@ -147,6 +177,7 @@ void InputMapConfigModel::removeConfigItemRows(std::vector<int> rows)
   removeConfigItemRows(seq_first, seq_last);
   configureInputMapper();
   updateDuplicates();
+  updateLatencies();
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -177,6 +208,7 @@ void InputMapConfigModel::setInputSequence(const QModelIndex& index, const KeyEv
 
       configureInputMapper();
       updateDuplicates();
+      updateLatencies();
       emit dataChanged(index, index, {Qt::DisplayRole, Roles::InputSeqRole});
     }
   }
@@ -243,7 +275,9 @@ InputMapper* InputMapConfigModel::inputMapper() const
 // -------------------------------------------------------------------------------------------------
 void InputMapConfigModel::setInputMapper(InputMapper* im)
 {
+  if (m_inputMapper) { disconnect(m_inputMapper, nullptr, this, nullptr); }
   m_inputMapper = im;
+  connectInputMapper();
 
   if (m_inputMapper) {
     setConfiguration(m_inputMapper->configuration());
@@ -307,6 +341,71 @@ void InputMapConfigModel::updateDuplicates()
   }
 }
 
+// -------------------------------------------------------------------------------------------------
+void InputMapConfigModel::updateLatencies()
+{
+  if (m_configItems.isEmpty()) { return; }
+  emit dataChanged(index(0, DelayCol), index(m_configItems.size() - 1, DelayCol));
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputMapConfigModel::connectInputMapper()
+{
+  if (!m_inputMapper) { return; }
+  connect(m_inputMapper, &InputMapper::sequenceTimingChanged,
+          this, &InputMapConfigModel::updateLatencies);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputMapConfigModel::isShadowed(int row) const
+{
+  // Only the first item of duplicate input sequences is part of the configuration.
+  const auto& item = m_configItems[row];
+  if (!item.isDuplicate) { return false; }
+
+  for (int i = 0; i < row; ++i) {
+    if (m_configItems[i].deviceSequence == item.deviceSequence) { return true; }
+  }
+  return false;
+}
+
+// -------------------------------------------------------------------------------------------------
+QString InputMapConfigModel::latencyToolTip(int row) const
+{
+  const auto& item = m_configItems[row];
+  if (isShadowed(row)) {
+    return tr("Unreachable: The same input sequence is already mapped in a previous row.");
+  }
+
+  const auto latency = m_inputMapper->analyzeLatency(item.deviceSequence);
+  if (!latency.reachable) {
+    return tr("Unreachable: The input sequence contains events that are never matched.");
+  }
+
+  if (latency.firmware) {
+    return tr("The mapping is handled by the device without any delay.");
+  }
+
+  if (latency.longerSequences.empty()) {
+    return tr("The action is executed immediately.");
+  }
+
+  QStringList sequences;
+  for (const auto& kes : latency.longerSequences) {
+    sequences.push_back(KeyName::sequenceText(m_currentDeviceId, kes));
+  }
+
+  auto text = tr("The action is executed after up to %1 ms, "
+                 "waiting for a possible continuation with:").arg(latency.worstCaseDelay);
+  if (latency.expectedDelay != latency.worstCaseDelay) {
+    text = tr("The action is executed after %1 ms (at most %2 ms) with the learned input cadence, "
+              "waiting for a possible continuation with:")
+           .arg(latency.expectedDelay).arg(latency.worstCaseDelay);
+  }
+
+  return QString("%1\n%2").arg(text, sequences.join('\n'));
+}
+
 // -------------------------------------------------------------------------------------------------
 // -------------------------------------------------------------------------------------------------
 InputMapConfigView::InputMapConfigView(QWidget* parent)
@@ -372,6 +471,8 @@ void InputMapConfigView::setModel(QAbstractItemModel* model)
   {
     horizontalHeader()->setSectionResizeMode(InputMapConfigModel::Columns::ActionTypeCol,
                                              QHeaderView::ResizeMode::ResizeToContents);
+    horizontalHeader()->setSectionResizeMode(InputMapConfigModel::Columns::DelayCol,
+                                             QHeaderView::ResizeMode::ResizeToContents);
   }
 }
 
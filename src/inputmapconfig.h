@@ -30,7 +30,7 @@ class InputMapConfigModel : public QAbstractTableModel
 
 public:
   enum Roles { InputSeqRole = Qt::UserRole + 1, ActionTypeRole, NativeSeqRole };
-  enum Columns { InputSeqCol = 0, ActionTypeCol, ActionCol, ColumnsCount};
+  enum Columns { InputSeqCol = 0, ActionTypeCol, ActionCol, DelayCol, ColumnsCount};
 
   InputMapConfigModel(InputMapper* im, const DeviceId& dId, QObject* parent = nullptr);
 
@@ -61,6 +61,10 @@ private:
   void configureInputMapper();
   void removeConfigItemRows(int fromRow, int toRow);
   void updateDuplicates();
+  void updateLatencies();
+  void connectInputMapper();
+  bool isShadowed(int row) const;
+  QString latencyToolTip(int row) const;
 
   DeviceId m_currentDeviceId;
   QPointer<InputMapper> m_inputMapper;
@@ -45,18 +45,16 @@ namespace {
   {
     if (ke.empty()) { return 0; }
 
-    static auto const pressChar = QChar(0x2193); // ↓
-    static auto const releaseChar = QChar(0x2191); // ↑
-
-    const auto& die = (ke.back().code != SYN_REPORT) ? ke.back() : ke.front();
-    const auto& lookupName = KeyName::lookup(dId, die);
+    const auto pressChar = KeyName::pressChar();
+    const auto releaseChar = KeyName::releaseChar();
+    const auto& die = KeyName::keyEventInput(ke);
 
     // TODO Some devices (e.g. August WP 200) have buttons that send a key combination
     //      (modifiers + key) - this is ignored completely right now.
     const auto text = QString("[%1%2%3")
-                         .arg(lookupName.isEmpty() ? QString("%1").arg(die.code, 0, 16) : lookupName)
+                         .arg(KeyName::eventName(dId, die))
                          .arg(buttonTap ? pressChar
-                                        : ke.back().value ? pressChar : releaseChar)
+                                        : die.value ? pressChar : releaseChar)
                          .arg(buttonTap ? "" : "]");
 
     const auto r = QRect(QPoint(startX + option.rect.left(), option.rect.top()),
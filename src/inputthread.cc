@@ -0,0 +1,923 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "inputthread.h"
+
+#include "logging.h"
+#include "metrics.h"
+#include "virtualdevice.h"
+
+#include <QSocketNotifier>
+#include <QStringList>
+
+#if HAS_Qt_DBus
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDBusReply>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+LOGGING_CATEGORY(inputthread, "inputthread")
+
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  namespace Defaults {
+    constexpr size_t frameRingSize = 1024; // must be a power of two
+    constexpr size_t mapperReserve = 256;  // ring space pointer motion must leave to key frames
+    constexpr size_t commandRingSize = 64; // must be a power of two
+    constexpr size_t maxDevices = 32;
+    constexpr size_t maxStagedFrames = 64;
+    constexpr size_t stackPrefaultSize = 64 * 1024;
+    constexpr uint64_t wakeupToken = 0; // epoll data of the command event fd, devices use index + 1
+    constexpr char threadName[] = "projecteur-in"; // max. 15 characters
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  int64_t monotonicUs()
+  {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  int64_t timestampUs(const input_event& ev)
+  {
+  #if defined(input_event_sec)
+    return static_cast<int64_t>(ev.input_event_sec) * 1000000 + ev.input_event_usec;
+  #else
+    return static_cast<int64_t>(ev.time.tv_sec) * 1000000 + ev.time.tv_usec;
+  #endif
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  bool isMotion(const input_event* events, size_t count)
+  {
+    return count > 0 && events[0].type == EV_REL
+           && (events[0].code == REL_X || events[0].code == REL_Y);
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Same decision as the input mapper when it forwards a frame to the virtual mouse.
+  bool isMouseButton(const input_event* events, size_t count)
+  {
+    if (count < 2) { return false; }
+    const auto& ev = (events[0].type == EV_MSC) ? events[1] : events[0];
+    return ev.type == EV_KEY && ev.code >= BTN_MISC && ev.code < KEY_OK;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Lock-free ring for exactly one producer and one consumer thread, with preallocated storage.
+  template<typename T>
+  class SpscRing
+  {
+  public:
+    explicit SpscRing(size_t size) : m_items(size), m_mask(size - 1) {}
+
+    /// Producer: item to fill before push(), nullptr if the ring is full.
+    T* back()
+    {
+      const auto head = m_head.load(std::memory_order_relaxed);
+      if (head - m_tail.load(std::memory_order_acquire) == m_items.size()) { return nullptr; }
+      return &m_items[head & m_mask];
+    }
+    void push() { m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    /// Producer: number of items that can be pushed.
+    size_t available() const
+    {
+      return m_items.size() - (m_head.load(std::memory_order_relaxed)
+                               - m_tail.load(std::memory_order_acquire));
+    }
+
+    /// Consumer: oldest item, to be released with pop(), nullptr if the ring is empty.
+    T* front()
+    {
+      const auto tail = m_tail.load(std::memory_order_relaxed);
+      if (tail == m_head.load(std::memory_order_acquire)) { return nullptr; }
+      return &m_items[tail & m_mask];
+    }
+    void pop() { m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    void* data() { return m_items.data(); }
+    size_t bytes() const { return m_items.size() * sizeof(T); }
+
+  private:
+    std::vector<T> m_items;
+    const size_t m_mask;
+    std::atomic<size_t> m_head{0}; // written by the producer only
+    std::atomic<size_t> m_tail{0}; // written by the consumer only
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  struct Command
+  {
+    enum class Type : uint8_t { Add, Remove, KeyForwarding, Stop };
+    Type type = Type::Stop;
+    uint32_t device = 0;
+    size_t slot = 0;
+    int fd = -1;
+    bool nonBlocking = false;
+    VirtualDevice* mouse = nullptr;
+    VirtualDevice* keyboard = nullptr;
+    InputThread::KeyForwarding keyForwarding;
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  /// Event device as seen by the input thread, only accessed from the input thread.
+  struct Device
+  {
+    uint32_t id = 0; // 0: unused
+    int fd = -1;
+    bool nonBlocking = false;
+    bool monotonic = false;    // Event timestamps are from CLOCK_MONOTONIC
+    bool ready = false;        // Readable according to epoll
+    bool failed = false;       // Read error, waiting to be removed
+    bool errorPending = false; // Read error could not be sent to the event loop yet
+    bool overflowPending = false; // Frames were dropped, the event loop must reset the mapper
+    size_t slot = 0;           // Index in the device arrays
+    VirtualDevice* mouse = nullptr;
+    VirtualDevice* keyboard = nullptr;
+    InputThread::KeyForwarding keyForwarding;
+    std::array<input_event, InputThread::MaxFrameEvents> buffer;
+    size_t pos = 0;
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  const char* toString(InputThread::Policy policy)
+  {
+    switch (policy) {
+    case InputThread::Policy::Fifo: return "fifo";
+    case InputThread::Policy::RoundRobin: return "rr";
+    }
+    return "unknown";
+  }
+
+#if HAS_Qt_DBus
+  // -----------------------------------------------------------------------------------------------
+  /// Real-time scheduling for unprivileged users, granted by the RealtimeKit daemon.
+  bool makeThreadRealtimeWithRtkit(pid_t tid, int priority)
+  {
+    QDBusInterface rtkit(QStringLiteral("org.freedesktop.RealtimeKit1"),
+                         QStringLiteral("/org/freedesktop/RealtimeKit1"),
+                         QStringLiteral("org.freedesktop.RealtimeKit1"),
+                         QDBusConnection::systemBus());
+    if (!rtkit.isValid()) { return false; }
+
+    const int maxPriority = rtkit.property("MaxRealtimePriority").toInt();
+    if (maxPriority > 0) { priority = std::min(priority, maxPriority); }
+
+    // RealtimeKit only grants real-time scheduling to processes with limited real-time CPU time.
+    const auto maxRtTime = rtkit.property("RTTimeUSecMax").toLongLong();
+    rlimit limit{};
+    if (maxRtTime > 0 && getrlimit(RLIMIT_RTTIME, &limit) == 0
+        && (limit.rlim_max == RLIM_INFINITY || limit.rlim_max > static_cast<rlim_t>(maxRtTime)))
+    {
+      limit.rlim_cur = limit.rlim_max = static_cast<rlim_t>(maxRtTime);
+      setrlimit(RLIMIT_RTTIME, &limit);
+    }
+
+    const QDBusReply<void> reply = rtkit.call(QStringLiteral("MakeThreadRealtime"),
+                                              static_cast<quint64>(tid),
+                                              static_cast<quint32>(priority));
+    return reply.isValid();
+  }
+#endif // HAS_Qt_DBus
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+struct InputThread::Impl
+{
+  Impl(const Options& options, FrameHandler handler);
+  ~Impl();
+
+  // --- Event loop
+  bool pushCommand(const Command& command);
+  void drainFrames();
+  void lockMemory();
+  bool applyScheduling(pid_t tid);
+
+  // --- Input thread
+  void run(std::promise<pid_t> tidPromise);
+  bool processCommands();
+  void readDevice(Device& device);
+  void stage(Device& device, Frame::Type type, const input_event* events, size_t count);
+  void flush();
+  bool enqueue(const Frame& frame);
+  bool enqueueOverflow(Device& device);
+  Device* findDevice(uint32_t id);
+  VirtualDevice* directSink(const Device& device, const Frame& frame) const;
+
+  const Options m_options;
+  const FrameHandler m_handler;
+
+  SpscRing<Frame> m_frames{Defaults::frameRingSize};        // input thread -> event loop
+  SpscRing<Command> m_commands{Defaults::commandRingSize};  // event loop -> input thread
+  std::atomic<uint32_t> m_pendingFrames{0}; // frames in the ring, waiting for the input mapper
+  std::array<std::atomic<bool>, Defaults::maxDevices> m_sequencePending{}; // by device slot
+  std::array<std::atomic<uint32_t>, Defaults::maxDevices> m_forwardedMotion{}; // by device slot
+  std::atomic<int> m_stopError{0}; // errno if the input thread stopped because of an error
+  bool m_pinFailed = false; // set by the input thread before it reports its thread id
+
+  int m_epollFd = -1;
+  int m_threadWakeupFd = -1;
+  int m_eventLoopWakeupFd = -1;
+  std::unique_ptr<QSocketNotifier> m_notifier;
+  std::thread m_thread;
+  uint32_t m_nextDeviceId = 1;
+  std::array<uint32_t, Defaults::maxDevices> m_slots{}; // device id by slot, event loop only
+  bool m_realtime = false;
+  bool m_memoryLocked = false;
+
+  // Only accessed by the input thread
+  std::array<Device, Defaults::maxDevices> m_devices;
+  std::array<Frame, Defaults::maxStagedFrames> m_staged;
+  std::array<Device*, Defaults::maxStagedFrames> m_stagedDevices{};
+  std::array<int64_t, Defaults::maxStagedFrames> m_stagedTime{};
+  std::array<uint8_t, Defaults::maxStagedFrames> m_stagedOrder{}; // staged frames sorted by time
+  size_t m_stagedCount = 0;
+  bool m_enqueued = false; // frames were pushed to the ring since the last wakeup
+
+  metrics::Histogram& m_readDelay;
+  metrics::Histogram& m_queueDelay;
+  metrics::Counter& m_droppedFrames;
+  metrics::Gauge& m_realtimeGauge;
+};
+
+// -------------------------------------------------------------------------------------------------
+InputThread::Impl::Impl(const Options& options, FrameHandler handler)
+  : m_options(options)
+  , m_handler(std::move(handler))
+  , m_readDelay(metrics::histogram("projecteur_input_thread_read_delay_seconds",
+                                   "Delay from the kernel input event timestamp until the input "
+                                   "thread read the event."))
+  , m_queueDelay(metrics::histogram("projecteur_input_thread_queue_delay_seconds",
+                                    "Delay from the input thread until the event loop processed "
+                                    "the input frame."))
+  , m_droppedFrames(metrics::counter("projecteur_input_thread_dropped_frames",
+                                     "Input frames dropped because the event loop fell behind."))
+  , m_realtimeGauge(metrics::gauge("projecteur_input_thread_realtime",
+                                   "Input thread runs with real-time scheduling."))
+{}
+
+// -------------------------------------------------------------------------------------------------
+InputThread::Impl::~Impl()
+{
+  if (m_thread.joinable())
+  {
+    while (!pushCommand(Command{})) { std::this_thread::yield(); } // Command::Type::Stop
+    m_thread.join();
+  }
+
+  m_notifier.reset();
+  for (const int fd : {m_epollFd, m_threadWakeupFd, m_eventLoopWakeupFd}) {
+    if (fd >= 0) { ::close(fd); }
+  }
+
+  if (m_memoryLocked)
+  {
+    munlock(this, sizeof(*this));
+    munlock(m_frames.data(), m_frames.bytes());
+    munlock(m_commands.data(), m_commands.bytes());
+  }
+  m_realtimeGauge.set(0);
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputThread::Impl::pushCommand(const Command& command)
+{
+  const auto item = m_commands.back();
+  if (!item) { return false; }
+
+  *item = command;
+  m_commands.push();
+
+  const uint64_t one = 1;
+  return ::write(m_threadWakeupFd, &one, sizeof(one)) == sizeof(one);
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputThread::Impl::drainFrames()
+{
+  uint64_t count = 0;
+  if (::read(m_eventLoopWakeupFd, &count, sizeof(count)) < 0) {
+    // nothing to do, the ring is checked anyway
+  }
+
+  if (const int error = m_stopError.exchange(0)) {
+    logError(inputthread) << InputThread::tr("Input thread stopped, epoll_wait failed: %1")
+                             .arg(strerror(error));
+  }
+
+  while (const auto frame = m_frames.front())
+  {
+    m_queueDelay.observe(static_cast<uint64_t>(std::max<int64_t>(0, monotonicUs() - frame->enqueuedUs)));
+
+    if (frame->forwarded && isMotion(frame->events, frame->count))
+    { // Collect the motion frames merged into this one, the next one is enqueued again.
+      const auto slot = std::find(m_slots.cbegin(), m_slots.cend(), frame->device);
+      if (slot != m_slots.cend()) {
+        frame->frames = m_forwardedMotion[static_cast<size_t>(std::distance(m_slots.cbegin(), slot))]
+                        .exchange(0, std::memory_order_acq_rel);
+      }
+    }
+    if (m_handler) { m_handler(*frame); }
+
+    if (!frame->forwarded) {
+      m_pendingFrames.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    m_frames.pop();
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputThread::Impl::lockMemory()
+{
+  // Lock the memory used by the input thread, it must not page fault while reading input.
+  const std::array<std::pair<void*, size_t>, 3> regions {{
+    {this, sizeof(*this)},
+    {m_frames.data(), m_frames.bytes()},
+    {m_commands.data(), m_commands.bytes()},
+  }};
+
+  for (size_t i = 0; i < regions.size(); ++i)
+  {
+    if (mlock(regions[i].first, regions[i].second) != 0)
+    {
+      logWarn(inputthread) << InputThread::tr("Could not lock input thread memory: %1")
+                              .arg(strerror(errno));
+      for (size_t j = 0; j < i; ++j) { munlock(regions[j].first, regions[j].second); }
+      return;
+    }
+  }
+  m_memoryLocked = true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputThread::Impl::applyScheduling(pid_t tid)
+{
+  const int policy = (m_options.policy == Policy::Fifo) ? SCHED_FIFO : SCHED_RR;
+  sched_param param{};
+  param.sched_priority = std::max(sched_get_priority_min(policy),
+                                  std::min(m_options.priority, sched_get_priority_max(policy)));
+
+  // Works with CAP_SYS_NICE or a sufficient RLIMIT_RTPRIO
+  const int res = pthread_setschedparam(m_thread.native_handle(), policy, &param);
+  if (res == 0) { return true; }
+
+  logDebug(inputthread) << InputThread::tr("Real-time scheduling not permitted (%1).")
+                           .arg(strerror(res));
+#if HAS_Qt_DBus
+  if (makeThreadRealtimeWithRtkit(tid, param.sched_priority))
+  {
+    logDebug(inputthread) << InputThread::tr("Real-time scheduling granted by RealtimeKit.");
+    return true;
+  }
+#else
+  Q_UNUSED(tid);
+#endif
+  return false;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputThread::Impl::run(std::promise<pid_t> tidPromise)
+{
+  pthread_setname_np(pthread_self(), Defaults::threadName);
+
+  if (m_options.cpu >= 0)
+  {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(m_options.cpu, &cpuSet);
+    // Logged by the event loop, logging is not thread safe.
+    m_pinFailed = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0;
+  }
+
+  { // Touch the stack once, so reading input does not page fault on it later.
+    volatile char stack[Defaults::stackPrefaultSize];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) { stack[i] = 0; }
+  }
+
+  tidPromise.set_value(static_cast<pid_t>(::syscall(SYS_gettid)));
+
+  std::array<epoll_event, Defaults::maxDevices + 1> events;
+  bool stop = false;
+  while (!stop)
+  {
+    const int count = epoll_wait(m_epollFd, events.data(), static_cast<int>(events.size()), -1);
+    if (count < 0)
+    {
+      if (errno == EINTR) { continue; }
+      m_stopError.store(errno);
+      const uint64_t one = 1;
+      if (::write(m_eventLoopWakeupFd, &one, sizeof(one)) < 0) {
+        // the event loop is already signaled
+      }
+      break;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+      if (events[i].data.u64 == Defaults::wakeupToken)
+      {
+        uint64_t value = 0;
+        if (::read(m_threadWakeupFd, &value, sizeof(value)) >= 0) {
+          stop = processCommands();
+        }
+      }
+      else if (events[i].data.u64 <= m_devices.size()) {
+        m_devices[events[i].data.u64 - 1].ready = true;
+      }
+    }
+
+    // Like in the event loop, all frames from the event devices that are ready are collected and
+    // forwarded ordered by their timestamp.
+    for (auto& device : m_devices)
+    {
+      if (device.id == 0) { continue; }
+      if (device.failed)
+      {
+        if (device.errorPending) { stage(device, Frame::Type::ReadError, nullptr, 0); }
+        continue;
+      }
+      if (device.ready || device.nonBlocking) { readDevice(device); }
+      device.ready = false;
+    }
+    flush();
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputThread::Impl::processCommands()
+{
+  bool stop = false;
+  while (const auto command = m_commands.front())
+  {
+    switch (command->type)
+    {
+    case Command::Type::Add: {
+      auto& device = m_devices[command->slot];
+      device = Device();
+      device.id = command->device;
+      device.fd = command->fd;
+      device.nonBlocking = command->nonBlocking;
+      device.slot = command->slot;
+      device.mouse = command->mouse;
+      device.keyboard = command->keyboard;
+      m_forwardedMotion[command->slot].store(0, std::memory_order_relaxed);
+
+      // Event timestamps from CLOCK_MONOTONIC allow measuring the delay until they are read.
+      // Pipes are used by the input benchmark, which also uses monotonic timestamps.
+      int clockId = CLOCK_MONOTONIC;
+      struct stat st{};
+      device.monotonic = ioctl(device.fd, EVIOCSCLOCKID, &clockId) == 0
+                         || (fstat(device.fd, &st) == 0 && S_ISFIFO(st.st_mode));
+
+      epoll_event ev{};
+      ev.events = EPOLLIN;
+      ev.data.u64 = static_cast<uint64_t>(command->slot) + 1;
+      if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, device.fd, &ev) != 0)
+      {
+        device.failed = true;
+        device.errorPending = true;
+      }
+      break;
+    }
+    case Command::Type::Remove: {
+      if (const auto device = findDevice(command->device))
+      {
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, device->fd, nullptr);
+        ::close(device->fd);
+        *device = Device();
+      }
+      break;
+    }
+    case Command::Type::KeyForwarding: {
+      if (const auto device = findDevice(command->device)) {
+        device->keyForwarding = command->keyForwarding;
+      }
+      break;
+    }
+    case Command::Type::Stop:
+      stop = true;
+      break;
+    }
+    m_commands.pop();
+  }
+
+  if (stop)
+  {
+    for (auto& device : m_devices) {
+      if (device.id != 0) { ::close(device.fd); device = Device(); }
+    }
+  }
+  return stop;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputThread::Impl::readDevice(Device& device)
+{
+  while (true)
+  {
+    auto& ev = device.buffer[device.pos];
+    const auto res = ::read(device.fd, &ev, sizeof(ev));
+    if (res != sizeof(ev))
+    {
+      if (res < 0 && errno == EINTR) { continue; }
+      if (res < 0 && errno == EAGAIN) { break; }
+
+      // The event loop disconnects and removes the device.
+      epoll_ctl(m_epollFd, EPOLL_CTL_DEL, device.fd, nullptr);
+      device.failed = true;
+      stage(device, Frame::Type::ReadError, nullptr, 0);
+      break;
+    }
+    ++device.pos;
+
+    if (ev.type == EV_SYN)
+    {
+      stage(device, Frame::Type::Events, device.buffer.data(), device.pos);
+      device.pos = 0;
+    }
+    else if (device.pos >= device.buffer.size())
+    {
+      stage(device, Frame::Type::Overflow, nullptr, 0);
+      device.pos = 0;
+    }
+
+    if (!device.nonBlocking) { break; }
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputThread::Impl::stage(Device& device, Frame::Type type, const input_event* events,
+                              size_t count)
+{
+  if (m_stagedCount == m_staged.size()) { flush(); }
+
+  const auto index = m_stagedCount++;
+  auto& frame = m_staged[index];
+  frame.device = device.id;
+  frame.type = type;
+  frame.forwarded = false;
+  frame.count = static_cast<uint16_t>(count);
+  std::copy(events, events + count, frame.events);
+  m_stagedDevices[index] = &device;
+  if (type == Frame::Type::ReadError) { device.errorPending = false; }
+
+  const auto now = monotonicUs();
+  const int64_t time = (count > 0) ? timestampUs(events[count - 1]) : now;
+  if (count > 0 && device.monotonic) {
+    m_readDelay.observe(static_cast<uint64_t>(std::max<int64_t>(0, now - timestampUs(events[0]))));
+  }
+
+  // Insert sorted by time, frames with the same time keep their order.
+  size_t pos = index;
+  while (pos > 0 && m_stagedTime[m_stagedOrder[pos - 1]] > time) {
+    m_stagedOrder[pos] = m_stagedOrder[pos - 1];
+    --pos;
+  }
+  m_stagedOrder[pos] = static_cast<uint8_t>(index);
+  m_stagedTime[index] = time;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputThread::Impl::flush()
+{
+  m_enqueued = false;
+  for (size_t i = 0; i < m_stagedCount; ++i)
+  {
+    const auto index = m_stagedOrder[i];
+    auto& frame = m_staged[index];
+    auto& device = *m_stagedDevices[index];
+    const bool motion = frame.type == Frame::Type::Events && isMotion(frame.events, frame.count);
+
+    // Forward directly, unless frames for the input mapper are still waiting in the event loop -
+    // the frame would overtake them. A failed write leaves the frame to the event loop, which
+    // writes it again and logs the error.
+    if (frame.type == Frame::Type::Events && !device.overflowPending
+        && m_pendingFrames.load(std::memory_order_acquire) == 0)
+    {
+      if (const auto sink = directSink(device, frame)) {
+        frame.forwarded = sink->writeEvents(frame.events, frame.count);
+      }
+    }
+
+    if (motion)
+    {
+      if (frame.forwarded)
+      { // Only the first forwarded motion frame takes a place in the ring until it is handled.
+        auto& merged = m_forwardedMotion[device.slot];
+        if (merged.fetch_add(1, std::memory_order_acq_rel) == 0 && !enqueue(frame)) {
+          merged.store(0, std::memory_order_release);
+        }
+      }
+      else if (m_frames.available() <= Defaults::mapperReserve || !enqueue(frame)) {
+        m_droppedFrames.inc(); // motion does not change the state of the input mapper
+      }
+      continue;
+    }
+
+    // Frames of a device with dropped frames must follow its Overflow frame.
+    if ((frame.forwarded || !device.overflowPending || enqueueOverflow(device)) && enqueue(frame)) {
+      continue;
+    }
+
+    m_droppedFrames.inc();
+    if (frame.type == Frame::Type::ReadError) { device.errorPending = true; }
+    else { device.overflowPending = true; }
+  }
+  m_stagedCount = 0;
+
+  // Devices without further input get their Overflow frame as soon as there is space again.
+  for (auto& device : m_devices)
+  {
+    if (device.id != 0 && device.overflowPending) { enqueueOverflow(device); }
+  }
+
+  if (m_enqueued)
+  {
+    const uint64_t one = 1;
+    if (::write(m_eventLoopWakeupFd, &one, sizeof(one)) < 0) {
+      // the event loop is already signaled (counter overflow is not possible in practice)
+    }
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputThread::Impl::enqueue(const Frame& frame)
+{
+  const auto item = m_frames.back();
+  if (!item) { return false; }
+
+  if (!frame.forwarded) {
+    m_pendingFrames.fetch_add(1, std::memory_order_acq_rel);
+  }
+  *item = frame;
+  item->frames = 1;
+  item->enqueuedUs = monotonicUs();
+  m_frames.push();
+  m_enqueued = true;
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputThread::Impl::enqueueOverflow(Device& device)
+{
+  Frame frame;
+  frame.device = device.id;
+  frame.type = Frame::Type::Overflow;
+  if (!enqueue(frame)) { return false; }
+
+  device.overflowPending = false;
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+Device* InputThread::Impl::findDevice(uint32_t id)
+{
+  const auto it = std::find_if(m_devices.begin(), m_devices.end(),
+                               [id](const Device& d) { return d.id == id; });
+  return (it == m_devices.end()) ? nullptr : &*it;
+}
+
+// -------------------------------------------------------------------------------------------------
+VirtualDevice* InputThread::Impl::directSink(const Device& device, const Frame& frame) const
+{
+  if (isMotion(frame.events, frame.count)) { return device.mouse; }
+
+  // The pending state is read after m_pendingFrames: the event loop updates it while handling a
+  // frame, before the frame is released.
+  const auto& forwarding = device.keyForwarding;
+  if (!forwarding.enabled || !device.mouse || !device.keyboard
+      || m_sequencePending[device.slot].load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+
+  // A frame with keys that are not part of any mapped sequence is a miss of the key map.
+  bool hasKey = false;
+  for (size_t i = 0; i + 1 < frame.count; ++i) // the last event is EV_SYN
+  {
+    const auto& ev = frame.events[i];
+    if (ev.type == EV_MSC && ev.code == MSC_SCAN) { continue; }
+    if (ev.type != EV_KEY || ev.code >= KEY_CNT || forwarding.mappedKeys.test(ev.code)
+        || (ev.value == 2 && !forwarding.relayRepeats)) {
+      return nullptr;
+    }
+    hasKey = true;
+  }
+
+  if (!hasKey) { return nullptr; }
+  return isMouseButton(frame.events, frame.count) ? device.mouse : device.keyboard;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputThread::parseOptions(const QString& spec, Options& options, QString& error)
+{
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    const auto items = spec.split(QLatin1Char(','), Qt::SkipEmptyParts);
+  #else
+    const auto items = spec.split(QLatin1Char(','), QString::SkipEmptyParts);
+  #endif
+
+  for (const auto& item : items)
+  {
+    const auto keyValue = item.split('=');
+    const auto key = keyValue[0].trimmed().toLower();
+    const auto value = keyValue.size() > 1 ? keyValue[1].trimmed().toLower() : QString();
+    bool ok = true;
+
+    if (key == "on" && value.isEmpty()) {
+      // defaults
+    }
+    else if (key == "policy")
+    {
+      ok = (value == toString(Policy::Fifo) || value == toString(Policy::RoundRobin));
+      if (ok) { options.policy = (value == toString(Policy::Fifo)) ? Policy::Fifo : Policy::RoundRobin; }
+    }
+    else if (key == "priority") {
+      options.priority = value.toInt(&ok);
+      ok = ok && options.priority >= 1 && options.priority <= 99;
+    }
+    else if (key == "cpu") {
+      options.cpu = value.toInt(&ok);
+      ok = ok && options.cpu >= 0 && options.cpu < CPU_SETSIZE;
+    }
+    else {
+      ok = false;
+    }
+
+    if (!ok)
+    {
+      error = tr("Invalid input thread option: '%1'").arg(item);
+      return false;
+    }
+  }
+
+  options.enabled = true;
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+InputThread::InputThread(const Options& options, FrameHandler handler, QObject* parent)
+  : QObject(parent)
+  , impl(std::make_unique<Impl>(options, std::move(handler)))
+{}
+
+// -------------------------------------------------------------------------------------------------
+InputThread::~InputThread() = default;
+
+// -------------------------------------------------------------------------------------------------
+bool InputThread::start()
+{
+  if (impl->m_thread.joinable()) { return true; }
+
+  impl->m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+  impl->m_threadWakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  impl->m_eventLoopWakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.u64 = Defaults::wakeupToken;
+  if (impl->m_epollFd < 0 || impl->m_threadWakeupFd < 0 || impl->m_eventLoopWakeupFd < 0
+      || epoll_ctl(impl->m_epollFd, EPOLL_CTL_ADD, impl->m_threadWakeupFd, &ev) != 0)
+  {
+    logError(inputthread) << tr("Could not set up the input thread: %1").arg(strerror(errno));
+    return false;
+  }
+
+  impl->m_notifier = std::make_unique<QSocketNotifier>(impl->m_eventLoopWakeupFd,
+                                                       QSocketNotifier::Read);
+  connect(impl->m_notifier.get(), &QSocketNotifier::activated, this, [this]() {
+    impl->drainFrames();
+  });
+
+  impl->lockMemory();
+
+  std::promise<pid_t> tidPromise;
+  auto tid = tidPromise.get_future();
+  impl->m_thread = std::thread([d=impl.get(), p=std::move(tidPromise)]() mutable {
+    d->run(std::move(p));
+  });
+
+  impl->m_realtime = impl->applyScheduling(tid.get());
+  if (impl->m_pinFailed) {
+    logWarn(inputthread) << tr("Could not pin input thread to CPU %1.").arg(impl->m_options.cpu);
+  }
+  impl->m_realtimeGauge.set(impl->m_realtime ? 1 : 0);
+
+  if (impl->m_realtime) {
+    logInfo(inputthread) << tr("Input thread started with real-time scheduling (%1, priority %2).")
+                            .arg(toString(impl->m_options.policy)).arg(impl->m_options.priority);
+  }
+  else {
+    logWarn(inputthread) << tr("Input thread started without real-time scheduling, "
+                               "missing permissions (CAP_SYS_NICE, RLIMIT_RTPRIO or RealtimeKit).");
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputThread::isRunning() const {
+  return impl->m_thread.joinable();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool InputThread::isRealtime() const {
+  return impl->m_realtime;
+}
+
+// -------------------------------------------------------------------------------------------------
+uint32_t InputThread::addDevice(int fd, bool nonBlocking, VirtualDevice* mouse,
+                               VirtualDevice* keyboard)
+{
+  if (!isRunning() || fd < 0) { return 0; }
+
+  const auto slot = std::find(impl->m_slots.cbegin(), impl->m_slots.cend(), 0u);
+  if (slot == impl->m_slots.cend())
+  {
+    logError(inputthread) << tr("Too many input devices for the input thread.");
+    return 0;
+  }
+
+  const int threadFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (threadFd < 0) { return 0; }
+
+  Command command;
+  command.type = Command::Type::Add;
+  command.device = impl->m_nextDeviceId++;
+  command.slot = static_cast<size_t>(std::distance(impl->m_slots.cbegin(), slot));
+  command.fd = threadFd;
+  command.nonBlocking = nonBlocking;
+  command.mouse = mouse;
+  command.keyboard = keyboard;
+
+  impl->m_sequencePending[command.slot].store(true, std::memory_order_release);
+  if (!impl->pushCommand(command))
+  {
+    ::close(threadFd);
+    return 0;
+  }
+  impl->m_slots[command.slot] = command.device;
+  return command.device;
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputThread::removeDevice(uint32_t device)
+{
+  if (!isRunning() || device == 0) { return; }
+
+  Command command;
+  command.type = Command::Type::Remove;
+  command.device = device;
+  while (!impl->pushCommand(command)) { std::this_thread::yield(); }
+
+  std::replace(impl->m_slots.begin(), impl->m_slots.end(), device, 0u);
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputThread::setKeyForwarding(uint32_t device, const KeyForwarding& forwarding)
+{
+  if (!isRunning() || device == 0) { return; }
+  if (std::find(impl->m_slots.cbegin(), impl->m_slots.cend(), device) == impl->m_slots.cend()) {
+    return;
+  }
+
+  Command command;
+  command.type = Command::Type::KeyForwarding;
+  command.device = device;
+  command.keyForwarding = forwarding;
+  while (!impl->pushCommand(command)) { std::this_thread::yield(); }
+}
+
+// -------------------------------------------------------------------------------------------------
+void InputThread::setSequencePending(uint32_t device, bool pending)
+{
+  if (device == 0) { return; }
+
+  const auto slot = std::find(impl->m_slots.cbegin(), impl->m_slots.cend(), device);
+  if (slot == impl->m_slots.cend()) { return; }
+  impl->m_sequencePending[static_cast<size_t>(std::distance(impl->m_slots.cbegin(), slot))]
+    .store(pending, std::memory_order_release);
+}
@@ -0,0 +1,96 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QObject>
+
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include <linux/input.h>
+
+class VirtualDevice;
+
+// -------------------------------------------------------------------------------------------------
+/// Dedicated thread that reads the input event devices with real-time scheduling.
+///
+/// The thread waits on all registered event devices with epoll and reads complete input frames
+/// into preallocated, locked memory. Frames are handed over to the Qt event loop through a
+/// lock-free single producer/single consumer ring, where Spotlight feeds them into the input
+/// mapper as before. Frames that the input mapper would forward unchanged are written to the
+/// virtual devices directly from the thread: pointer motion, and key or button frames with keys
+/// that are not part of any mapped sequence while the mapper waits for no sequence continuation.
+/// Mapped keys, and with them actions and sequence timers, stay in the event loop. Frames are
+/// only written directly while no other frame waits for the event loop, so the event order at
+/// the virtual devices is always preserved. Thread and event loop share no locks. If the event
+/// loop falls behind so far that a frame for the input mapper has to be dropped, the mapper
+/// receives an Overflow frame before the next frame of the device.
+class InputThread : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum class Policy : uint8_t { Fifo, RoundRobin };
+
+  struct Options {
+    bool enabled = false;
+    Policy policy = Policy::Fifo;
+    int priority = 10; ///< Real-time priority, 1 - 99
+    int cpu = -1;      ///< CPU to pin the thread to, no pinning if negative.
+  };
+
+  /// Parse an input thread specification, e.g. 'on' or 'policy=rr,priority=20,cpu=1'
+  static bool parseOptions(const QString& spec, Options& options, QString& error);
+
+  static constexpr size_t MaxFrameEvents = 12; ///< Same as the SubEventConnection input buffer
+
+  struct Frame {
+    enum class Type : uint8_t { Events, Overflow, ReadError };
+    uint32_t device = 0;    ///< Id returned by addDevice()
+    Type type = Type::Events;
+    bool forwarded = false; ///< Already written to the virtual devices by the thread.
+    uint16_t count = 0;
+    /// Number of input frames this frame stands for. Pointer motion the thread forwarded while
+    /// the event loop was busy is merged into one frame, so it does not fill the ring.
+    uint32_t frames = 1;
+    int64_t enqueuedUs = 0;
+    struct input_event events[MaxFrameEvents];
+  };
+
+  /// Called in the event loop for every frame of the input thread.
+  using FrameHandler = std::function<void(const Frame&)>;
+
+  /// Key and button frames of a device the thread may write to the virtual devices directly.
+  struct KeyForwarding {
+    bool enabled = false;       ///< Input mapper has virtual devices and is not recording.
+    bool relayRepeats = false;  ///< Autorepeat frames of not mapped keys are relayed.
+    std::bitset<KEY_CNT> mappedKeys; ///< Keys in the mapped sequences, never written directly.
+  };
+
+  InputThread(const Options& options, FrameHandler handler, QObject* parent = nullptr);
+  ~InputThread() override;
+
+  /// Starts the thread and applies the scheduling options. If real-time scheduling is not
+  /// permitted, the thread keeps running with normal scheduling.
+  bool start();
+  bool isRunning() const;
+  bool isRealtime() const;
+
+  /// Adds an event device; the thread reads from a duplicate of fd, so the caller can close fd
+  /// at any time. Motion and mouse buttons are forwarded to mouse, keys to keyboard; both must
+  /// outlive the thread. Returns the device id used in frames, 0 on failure.
+  uint32_t addDevice(int fd, bool nonBlocking, VirtualDevice* mouse, VirtualDevice* keyboard);
+  void removeDevice(uint32_t device);
+
+  /// Key frames are written directly only after the first call, and only while the input mapper
+  /// of the device has no pending sequence. Both must be called from the event loop, the pending
+  /// state right when it changes while a frame is handled.
+  void setKeyForwarding(uint32_t device, const KeyForwarding& forwarding);
+  void setSequencePending(uint32_t device, bool pending);
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
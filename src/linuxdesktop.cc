@@ -99,12 +99,43 @@ namespace {
 #endif // HAS_Qt_DBus
 
   // -----------------------------------------------------------------------------------------------
-  QPixmap grabScreenVirtualDesktop(QScreen* screen)
+  /// Returns the part of the given screen from a capture of the area 'captureGeometry' (in logical
+  /// coordinates). The capture keeps its native device pixels, the device pixel ratio is set
+  /// according to the capture resolution.
+  QPixmap screenFromCapture(QPixmap pm, QScreen* screen, const QRect& captureGeometry)
+  {
+    if (pm.isNull() || captureGeometry.isEmpty()) {
+      return pm;
+    }
+
+    const qreal scale = static_cast<qreal>(pm.width()) / captureGeometry.width();
+    const auto g = screen->geometry();
+    if (g != captureGeometry)
+    {
+      const QRectF source((g.x() - captureGeometry.x()) * scale,
+                          (g.y() - captureGeometry.y()) * scale,
+                          g.width() * scale, g.height() * scale);
+      pm = pm.copy(source.toAlignedRect());
+    }
+
+    pm.setDevicePixelRatio(scale);
+    return pm;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  QRect virtualDesktopGeometry()
   {
     QRect g;
     for (const auto s : QGuiApplication::screens()) {
       g = g.united(s->geometry());
     }
+    return g;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  QPixmap grabScreenVirtualDesktop(QScreen* screen)
+  {
+    const auto g = virtualDesktopGeometry();
 
     #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
     QPixmap pm(QApplication::primaryScreen()->grabWindow(
@@ -113,13 +144,7 @@ namespace {
     QPixmap pm(QApplication::primaryScreen()->grabWindow(0, g.x(), g.y(), g.width(), g.height()));
     #endif
 
-    if (!pm.isNull())
-    {
-      pm.setDevicePixelRatio(screen->devicePixelRatio());
-      return pm.copy(screen->geometry());
-    }
-
-    return pm;
+    return screenFromCapture(pm, screen, g);
   }
 } // end anonymous namespace
 
@@ -169,25 +194,29 @@ QPixmap LinuxDesktop::grabScreen(QScreen* screen) const
   }
 
   // everything else.. usually X11
-  return screen->grabWindow(0);
+  return screenFromCapture(screen->grabWindow(0), screen, screen->geometry());
 }
 
 QPixmap LinuxDesktop::grabScreenWayland(QScreen* screen) const
 {
 #if HAS_Qt_DBus
   QPixmap pm;
+  QRect captureGeometry;
   switch (type())
   {
   case LinuxDesktop::Type::Gnome:
     pm = grabScreenDBusGnome();
+    captureGeometry = virtualDesktopGeometry();
     break;
   case LinuxDesktop::Type::KDE:
+    // Captures the active screen only
     pm = grabScreenDBusKde();
+    captureGeometry = screen->geometry();
     break;
   default:
     logWarning(desktop) << tr("Currently zoom on Wayland is only supported via DBus on KDE and GNOME.");
   }
-  return pm.isNull() ? pm : pm.copy(screen->geometry());
+  return screenFromCapture(pm, screen, captureGeometry);
 #else
   Q_UNUSED(screen);
   logWarning(desktop) << tr("Projecteur was compiled without Qt DBus. Currently zoom on Wayland is "
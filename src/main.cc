@@ -1,6 +1,7 @@
 // This file is part of Projecteur - https://github.com/jahnf/projecteur
 // - See LICENSE.md and README.md
 
+#include "inputhelper.h"
 #include "projecteurapp.h"
 #include "projecteur-GitVersion.h"
 
@@ -9,6 +10,7 @@
 #include "settings.h"
 
 #include <QCommandLineParser>
+#include <QTemporaryDir>
 
 #ifndef NDEBUG
 #include <QQmlDebuggingEnabler>
@@ -17,6 +19,7 @@
 #include <csignal>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 
 #define XSTRINGIFY(s) STRINGIFY(s)
 #define STRINGIFY(x) #x
@@ -28,6 +31,8 @@ namespace {
   constexpr int PROJECTEUR_ERROR_ANOTHER_INST_RUNNING = 42;
   constexpr int PROJECTEUR_ERROR_NO_INSTANCE_FOUND = 43;
   constexpr int PROJECTEUR_ERROR_EMPTY_COMMAND_PROPS = 44;
+  constexpr int PROJECTEUR_ERROR_INVALID_BENCHMARK_SPEC = 45;
+  constexpr int PROJECTEUR_ERROR_INVALID_INPUT_THREAD_SPEC = 46;
 
   // -----------------------------------------------------------------------------------------------
   class Main : public QObject {};
@@ -204,6 +209,31 @@ namespace {
     const QCommandLineOption hideSysTrayOption_ = {QStringList{ "hide-systray-icon"}, Main::tr("Hide the system tray icon.")};
     const QCommandLineOption dialogMinOnlyOption_ = {QStringList{ "m", "minimize-only" }, Main::tr("Only allow minimizing the dialog.")};
     const QCommandLineOption disableOverlayOption_ = {QStringList{ "disable-overlay" }, Main::tr("Disable spotlight overlay completely.")};
+    const QCommandLineOption disableWatchdogOption_ = {QStringList{ "disable-watchdog" }, Main::tr("Disable the event loop stall watchdog.")};
+    const QCommandLineOption inputBenchmarkOption_ = {QStringList{ "benchmark-input" },
+                               Main::tr("Run the input latency benchmark with a synthetic device and quit.\n"
+                                        "                         "
+                                        "SPEC = pattern=[motion|press|double-press|hold],rate=N,duration=S,overlay=[on|off]"),
+                               "spec"};
+    const QCommandLineOption overlayBenchmarkOption_ = {QStringList{ "benchmark-overlay" },
+                               Main::tr("Run the overlay rendering benchmark and quit.\n"
+                                        "                         "
+                                        "SPEC = config=NAME[+NAME...],frames=N; NAME = %1")
+                                 .arg(OverlayBenchmark::configurationNames().join('|')),
+                               "spec"};
+    const QCommandLineOption inputThreadOption_ = {QStringList{ "input-thread" },
+                               Main::tr("Read input devices on a real-time priority thread.\n"
+                                        "                         "
+                                        "SPEC = on | policy=[fifo|rr],priority=N,cpu=N"),
+                               "spec"};
+    const QCommandLineOption inputHelperOption_ = {QStringList{ "input-helper" },
+                               Main::tr("Run only the device input handling, without user interface.")};
+    const QCommandLineOption useInputHelperOption_ = {QStringList{ "use-input-helper" },
+                               Main::tr("Leave the device input handling to a running input helper.")};
+    const QCommandLineOption spotFeedOption_ = {QStringList{ "spot-feed" },
+                               Main::tr("Publish the spot state in shared memory for other applications.")};
+    const QCommandLineOption noDevicesOption_ = {QStringList{ "no-devices" },
+                               Main::tr("Do not connect presenter devices (implied by the benchmarks).")};
     const QCommandLineOption additionalDeviceOption_ = {QStringList{ "D", "additional-device"},
                                Main::tr("Additional accepted device; DEVICE = vendorId:productId\n"
                                         "                         "
@@ -216,7 +246,10 @@ namespace {
       parser.addOptions({versionOption_, helpOption_, fullHelpOption_, commandOption_,
                         cfgFileOption_, fullVersionOption_, deviceInfoOption_, logLvlOption_,
                         disableUInputOption_, showDlgOnStartOption_, dialogMinOnlyOption_,
-                        disableOverlayOption_, additionalDeviceOption_, hideSysTrayOption_});
+                        disableOverlayOption_, additionalDeviceOption_, hideSysTrayOption_,
+                        inputBenchmarkOption_, overlayBenchmarkOption_, inputThreadOption_,
+                        inputHelperOption_, useInputHelperOption_, spotFeedOption_,
+                        noDevicesOption_, disableWatchdogOption_});
     }
 
     // ---------------------------------------------------------------------------------------------
@@ -238,6 +271,17 @@ namespace {
     bool logLvlOptionSet() const { return parser.isSet(logLvlOption_); }
     auto logLvlOptionValue() const { return parser.value(logLvlOption_); }
     bool hideSysTrayOptionSet() const { return parser.isSet(hideSysTrayOption_); }
+    bool inputBenchmarkOptionSet() const { return parser.isSet(inputBenchmarkOption_); }
+    auto inputBenchmarkOptionValue() const { return parser.value(inputBenchmarkOption_); }
+    bool overlayBenchmarkOptionSet() const { return parser.isSet(overlayBenchmarkOption_); }
+    auto overlayBenchmarkOptionValue() const { return parser.value(overlayBenchmarkOption_); }
+    bool inputThreadOptionSet() const { return parser.isSet(inputThreadOption_); }
+    auto inputThreadOptionValue() const { return parser.value(inputThreadOption_); }
+    bool inputHelperOptionSet() const { return parser.isSet(inputHelperOption_); }
+    bool useInputHelperOptionSet() const { return parser.isSet(useInputHelperOption_); }
+    bool spotFeedOptionSet() const { return parser.isSet(spotFeedOption_); }
+    bool noDevicesOptionSet() const { return parser.isSet(noDevicesOption_); }
+    bool disableWatchdogOptionSet() const { return parser.isSet(disableWatchdogOption_); }
 
     // ---------------------------------------------------------------------------------------------
     void processArgs(int argc, char** argv)
@@ -286,6 +330,15 @@ namespace {
         print() << "  --show-dialog          " << showDlgOnStartOption_.description();
         print() << "  --hide-systray-icon    " << hideSysTrayOption_.description();
         print() << "  -m, --minimize-only    " << dialogMinOnlyOption_.description();
+        print() << "  --disable-watchdog     " << disableWatchdogOption_.description();
+        print() << "  --input-thread SPEC    " << inputThreadOption_.description();
+        print() << "  --input-helper         " << inputHelperOption_.description();
+        print() << "  --use-input-helper     " << useInputHelperOption_.description();
+        print() << "  --spot-feed            " << spotFeedOption_.description();
+        print() << "  --no-devices           " << noDevicesOption_.description();
+        print() << "  --benchmark-input SPEC " << inputBenchmarkOption_.description();
+        print() << "  --benchmark-overlay SPEC" << std::endl
+                << "                         " << overlayBenchmarkOption_.description();
       }
       print() << "  -c COMMAND|PROPERTY    " << commandOption_.description() << std::endl;
       print() << "<Commands>";
@@ -340,6 +393,8 @@ int main(int argc, char *argv[])
   QCoreApplication::setApplicationVersion(projecteur::version_string());
   ProjecteurApplication::Options options;
   QStringList ipcCommands;
+  std::unique_ptr<QTemporaryDir> benchmarkConfigDir;
+  bool runInputHelper = false;
   {
     ProjecteurCmdLineParser parser;
     parser.processArgs(argc, argv);
@@ -392,6 +447,57 @@ int main(int argc, char *argv[])
     options.dialogMinimizeOnly = parser.dialogMinOnlyOptionSet();
     options.disableOverlay = parser.disableOverlayOptionSet();
     options.hideSysTrayIcon = parser.hideSysTrayOptionSet();
+    options.useInputHelper = parser.useInputHelperOptionSet();
+    options.spotFeed = parser.spotFeedOptionSet();
+    options.scanDevices = !parser.noDevicesOptionSet();
+    options.enableWatchdog = !parser.disableWatchdogOptionSet();
+    runInputHelper = parser.inputHelperOptionSet();
+
+    if (parser.inputThreadOptionSet())
+    {
+      QString errorMessage;
+      if (!InputThread::parseOptions(parser.inputThreadOptionValue(), options.inputThread,
+                                     errorMessage))
+      {
+        error() << errorMessage;
+        return PROJECTEUR_ERROR_INVALID_INPUT_THREAD_SPEC;
+      }
+    }
+
+    if (parser.inputBenchmarkOptionSet())
+    {
+      QString errorMessage;
+      if (!InputBenchmark::parseOptions(parser.inputBenchmarkOptionValue(), options.inputBenchmark,
+                                        errorMessage))
+      {
+        error() << errorMessage;
+        return PROJECTEUR_ERROR_INVALID_BENCHMARK_SPEC;
+      }
+      // The benchmark device replaces the uinput and presenter devices, results must not depend
+      // on the devices connected to the benchmark machine.
+      options.runInputBenchmark = true;
+      options.enableUInput = false;
+      options.scanDevices = false;
+    }
+
+    if (parser.overlayBenchmarkOptionSet())
+    {
+      QString errorMessage;
+      if (!OverlayBenchmark::parseOptions(parser.overlayBenchmarkOptionValue(),
+                                          options.overlayBenchmark, errorMessage))
+      {
+        error() << errorMessage;
+        return PROJECTEUR_ERROR_INVALID_BENCHMARK_SPEC;
+      }
+      // The benchmark changes the settings for each configuration, keep the user config untouched.
+      if (!parser.cfgFileOptionSet()) {
+        benchmarkConfigDir = std::make_unique<QTemporaryDir>();
+        options.configFile = benchmarkConfigDir->path() + "/benchmark.conf";
+      }
+      options.runOverlayBenchmark = true;
+      options.disableOverlay = false;
+      options.scanDevices = false;
+    }
 
     if (parser.logLvlOptionSet()) {
       const auto lvl = logging::levelFromName(parser.logLvlOptionValue());
@@ -403,6 +509,26 @@ int main(int argc, char *argv[])
     }
   }
 
+  if (runInputHelper)
+  {
+    RunGuard helperGuard(ProjecteurInputHelperApp::controlServerName());
+    if (!helperGuard.tryToRun())
+    {
+      error() << Main::tr("Another input helper instance is already running. Exiting.");
+      return PROJECTEUR_ERROR_ANOTHER_INST_RUNNING;
+    }
+
+    // The input helper has no user interface and does not need a display.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    ProjecteurInputHelperApp helperApp(argc, argv, ProjecteurInputHelperApp::Options{
+      options.configFile, options.enableUInput, options.inputThread, options.additionalDevices});
+    signal(SIGINT, ctrl_c_signal_handler);
+    return helperApp.exec();
+  }
+
   RunGuard guard(QCoreApplication::applicationName());
   if (!guard.tryToRun())
   {
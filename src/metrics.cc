@@ -0,0 +1,172 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "metrics.h"
+
+#include <algorithm>
+
+#include <QStringList>
+
+namespace metrics {
+
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  QString escapeLabelValue(QString value)
+  {
+    return value.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  QString escapeHelp(QString help)
+  {
+    return help.replace('\\', "\\\\").replace('\n', "\\n");
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  QString labelString(const Labels& labels, const QString& extraName = QString(),
+                      const QString& extraValue = QString())
+  {
+    if (labels.empty() && extraName.isEmpty()) { return QString(); }
+
+    QStringList parts;
+    for (const auto& label : labels) {
+      parts.push_back(QString("%1=\"%2\"").arg(label.first, escapeLabelValue(label.second)));
+    }
+    if (!extraName.isEmpty()) {
+      parts.push_back(QString("%1=\"%2\"").arg(extraName, extraValue));
+    }
+    return QString("{%1}").arg(parts.join(','));
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  template<typename T>
+  T& findOrAdd(std::list<T>& entries, const Labels& labels)
+  {
+    const auto it = std::find_if(entries.begin(), entries.end(), [&labels](const T& e) {
+      return e.labels == labels;
+    });
+    if (it != entries.end()) { return *it; }
+
+    entries.emplace_back();
+    entries.back().labels = labels;
+    return entries.back();
+  }
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+constexpr std::array<uint64_t, 12> Histogram::Bounds;
+
+// -------------------------------------------------------------------------------------------------
+void Histogram::observe(uint64_t us)
+{
+  const auto it = std::lower_bound(Bounds.cbegin(), Bounds.cend(), us);
+  m_buckets[static_cast<size_t>(std::distance(Bounds.cbegin(), it))].fetch_add(1, std::memory_order_relaxed);
+}
+
+// -------------------------------------------------------------------------------------------------
+Registry& Registry::instance()
+{
+  static Registry registry;
+  return registry;
+}
+
+// -------------------------------------------------------------------------------------------------
+Registry::Family& Registry::family(const QString& name, const QString& help, Type type)
+{
+  auto it = m_families.find(name);
+  if (it == m_families.end()) {
+    it = m_families.emplace(name, Family{type, help, {}, {}, {}, {}}).first;
+  }
+  return it->second;
+}
+
+// -------------------------------------------------------------------------------------------------
+Counter& Registry::counter(const QString& name, const QString& help, const Labels& labels)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return findOrAdd(family(name, help, Type::Counter).counters, labels).metric;
+}
+
+// -------------------------------------------------------------------------------------------------
+Gauge& Registry::gauge(const QString& name, const QString& help, const Labels& labels)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return findOrAdd(family(name, help, Type::Gauge).gauges, labels).metric;
+}
+
+// -------------------------------------------------------------------------------------------------
+Histogram& Registry::histogram(const QString& name, const QString& help, const Labels& labels)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return findOrAdd(family(name, help, Type::Histogram).histograms, labels).metric;
+}
+
+// -------------------------------------------------------------------------------------------------
+void Registry::addCollector(const QString& name, const QString& help, const void* owner,
+                            Collector collector)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  family(name, help, Type::Gauge).collectors.emplace_back(owner, std::move(collector));
+}
+
+// -------------------------------------------------------------------------------------------------
+void Registry::removeCollectors(const void* owner)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& item : m_families) {
+    item.second.collectors.remove_if([owner](const std::pair<const void*, Collector>& c) {
+      return c.first == owner;
+    });
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+QByteArray Registry::toOpenMetrics() const
+{
+  QString out;
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (const auto& item : m_families)
+  {
+    const auto& name = item.first;
+    const auto& f = item.second;
+    const char* const type = (f.type == Type::Counter) ? "counter"
+                           : (f.type == Type::Gauge) ? "gauge" : "histogram";
+
+    out += QString("# TYPE %1 %2\n").arg(name, type);
+    out += QString("# HELP %1 %2\n").arg(name, escapeHelp(f.help));
+
+    for (const auto& e : f.counters) {
+      out += QString("%1_total%2 %3\n").arg(name, labelString(e.labels)).arg(e.metric.value());
+    }
+
+    for (const auto& e : f.gauges) {
+      out += QString("%1%2 %3\n").arg(name, labelString(e.labels)).arg(e.metric.value());
+    }
+
+    Samples samples;
+    for (const auto& c : f.collectors) { c.second(samples); }
+    for (const auto& sample : samples) {
+      out += QString("%1%2 %3\n").arg(name, labelString(sample.first)).arg(sample.second);
+    }
+
+    for (const auto& e : f.histograms)
+    {
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i <= Histogram::Bounds.size(); ++i)
+      {
+        cumulative += e.metric.bucketCount(i);
+        const auto le = (i < Histogram::Bounds.size())
+                        ? QString::number(static_cast<double>(Histogram::Bounds[i]) / 1e6)
+                        : QString("+Inf");
+        out += QString("%1_bucket%2 %3\n").arg(name, labelString(e.labels, "le", le)).arg(cumulative);
+      }
+      out += QString("%1_count%2 %3\n").arg(name, labelString(e.labels)).arg(cumulative);
+    }
+  }
+
+  out += "# EOF\n";
+  return out.toUtf8();
+}
+
+} // end namespace metrics
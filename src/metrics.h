@@ -0,0 +1,161 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+// -------------------------------------------------------------------------------------------------
+/// Lightweight metrics registry with counters, gauges and histograms.
+///
+/// Metric objects are created (and looked up) once through the Registry and stay valid for the
+/// lifetime of the process, so callers can keep references to them. Recording a value is a
+/// single relaxed atomic operation and never takes a lock; only registration and exporting does.
+namespace metrics {
+
+  using Labels = std::vector<std::pair<QString, QString>>;
+
+  /// Gauge samples provided by a collector at export time, see Registry::addCollector.
+  using Samples = std::vector<std::pair<Labels, int64_t>>;
+  using Collector = std::function<void(Samples& samples)>;
+
+  // -----------------------------------------------------------------------------------------------
+  class Counter
+  {
+  public:
+    void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> m_value{0};
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  class Gauge
+  {
+  public:
+    void set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+    void inc(int64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    void dec(int64_t n = 1) { m_value.fetch_sub(n, std::memory_order_relaxed); }
+    /// Raise the gauge to v if v is larger than the current value (e.g. for maximum values).
+    /// Unlike the other operations this is a compare-and-swap loop; it only retries while other
+    /// threads raise the value concurrently and returns without a write if v is not larger.
+    void setMax(int64_t v) {
+      auto current = m_value.load(std::memory_order_relaxed);
+      while (v > current && !m_value.compare_exchange_weak(current, v, std::memory_order_relaxed)) {}
+    }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int64_t> m_value{0};
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  /// Histogram for durations, recorded in microseconds and exported in seconds.
+  ///
+  /// Only the bucket counts are recorded, with a single atomic increment. No sum is kept, the
+  /// (optional) _sum sample is not exported.
+  class Histogram
+  {
+  public:
+    /// Upper bucket bounds in microseconds, the last bucket is always +Inf.
+    static constexpr std::array<uint64_t, 12> Bounds {{
+      50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000
+    }};
+
+    void observe(uint64_t us);
+    void observe(std::chrono::steady_clock::duration d) {
+      observe(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count()));
+    }
+
+    uint64_t bucketCount(size_t index) const { return m_buckets[index].load(std::memory_order_relaxed); }
+
+  private:
+    std::array<std::atomic<uint64_t>, Bounds.size() + 1> m_buckets{};
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  /// Measures the time between construction and destruction and records it in a histogram.
+  class ScopedTimer
+  {
+  public:
+    explicit ScopedTimer(Histogram& h) : m_histogram(h), m_start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { m_histogram.observe(std::chrono::steady_clock::now() - m_start); }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  private:
+    Histogram& m_histogram;
+    const std::chrono::steady_clock::time_point m_start;
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  class Registry
+  {
+  public:
+    static Registry& instance();
+
+    Counter& counter(const QString& name, const QString& help, const Labels& labels = {});
+    Gauge& gauge(const QString& name, const QString& help, const Labels& labels = {});
+    Histogram& histogram(const QString& name, const QString& help, const Labels& labels = {});
+
+    /// Adds a collector for the gauge family 'name' that provides its samples at export time, for
+    /// values that come and go at runtime (e.g. one per mapped input sequence). Collectors are
+    /// called by toOpenMetrics() with the registry locked and must not use the registry.
+    void addCollector(const QString& name, const QString& help, const void* owner,
+                      Collector collector);
+    /// Removes all collectors added for 'owner'.
+    void removeCollectors(const void* owner);
+
+    /// Returns all registered metrics in the OpenMetrics text exposition format.
+    QByteArray toOpenMetrics() const;
+
+  private:
+    Registry() = default;
+
+    enum class Type : uint8_t { Counter, Gauge, Histogram };
+
+    template<typename T> struct Entry {
+      Labels labels;
+      T metric;
+    };
+
+    struct Family {
+      Type type;
+      QString help;
+      std::list<Entry<Counter>> counters;
+      std::list<Entry<Gauge>> gauges;
+      std::list<Entry<Histogram>> histograms;
+      std::list<std::pair<const void*, Collector>> collectors;
+    };
+
+    Family& family(const QString& name, const QString& help, Type type);
+
+    mutable std::mutex m_mutex;
+    std::map<QString, Family> m_families;
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  inline Counter& counter(const QString& name, const QString& help, const Labels& labels = {}) {
+    return Registry::instance().counter(name, help, labels);
+  }
+
+  inline Gauge& gauge(const QString& name, const QString& help, const Labels& labels = {}) {
+    return Registry::instance().gauge(name, help, labels);
+  }
+
+  inline Histogram& histogram(const QString& name, const QString& help, const Labels& labels = {}) {
+    return Registry::instance().histogram(name, help, labels);
+  }
+} // end namespace metrics
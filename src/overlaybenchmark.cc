@@ -0,0 +1,565 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "overlaybenchmark.h"
+
+#include "imageitem.h"
+#include "logging.h"
+#include "overlaymemory.h"
+#include "rasterspot.h"
+#include "settings.h"
+#include "spotlight.h"
+
+#include <QLinearGradient>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <QTimer>
+#include <QtMath>
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+#include <QSGRendererInterface>
+#endif
+
+// GPU timer queries are only available with desktop OpenGL in Qt 5, Qt 6 renders via QRhi.
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0)) && !defined(QT_NO_OPENGL) && !defined(QT_OPENGL_ES_2)
+#define HAS_GPU_TIMER_QUERY 1
+#include <QOpenGLContext>
+#include <QOpenGLTimerQuery>
+#else
+#define HAS_GPU_TIMER_QUERY 0
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+LOGGING_CATEGORY(overlayBenchmark, "benchmark.overlay")
+
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  namespace Defaults {
+    constexpr int warmupFrames = 30;
+    constexpr int frameTimeoutMs = 250;
+    constexpr int settleTimeMs = 100;
+    constexpr int maxFrames = 100000;
+    constexpr double pathStep = 0.02; // radians per frame of the cursor path
+  }
+
+  using Clock = std::chrono::steady_clock;
+
+  // -----------------------------------------------------------------------------------------------
+  double msSince(Clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  struct Configuration
+  {
+    const char* name;
+    const char* shape;
+    bool border;
+    bool zoom;
+    double rotation;
+    bool centerDot;
+    bool multiScreen;
+  };
+
+  const std::array<Configuration, 8> configurations{{
+    // name,          shape,    border, zoom,  rotation, dot,   multi-screen
+    { "circle",       "Circle", false,  false,  0.0,     false, false },
+    { "border",       "Circle", true,   false,  0.0,     false, false },
+    { "square",       "Square", true,   false,  0.0,     false, false },
+    { "star",         "Star",   true,   false,  0.0,     false, false },
+    { "rotation",     "Star",   true,   false, 30.0,     false, false },
+    { "zoom",         "Circle", true,   true,   0.0,     false, false },
+    { "all",          "Star",   true,   true,  30.0,     true,  false },
+    { "multi-screen", "Circle", true,   false,  0.0,     false, true  },
+  }};
+
+  // -----------------------------------------------------------------------------------------------
+  const Configuration* findConfiguration(const QString& name)
+  {
+    const auto it = std::find_if(configurations.cbegin(), configurations.cend(),
+    [&name](const Configuration& c) {
+      return name == QLatin1String(c.name);
+    });
+    return (it != configurations.cend()) ? &*it : nullptr;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  void applyConfiguration(const Configuration& configuration, Settings& settings)
+  {
+    settings.setDefaults();
+    for (const auto& shape : Settings::spotShapes())
+    {
+      if (shape.name() == QLatin1String(configuration.shape)) {
+        settings.setSpotShape(shape.qmlComponent());
+        break;
+      }
+    }
+    settings.setShowBorder(configuration.border);
+    settings.setZoomEnabled(configuration.zoom);
+    settings.setSpotRotation(configuration.rotation);
+    settings.setShowCenterDot(configuration.centerDot);
+    settings.setMultiScreenOverlayEnabled(configuration.multiScreen);
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Deterministic replacement for the desktop screen grab, with enough detail for the zoom.
+  QPixmap desktopPattern(const QSize& size, qreal dpr)
+  {
+    QPixmap pixmap(size * dpr);
+    pixmap.setDevicePixelRatio(dpr);
+
+    QPainter p(&pixmap);
+    QLinearGradient gradient(0, 0, size.width(), size.height());
+    gradient.setColorAt(0, Qt::darkBlue);
+    gradient.setColorAt(1, Qt::darkYellow);
+    p.fillRect(QRect(QPoint(0, 0), size), gradient);
+
+    constexpr int cell = 16;
+    for (int y = 0; y < size.height(); y += cell) {
+      for (int x = (y / cell) % 2 * cell; x < size.width(); x += 2 * cell) {
+        p.fillRect(x, y, cell, cell, QColor(255, 255, 255, 48));
+      }
+    }
+    return pixmap;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  QString backendName(QQuickWindow* window)
+  {
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+    if (const auto ri = window->rendererInterface())
+    {
+      switch (ri->graphicsApi()) {
+      case QSGRendererInterface::Software: return QStringLiteral("software");
+      case QSGRendererInterface::OpenGL: return QStringLiteral("opengl");
+      default: return QStringLiteral("rhi");
+      }
+    }
+  #else
+    Q_UNUSED(window)
+  #endif
+    return QStringLiteral("opengl");
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  QString percentiles(const std::vector<double>& sorted)
+  {
+    if (sorted.empty()) { return QStringLiteral("n/a"); }
+
+    const auto percentile = [&sorted](double p) {
+      const auto index = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size())) - 1;
+      return sorted[std::min(index, sorted.size() - 1)];
+    };
+    return QString("%1/%2").arg(percentile(50), 0, 'f', 3).arg(percentile(99), 0, 'f', 3);
+  }
+
+  class i18n : public QObject {}; // for i18n and logging
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+/// Frame timings of a single overlay window. All functions except takeSamples() are called on
+/// the scene graph render thread of the window.
+struct OverlayBenchmark::FrameProbe
+{
+  std::atomic<bool> recording{false};
+
+  void beforeSynchronizing() { m_syncStart = Clock::now(); }
+  void afterSynchronizing() { m_syncMs = msSince(m_syncStart); }
+
+  void beforeRendering()
+  {
+    m_renderStart = Clock::now();
+    beginGpuTimer();
+  }
+
+  void afterRendering()
+  {
+    const double renderMs = msSince(m_renderStart);
+    const double frameMs = msSince(m_syncStart);
+    endGpuTimer();
+
+    if (!recording) { return; }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_samples.syncMs.push_back(m_syncMs);
+    m_samples.renderMs.push_back(renderMs);
+    m_samples.frameMs.push_back(frameMs);
+  }
+
+  void sceneGraphInvalidated()
+  {
+  #if HAS_GPU_TIMER_QUERY
+    m_gpuStart.reset();
+    m_gpuEnd.reset();
+    m_gpuPending = false;
+  #endif
+  }
+
+  /// Move the samples recorded so far to the result.
+  void takeSamples(Result& result)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto append = [](std::vector<double>& to, std::vector<double>& from) {
+      to.insert(to.end(), from.cbegin(), from.cend());
+      from.clear();
+    };
+    append(result.syncMs, m_samples.syncMs);
+    append(result.renderMs, m_samples.renderMs);
+    append(result.frameMs, m_samples.frameMs);
+    append(result.gpuMs, m_samples.gpuMs);
+  }
+
+private:
+  void beginGpuTimer()
+  {
+  #if HAS_GPU_TIMER_QUERY
+    if (m_gpuUnsupported || !QOpenGLContext::currentContext()) { return; }
+
+    if (!m_gpuStart)
+    {
+      m_gpuStart = std::make_unique<QOpenGLTimerQuery>();
+      m_gpuEnd = std::make_unique<QOpenGLTimerQuery>();
+      if (!m_gpuStart->create() || !m_gpuEnd->create())
+      { // e.g. no GL_ARB_timer_query support
+        m_gpuUnsupported = true;
+        m_gpuStart.reset();
+        m_gpuEnd.reset();
+        return;
+      }
+    }
+
+    // Results of the previous frame, do not stall the pipeline if they are not ready yet.
+    if (m_gpuPending && m_gpuEnd->isResultAvailable())
+    {
+      const auto ns = m_gpuEnd->waitForResult() - m_gpuStart->waitForResult();
+      if (recording) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_samples.gpuMs.push_back(ns / 1e6);
+      }
+    }
+    m_gpuStart->recordTimestamp();
+  #endif
+  }
+
+  void endGpuTimer()
+  {
+  #if HAS_GPU_TIMER_QUERY
+    if (!m_gpuEnd) { return; }
+    m_gpuEnd->recordTimestamp();
+    m_gpuPending = true;
+  #endif
+  }
+
+  Clock::time_point m_syncStart;
+  Clock::time_point m_renderStart;
+  double m_syncMs = 0.0;
+
+  std::mutex m_mutex;
+  Result m_samples;
+
+#if HAS_GPU_TIMER_QUERY
+  std::unique_ptr<QOpenGLTimerQuery> m_gpuStart;
+  std::unique_ptr<QOpenGLTimerQuery> m_gpuEnd;
+  bool m_gpuPending = false;
+  bool m_gpuUnsupported = false;
+#endif
+};
+
+// -------------------------------------------------------------------------------------------------
+bool OverlayBenchmark::parseOptions(const QString& spec, Options& options, QString& error)
+{
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    const auto items = spec.split(QLatin1Char(','), Qt::SkipEmptyParts);
+  #else
+    const auto items = spec.split(QLatin1Char(','), QString::SkipEmptyParts);
+  #endif
+
+  for (const auto& item : items)
+  {
+    const auto keyValue = item.split('=');
+    const auto key = keyValue[0].trimmed().toLower();
+    const auto value = keyValue.size() > 1 ? keyValue[1].trimmed().toLower() : QString();
+    bool ok = true;
+
+    if (key == "config")
+    {
+      options.configurations.clear();
+      for (const auto& name : value.split('+'))
+      {
+        ok = ok && findConfiguration(name);
+        if (ok) { options.configurations.push_back(name); }
+      }
+    }
+    else if (key == "frames") {
+      options.frames = value.toInt(&ok);
+      ok = ok && options.frames > 0 && options.frames <= Defaults::maxFrames;
+    }
+    else {
+      ok = false;
+    }
+
+    if (!ok)
+    {
+      error = i18n::tr("Invalid benchmark option: '%1'").arg(item);
+      return false;
+    }
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+QStringList OverlayBenchmark::configurationNames()
+{
+  QStringList names;
+  for (const auto& configuration : configurations) {
+    names.push_back(configuration.name);
+  }
+  return names;
+}
+
+// -------------------------------------------------------------------------------------------------
+OverlayBenchmark::OverlayBenchmark(const Options& options, Settings* settings, Spotlight* spotlight,
+                                   WindowsProvider overlayWindows, QObject* parent)
+  : QObject(parent)
+  , m_options(options)
+  , m_settings(settings)
+  , m_spotlight(spotlight)
+  , m_overlayWindows(std::move(overlayWindows))
+  , m_stepTimer(new QTimer(this))
+{
+  m_stepTimer->setSingleShot(true);
+  m_stepTimer->setInterval(Defaults::frameTimeoutMs);
+  connect(m_stepTimer, &QTimer::timeout, this, [this]()
+  { // No frame was rendered for the last cursor step
+    if (m_step > Defaults::warmupFrames && !m_results.empty()) { ++m_results.back().missedFrames; }
+    nextStep();
+  });
+}
+
+// -------------------------------------------------------------------------------------------------
+OverlayBenchmark::~OverlayBenchmark() = default;
+
+// -------------------------------------------------------------------------------------------------
+void OverlayBenchmark::start()
+{
+  m_configurations = m_options.configurations.isEmpty() ? configurationNames()
+                                                        : m_options.configurations;
+  QTimer::singleShot(0, this, [this](){ startConfiguration(); });
+}
+
+// -------------------------------------------------------------------------------------------------
+void OverlayBenchmark::startConfiguration()
+{
+  ++m_currentConfiguration;
+  if (!m_settings || !m_spotlight || m_currentConfiguration >= m_configurations.size())
+  {
+    emit finished();
+    return;
+  }
+
+  const auto& name = m_configurations.at(m_currentConfiguration);
+  const auto configuration = findConfiguration(name);
+  applyConfiguration(*configuration, *m_settings);
+  logInfo(overlayBenchmark) << i18n::tr("Overlay benchmark configuration '%1'").arg(name);
+
+  m_spotlight->setSpotActive(true);
+  m_windows = m_overlayWindows();
+
+  // Replace the screen grab, the zoom should not depend on the desktop content.
+  if (configuration->zoom)
+  {
+    for (const auto window : m_windows) {
+      window->setProperty("desktopPixmap", desktopPattern(window->size(), window->devicePixelRatio()));
+    }
+  }
+
+  Result result;
+  result.configuration = name;
+  result.windows = m_windows.size();
+  m_results.push_back(result);
+
+  attachProbes();
+  m_step = 0;
+  nextStep();
+}
+
+// -------------------------------------------------------------------------------------------------
+void OverlayBenchmark::attachProbes()
+{
+  for (const auto window : m_windows)
+  {
+    const auto quickWindow = qobject_cast<QQuickWindow*>(window);
+    if (!quickWindow || m_probes.count(window)) { continue; }
+
+    // The scene graph signals are emitted on the render thread.
+    const auto probe = std::make_shared<FrameProbe>();
+    connect(quickWindow, &QQuickWindow::beforeSynchronizing, this,
+            [probe](){ probe->beforeSynchronizing(); }, Qt::DirectConnection);
+    connect(quickWindow, &QQuickWindow::afterSynchronizing, this,
+            [probe](){ probe->afterSynchronizing(); }, Qt::DirectConnection);
+    connect(quickWindow, &QQuickWindow::beforeRendering, this,
+            [probe](){ probe->beforeRendering(); }, Qt::DirectConnection);
+    connect(quickWindow, &QQuickWindow::afterRendering, this,
+            [probe](){ probe->afterRendering(); }, Qt::DirectConnection);
+    connect(quickWindow, &QQuickWindow::sceneGraphInvalidated, this,
+            [probe](){ probe->sceneGraphInvalidated(); }, Qt::DirectConnection);
+    connect(quickWindow, &QQuickWindow::afterRendering, this,
+            &OverlayBenchmark::onFrameRendered, Qt::QueuedConnection);
+    connect(quickWindow, &QObject::destroyed, this, [this, window](){ m_probes.erase(window); });
+    m_probes.emplace(window, probe);
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void OverlayBenchmark::onFrameRendered()
+{
+  // Only continue with the cursor path if a step is pending.
+  if (!m_stepTimer->isActive()) { return; }
+  m_stepTimer->stop();
+  nextStep();
+}
+
+// -------------------------------------------------------------------------------------------------
+void OverlayBenchmark::nextStep()
+{
+  if (m_windows.isEmpty() || m_step >= Defaults::warmupFrames + m_options.frames)
+  {
+    finishConfiguration();
+    return;
+  }
+
+  const bool recording = (m_step >= Defaults::warmupFrames);
+  for (const auto window : m_windows)
+  {
+    const auto it = m_probes.find(window);
+    if (it != m_probes.cend()) { it->second->recording = recording; }
+  }
+
+  // Lissajous curve over the area of all overlay windows, crosses screen borders with multiple
+  // screens and changes the direction continuously.
+  QRect area;
+  for (const auto window : m_windows) { area = area.united(window->geometry()); }
+  const double t = m_step * Defaults::pathStep;
+  const QPoint globalPos(area.center().x() + qRound(area.width() * 0.4 * std::sin(3 * t)),
+                         area.center().y() + qRound(area.height() * 0.4 * std::sin(2 * t)));
+
+  const auto it = std::find_if(m_windows.cbegin(), m_windows.cend(), [&globalPos](QWindow* w) {
+    return w->geometry().contains(globalPos);
+  });
+  const auto window = (it != m_windows.cend()) ? *it : m_windows.first();
+  const QPointF localPos = globalPos - window->geometry().topLeft();
+
+  ++m_step;
+  m_stepTimer->start();
+
+  QMouseEvent event(QEvent::MouseMove, localPos, localPos, globalPos,
+                    Qt::NoButton, Qt::NoButton, Qt::NoModifier);
+  QCoreApplication::sendEvent(window, &event);
+}
+
+// -------------------------------------------------------------------------------------------------
+void OverlayBenchmark::finishConfiguration()
+{
+  m_stepTimer->stop();
+
+  auto& result = m_results.back();
+  for (const auto window : m_windows)
+  {
+    const auto it = m_probes.find(window);
+    if (it == m_probes.cend()) { continue; }
+    it->second->recording = false;
+    it->second->takeSamples(result);
+  }
+
+  for (auto samples : {&result.syncMs, &result.renderMs, &result.frameMs, &result.gpuMs}) {
+    std::sort(samples->begin(), samples->end());
+  }
+
+  if (!m_windows.isEmpty())
+  {
+    result.size = m_windows.first()->size();
+    if (const auto quickWindow = qobject_cast<QQuickWindow*>(m_windows.first())) {
+      result.backend = backendName(quickWindow);
+    }
+  }
+  collectSceneStatistics(result);
+
+  m_spotlight->setSpotActive(false);
+  QTimer::singleShot(Defaults::settleTimeMs, this, [this](){ startConfiguration(); });
+}
+
+// -------------------------------------------------------------------------------------------------
+void OverlayBenchmark::collectSceneStatistics(Result& result) const
+{
+  for (const auto window : m_windows)
+  {
+    const auto quickWindow = qobject_cast<QQuickWindow*>(window);
+    if (!quickWindow) { continue; }
+
+    // The window surface
+    result.textureBytes += overlaymemory::surfaceBytes(window);
+    result.textureBytes += overlaymemory::layerTextureBytes(quickWindow, &result.layers);
+
+    QList<QQuickItem*> items{quickWindow->contentItem()};
+    while (!items.isEmpty())
+    {
+      const auto item = items.takeLast();
+      items.append(item->childItems());
+
+      if (item->isVisible() && (item->flags() & QQuickItem::ItemHasContents)) {
+        ++result.contentItems;
+      }
+
+      if (const auto image = qobject_cast<ProjecteurImage*>(item))
+      {
+        const auto pixmap = image->pixmap();
+        if (pixmap.isNull()) { continue; }
+        // The texture and its mipmap levels (+1/3)
+        const auto pixmapBytes = static_cast<quint64>(pixmap.width()) * pixmap.height() * 4;
+        result.textureBytes += pixmapBytes * 4 / 3;
+      }
+      else if (const auto painted = qobject_cast<QQuickPaintedItem*>(item))
+      {
+        if (!painted->isVisible()) { continue; }
+        result.textureBytes += textureBytes(painted->width(), painted->height());
+        if (const auto rasterSpot = qobject_cast<RasterSpotItem*>(painted)) {
+          result.textureBytes += rasterSpot->cacheMemoryUsage();
+        }
+      }
+    }
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+QString OverlayBenchmark::report() const
+{
+  QStringList lines;
+  lines << QString("overlay benchmark: %1 frames per configuration, times in ms as p50/p99")
+           .arg(m_options.frames);
+  lines << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+           .arg("configuration", -13).arg("backend", -9).arg("windows", -10).arg("sync", -14)
+           .arg("render", -14).arg("frame", -14).arg("gpu", -14).arg("missed", -7)
+           .arg("items/layers/texture KiB");
+
+  for (const auto& result : m_results)
+  {
+    const auto windows = QString("%1x%2x%3").arg(result.windows)
+                         .arg(result.size.width()).arg(result.size.height());
+    const auto scene = QString("%1/%2/%3").arg(result.contentItems).arg(result.layers)
+                       .arg(result.textureBytes / 1024);
+    lines << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+             .arg(result.configuration, -13).arg(result.backend, -9).arg(windows, -10)
+             .arg(percentiles(result.syncMs), -14).arg(percentiles(result.renderMs), -14)
+             .arg(percentiles(result.frameMs), -14).arg(percentiles(result.gpuMs), -14)
+             .arg(result.missedFrames, -7).arg(scene);
+  }
+  return lines.join('\n');
+}
@@ -0,0 +1,96 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QSize>
+#include <QStringList>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+class QTimer;
+class QWindow;
+class Settings;
+class Spotlight;
+
+// -------------------------------------------------------------------------------------------------
+/// Benchmark of the overlay rendering for a set of spot configurations.
+///
+/// For each configuration the settings are applied, the spot is activated and a scripted cursor
+/// path is sent to the overlay windows. The render time per frame is measured with the scene
+/// graph signals of the overlay windows, together with the GPU time where timer queries are
+/// available. With the 'offscreen' Qt platform no display is required.
+class OverlayBenchmark : public QObject
+{
+  Q_OBJECT
+
+public:
+  struct Options {
+    QStringList configurations; ///< Names of the configurations to run, all if empty.
+    int frames = 300;           ///< Measured frames per configuration.
+  };
+
+  using WindowsProvider = std::function<QList<QWindow*>()>;
+
+  /// Parse a benchmark specification, e.g. 'config=circle+zoom,frames=500'
+  static bool parseOptions(const QString& spec, Options& options, QString& error);
+
+  /// Names of all available configurations.
+  static QStringList configurationNames();
+
+  OverlayBenchmark(const Options& options, Settings* settings, Spotlight* spotlight,
+                   WindowsProvider overlayWindows, QObject* parent = nullptr);
+  ~OverlayBenchmark() override;
+
+  /// Start with the first configuration; finished() is emitted after the last one.
+  void start();
+
+  /// Human readable summary with the results of all configurations, valid after finished().
+  QString report() const;
+
+signals:
+  void finished();
+
+private:
+  struct FrameProbe;
+
+  struct Result {
+    QString configuration;
+    QString backend;
+    int windows = 0;
+    QSize size;
+    std::vector<double> syncMs;   ///< Scene graph synchronization with the GUI thread
+    std::vector<double> renderMs; ///< Scene graph rendering (CPU)
+    std::vector<double> frameMs;  ///< Synchronization until the frame is rendered
+    std::vector<double> gpuMs;    ///< GPU time, if timer queries are available
+    int missedFrames = 0;         ///< Cursor steps that did not result in a new frame
+    int contentItems = 0;         ///< Visible items that create scene graph nodes
+    int layers = 0;               ///< Offscreen layers, e.g. ShaderEffectSource items
+    quint64 textureBytes = 0;     ///< Estimated texture memory
+  };
+
+  void startConfiguration();
+  void nextStep();
+  void onFrameRendered();
+  void finishConfiguration();
+  void attachProbes();
+  void collectSceneStatistics(Result& result) const;
+
+  const Options m_options;
+  QPointer<Settings> m_settings;
+  QPointer<Spotlight> m_spotlight;
+  const WindowsProvider m_overlayWindows;
+  QTimer* const m_stepTimer = nullptr;
+
+  QStringList m_configurations;
+  int m_currentConfiguration = -1;
+  int m_step = 0;
+  QList<QWindow*> m_windows;
+  std::map<QWindow*, std::shared_ptr<FrameProbe>> m_probes;
+  std::vector<Result> m_results;
+};
@@ -0,0 +1,49 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "overlaymemory.h"
+
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <QtMath>
+
+namespace overlaymemory {
+
+  // -----------------------------------------------------------------------------------------------
+  quint64 surfaceBytes(const QWindow* window)
+  {
+    const qreal dpr = window->devicePixelRatio();
+    return static_cast<quint64>(qCeil(window->width() * dpr)) * qCeil(window->height() * dpr) * 4;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  quint64 layerTextureBytes(const QQuickWindow* window, int* layers)
+  {
+    const qreal dpr = window->devicePixelRatio();
+    quint64 bytes = 0;
+
+    QList<QQuickItem*> items{window->contentItem()};
+    while (!items.isEmpty())
+    {
+      const auto item = items.takeLast();
+      items.append(item->childItems());
+      if (!item->inherits("QQuickShaderEffectSource")) { continue; }
+
+      // Invisible sources are still rendered if used by a visible effect next to them.
+      const auto parent = item->parentItem();
+      if (!item->isVisible() && !(parent && parent->isVisible())) { continue; }
+
+      if (layers) { ++(*layers); }
+      auto textureSize = item->property("textureSize").toSize();
+      if (textureSize.isEmpty())
+      { // Default texture size is the size of the source item
+        const auto source = item->property("sourceItem").value<QQuickItem*>();
+        if (!source) { continue; }
+        textureSize = QSize(qCeil(source->width() * dpr), qCeil(source->height() * dpr));
+      }
+      bytes += static_cast<quint64>(textureSize.width()) * textureSize.height() * 4;
+    }
+    return bytes;
+  }
+
+} // end namespace overlaymemory
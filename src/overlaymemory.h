@@ -0,0 +1,22 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QtGlobal>
+
+class QQuickWindow;
+class QWindow;
+
+// -------------------------------------------------------------------------------------------------
+/// Estimates of the graphics memory held by an overlay window, used for the overlay memory budget
+/// and by the overlay benchmark.
+namespace overlaymemory {
+
+  /// Estimated memory of the window surface (32 bits per pixel, device pixel ratio included).
+  quint64 surfaceBytes(const QWindow* window);
+
+  /// Estimated texture memory of the offscreen layers (ShaderEffectSource items) that are
+  /// rendered in the scene of an overlay window; the number of layers is added to 'layers'.
+  quint64 layerTextureBytes(const QQuickWindow* window, int* layers = nullptr);
+
+} // end namespace overlaymemory
@@ -0,0 +1,95 @@
+/* This file is part of Projecteur - https://github.com/jahnf/projecteur
+ * - See LICENSE.md and README.md
+ *
+ * Spot state feed, C header for external readers (e.g. OBS overlays, screen recorders).
+ *
+ * Projecteur started with '--spot-feed' publishes the live spot state in the POSIX shared memory
+ * object "/projecteur-spot-<uid>" (/dev/shm/projecteur-spot-<uid>). The state is protected by a
+ * sequence lock: readers map the object read-only and sample it at any rate without system calls
+ * and without any load on Projecteur.
+ *
+ *   char name[64];
+ *   snprintf(name, sizeof(name), PROJECTEUR_SPOT_FEED_NAME_FORMAT, (unsigned)getuid());
+ *   int fd = shm_open(name, O_RDONLY, 0);
+ *   const struct projecteur_spot_feed* feed =
+ *     mmap(NULL, sizeof(*feed), PROT_READ, MAP_SHARED, fd, 0);
+ *
+ *   struct projecteur_spot_state state;
+ *   if (projecteur_spot_feed_valid(feed) && projecteur_spot_feed_read(feed, &state, 100)) { ... }
+ *
+ * Requires GCC or Clang (__atomic builtins).
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROJECTEUR_SPOT_FEED_MAGIC 0x50524a53u /* 'PRJS' */
+#define PROJECTEUR_SPOT_FEED_VERSION 1u
+#define PROJECTEUR_SPOT_FEED_NAME_FORMAT "/projecteur-spot-%u" /* user id */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct projecteur_spot_state
+{
+  uint32_t active;        /* 1 while the spot is shown */
+  int32_t x;              /* spot center, global screen coordinates in pixels */
+  int32_t y;
+  int32_t screen_x;       /* geometry of the screen showing the spot */
+  int32_t screen_y;
+  int32_t screen_width;
+  int32_t screen_height;
+  uint32_t size;          /* spot height in pixels */
+  uint32_t size_percent;  /* spot size setting, percent of the screen height */
+  uint32_t zoom_enabled;
+  double zoom_factor;
+  double rotation;        /* degrees */
+  char shape[32];         /* shape name, e.g. "Circle", zero terminated */
+  uint64_t timestamp_ns;  /* CLOCK_MONOTONIC time of the last change */
+};
+
+struct projecteur_spot_feed
+{
+  uint32_t magic;         /* PROJECTEUR_SPOT_FEED_MAGIC, written last by Projecteur */
+  uint32_t version;       /* PROJECTEUR_SPOT_FEED_VERSION */
+  uint32_t size;          /* sizeof(struct projecteur_spot_feed) */
+  uint32_t sequence;      /* odd while the state is written, incremented by 2 with each change */
+  struct projecteur_spot_state state;
+};
+
+/* Returns 1 if feed was initialized by a compatible Projecteur version. */
+static inline int projecteur_spot_feed_valid(const struct projecteur_spot_feed* feed)
+{
+  return __atomic_load_n(&feed->magic, __ATOMIC_ACQUIRE) == PROJECTEUR_SPOT_FEED_MAGIC
+         && feed->version == PROJECTEUR_SPOT_FEED_VERSION
+         && feed->size == sizeof(struct projecteur_spot_feed);
+}
+
+/* Sequence number of the current state, readers can skip unchanged states. */
+static inline uint32_t projecteur_spot_feed_sequence(const struct projecteur_spot_feed* feed)
+{
+  return __atomic_load_n(&feed->sequence, __ATOMIC_ACQUIRE);
+}
+
+/* Copies a consistent state, returns 0 if the state changed during all max_retries attempts. */
+static inline int projecteur_spot_feed_read(const struct projecteur_spot_feed* feed,
+                                            struct projecteur_spot_state* state, int max_retries)
+{
+  int i;
+  for (i = 0; i < max_retries; ++i)
+  {
+    const uint32_t sequence = __atomic_load_n(&feed->sequence, __ATOMIC_ACQUIRE);
+    if (sequence & 1u) { continue; }
+
+    memcpy(state, &feed->state, sizeof(*state));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&feed->sequence, __ATOMIC_RELAXED) == sequence) { return 1; }
+  }
+  return 0;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
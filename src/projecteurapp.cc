@@ -6,11 +6,16 @@
 #include "aboutdlg.h"
 #include "device-command-helper.h"
 #include "imageitem.h"
+#include "inputhelper.h"
 #include "linuxdesktop.h"
 #include "logging.h"
+#include "metrics.h"
+#include "overlaymemory.h"
 #include "preferencesdlg.h"
 #include "settings.h"
 #include "spotlight.h"
+#include "spotstatefeed.h"
+#include "watchdog.h"
 
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
 #include <QDesktopWidget>
@@ -21,6 +26,7 @@
 #include <QLocalSocket>
 #include <QMenu>
 #include <QMessageBox>
+#include <QOpenGLContext>
 #include <QPointer>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
@@ -28,9 +34,12 @@
 #include <QQuickWindow>
 #include <QScreen>
 #include <QSystemTrayIcon>
+#include <QTextStream>
 #include <QTimer>
 #include <QWindow>
 
+#include <algorithm>
+
 LOGGING_CATEGORY(mainapp, "mainapp")
 LOGGING_CATEGORY(cmdclient, "cmdclient")
 LOGGING_CATEGORY(cmdserver, "cmdserver")
@@ -39,6 +48,35 @@ namespace {
   QString localServerName() {
     return QCoreApplication::applicationName() + "_local_socket";
   }
+
+  QString metricsServerName() {
+    return QCoreApplication::applicationName() + "_metrics";
+  }
+
+  // Dynamic window property, set while the overlay windows scene graph resources are in use.
+  constexpr char overlayWarmProperty[] = "_projecteur_overlay_warm";
+
+  // Returns true if the overlay windows are rendered with the Qt Quick software renderer.
+  // Selects the software renderer if no OpenGL context can be created.
+  bool useSoftwareRenderer()
+  {
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+    const auto backend = qgetenv("QT_QUICK_BACKEND");
+    if (backend == "software" || backend == "softwarecontext"
+        || QQuickWindow::sceneGraphBackend() == QLatin1String("software")) {
+      return true;
+    }
+
+    QOpenGLContext context;
+    if (!context.create())
+    {
+      logInfo(mainapp) << ProjecteurApplication::tr("OpenGL is not available, using software rendering.");
+      QQuickWindow::setSceneGraphBackend(QStringLiteral("software"));
+      return true;
+    }
+  #endif
+    return false;
+  }
 } // end anonymous namespace
 
 // -------------------------------------------------------------------------------------------------
@@ -47,6 +85,7 @@ ProjecteurApplication::ProjecteurApplication(int &argc, char **argv, const Optio
   , m_trayIcon(new QSystemTrayIcon())
   , m_trayMenu(new QMenu())
   , m_localServer(new QLocalServer(this))
+  , m_metricsServer(new QLocalServer(this))
   , m_linuxDesktop(new LinuxDesktop(this))
   , m_xcbOnWayland(QGuiApplication::platformName() == "xcb" && m_linuxDesktop->isWayland())
 {
@@ -66,12 +105,21 @@ ProjecteurApplication::ProjecteurApplication(int &argc, char **argv, const Optio
 
   m_settings = options.configFile.isEmpty() ? new Settings(this)
                                             : new Settings(options.configFile, this);
-  m_spotlight = new Spotlight(this, Spotlight::Options{options.enableUInput, options.additionalDevices},
+  m_spotlight = new Spotlight(this, Spotlight::Options{options.enableUInput && !options.useInputHelper,
+                                                       options.additionalDevices, options.inputThread,
+                                                       !options.useInputHelper, true,
+                                                       options.scanDevices},
                               m_settings);
 
   m_deviceCommandHelper = new DeviceCommandHelper(this, m_spotlight);
+  if (options.useInputHelper) {
+    m_inputHelperClient = new InputHelperClient(m_spotlight, this);
+  }
+  if (options.spotFeed) { setupSpotStateFeed(); }
+  if (options.enableWatchdog) { m_eventLoopWatchdog = new EventLoopWatchdog(this); }
 
   m_settings->setOverlayDisabled(options.disableOverlay);
+  if (options.runInputBenchmark) { startInputBenchmark(options.inputBenchmark); }
   m_dialog = std::make_unique<PreferencesDialog>(m_settings, m_spotlight,
                                                   options.dialogMinimizeOnly
                                                   ? PreferencesDialog::Mode::MinimizeOnlyDialog
@@ -106,8 +154,10 @@ ProjecteurApplication::ProjecteurApplication(int &argc, char **argv, const Optio
   m_qmlEngine->rootContext()->setContextProperty("PreferencesDialog", &*m_dialog);
   m_qmlEngine->rootContext()->setContextProperty("ProjecteurApp", this);
 
-  // Create qml overlay window component
-  m_windowQmlComponent = new QQmlComponent(m_qmlEngine, QUrl(QStringLiteral("qrc:/main.qml")), m_qmlEngine);
+  // Create qml overlay window component, software rendering uses a raster painted overlay
+  const auto overlayQml = useSoftwareRenderer() ? QStringLiteral("qrc:/main-software.qml")
+                                                : QStringLiteral("qrc:/main.qml");
+  m_windowQmlComponent = new QQmlComponent(m_qmlEngine, QUrl(overlayQml), m_qmlEngine);
   if (m_windowQmlComponent->status() != QQmlComponent::Status::Ready) {
     const auto title = tr("Overlay window error.");
     const auto text = tr("Qml component has status '%1'. Exiting.").arg(m_windowQmlComponent->status());
@@ -155,8 +205,14 @@ ProjecteurApplication::ProjecteurApplication(int &argc, char **argv, const Optio
     m_overlayWindows.clear();
   });
 
+  // Release overlay resources after a period of inactivity
+  m_overlayReleaseTimer = new QTimer(this);
+  m_overlayReleaseTimer->setSingleShot(true);
+  connect(m_overlayReleaseTimer, &QTimer::timeout, this, [this](){ releaseOverlayResources(); });
+
   // Setup the spotlight connections.
   setupSpotlight();
+  if (options.runOverlayBenchmark) { startOverlayBenchmark(options.overlayBenchmark); }
 
   // Open local server for local IPC commands, e.g. from other command line instances
   QLocalServer::removeServer(localServerName());
@@ -200,12 +256,118 @@ ProjecteurApplication::ProjecteurApplication(int &argc, char **argv, const Optio
   {
     logError(cmdserver) << tr("Error starting local socket for inter-process communication.");
   }
+
+  // Open local server that answers every connection with the current metrics in
+  // OpenMetrics text format, e.g. for a Prometheus node exporter textfile collector.
+  // Only readable by the user, the metrics include device ids and input mapping details.
+  QLocalServer::removeServer(metricsServerName());
+  m_metricsServer->setSocketOptions(QLocalServer::UserAccessOption);
+  if (m_metricsServer->listen(metricsServerName()))
+  {
+    connect(m_metricsServer, &QLocalServer::newConnection, this, [this]()
+    {
+      while (QLocalSocket *clientConnection = m_metricsServer->nextPendingConnection())
+      {
+        connect(clientConnection, &QLocalSocket::disconnected, clientConnection, &QObject::deleteLater);
+        clientConnection->write(metrics::Registry::instance().toOpenMetrics());
+        clientConnection->disconnectFromServer();
+      }
+    });
+  }
+  else
+  {
+    logError(cmdserver) << tr("Error starting local socket for metrics.");
+  }
 }
 
 // -------------------------------------------------------------------------------------------------
 ProjecteurApplication::~ProjecteurApplication()
 {
   if (m_localServer) { m_localServer->close(); }
+  if (m_metricsServer) { m_metricsServer->close(); }
+}
+
+// -------------------------------------------------------------------------------------------------
+void ProjecteurApplication::startInputBenchmark(const InputBenchmark::Options& options)
+{
+  if (!options.overlay) { m_settings->setOverlayDisabled(true); }
+
+  const auto benchmark = new InputBenchmark(options, this);
+  connect(benchmark, &InputBenchmark::finished, this, [this, benchmark]()
+  {
+    QTextStream out(stdout);
+    out << benchmark->report() << "\n";
+    out.flush();
+    quit();
+  });
+
+  if (!benchmark->start(m_spotlight)) {
+    QTimer::singleShot(0, this, [this](){ this->exit(1); });
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void ProjecteurApplication::startOverlayBenchmark(const OverlayBenchmark::Options& options)
+{
+  const auto benchmark = new OverlayBenchmark(options, m_settings, m_spotlight,
+                                              [this](){ return m_overlayWindows; }, this);
+  connect(benchmark, &OverlayBenchmark::finished, this, [this, benchmark]()
+  {
+    QTextStream out(stdout);
+    out << benchmark->report() << "\n";
+    out.flush();
+    quit();
+  });
+  benchmark->start();
+}
+
+// -------------------------------------------------------------------------------------------------
+void ProjecteurApplication::setupSpotStateFeed()
+{
+  m_spotStateFeed = new SpotStateFeed(this);
+  const auto feed = m_spotStateFeed;
+
+  const auto updateShape = [this, feed]()
+  {
+    const auto& shapes = Settings::spotShapes();
+    const auto it = std::find_if(shapes.cbegin(), shapes.cend(), [this](const Settings::SpotShape& shape) {
+      return shape.qmlComponent() == m_settings->spotShape();
+    });
+    feed->setShape(it != shapes.cend() ? it->name() : m_settings->spotShape());
+  };
+  const auto updateZoom = [this, feed]() {
+    feed->setZoom(m_settings->zoomEnabled(), m_settings->zoomFactor());
+  };
+
+  updateShape();
+  updateZoom();
+  feed->setSpotSize(m_settings->spotSize());
+  feed->setRotation(m_settings->spotRotation());
+
+  connect(m_settings, &Settings::spotSizeChanged, feed, &SpotStateFeed::setSpotSize);
+  connect(m_settings, &Settings::spotRotationChanged, feed, &SpotStateFeed::setRotation);
+  connect(m_settings, &Settings::spotShapeChanged, feed, updateShape);
+  connect(m_settings, &Settings::zoomEnabledChanged, feed, updateZoom);
+  connect(m_settings, &Settings::zoomFactorChanged, feed, updateZoom);
+
+  connect(m_spotlight, &Spotlight::spotActiveChanged, feed, [this, feed](bool active)
+  {
+    if (active) { feed->setPosition(QCursor::pos()); }
+    feed->setActive(active && !m_settings->overlayDisabled());
+  });
+
+  // The overlay windows report the cursor position with each move while the feed is enabled.
+  connect(this, &ProjecteurApplication::currentCursorPosChanged, feed, &SpotStateFeed::setPosition);
+  connect(this, &ProjecteurApplication::currentSpotScreenChanged, feed, [feed](quint64 screenId)
+  {
+    for (const auto screen : QGuiApplication::screens())
+    {
+      if (quint64(screen) == screenId) {
+        feed->setScreenGeometry(screen->geometry());
+        break;
+      }
+    }
+  });
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -218,9 +380,20 @@ void ProjecteurApplication::setupSpotlight()
     if (active && !m_settings->overlayDisabled())
     {
       if (!m_settings->multiScreenOverlayEnabled()) { setScreenForCursorPos(); }
+      m_overlayReleaseTimer->stop();
 
       for (const auto window : m_overlayWindows)
       {
+        window->setProperty(overlayWarmProperty, true);
+        if (const auto quickWindow = qobject_cast<QQuickWindow*>(window))
+        { // Keep the scene graph while the overlay is hidden, until released again.
+          quickWindow->setPersistentSceneGraph(true);
+        #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+          quickWindow->setPersistentGraphics(true);
+        #else
+          quickWindow->setPersistentOpenGLContext(true);
+        #endif
+        }
         window->setFlags(window->flags() | Qt::WindowStaysOnTopHint);
         window->setFlags(window->flags() & ~Qt::SplashScreen);
         window->setFlags(window->flags() | Qt::ToolTip);
@@ -229,6 +402,10 @@ void ProjecteurApplication::setupSpotlight()
         if (window->screen())
         {
           if (m_settings->zoomEnabled()) {
+            static auto& grabDuration = metrics::histogram("projecteur_overlay_screen_grab_seconds",
+                                                           "Duration of desktop screen grabs for zoom.");
+            const metrics::ScopedTimer t(grabDuration);
+            const watchdog::Zone zone("LinuxDesktop::grabScreen");
             window->setProperty("desktopPixmap", m_linuxDesktop->grabScreen(window->screen()));
           }
 
@@ -241,8 +418,12 @@ void ProjecteurApplication::setupSpotlight()
         window->showFullScreen();
         window->raise();
       }
+      static auto& activations = metrics::counter("projecteur_overlay_activations",
+                                                  "Spotlight overlay activations.");
+      activations.inc();
       m_overlayVisible = true;
       emit overlayVisibleChanged(true);
+      updateOverlayMemoryUsage();
     }
     else
     {
@@ -263,6 +444,7 @@ void ProjecteurApplication::setupSpotlight()
         m_dialog->showNormal();
         m_dialog->setWindowState(Qt::WindowMinimized);
       }
+      m_overlayReleaseTimer->start(m_settings->overlayReleaseDelay() * 1000);
     }
   });
 
@@ -274,6 +456,89 @@ void ProjecteurApplication::setupSpotlight()
   });
 }
 
+// -------------------------------------------------------------------------------------------------
+quint64 ProjecteurApplication::overlayMemoryUsage(QWindow* window) const
+{
+  quint64 bytes = 0;
+
+  const auto pixmap = window->property("desktopPixmap").value<QPixmap>();
+  if (!pixmap.isNull()) {
+    const auto pixmapBytes = static_cast<quint64>(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    // The pixmap and its mipmapped texture (+1/3 for the mipmap levels)
+    bytes += pixmapBytes + pixmapBytes * 4 / 3;
+  }
+
+  if (window->property(overlayWarmProperty).toBool())
+  { // Window surface and the offscreen layers that are rendered in the overlay scene
+    bytes += overlaymemory::surfaceBytes(window);
+    if (const auto quickWindow = qobject_cast<QQuickWindow*>(window)) {
+      bytes += overlaymemory::layerTextureBytes(quickWindow);
+    }
+  }
+  return bytes;
+}
+
+// -------------------------------------------------------------------------------------------------
+void ProjecteurApplication::updateOverlayMemoryUsage()
+{
+  static auto& overlayMemory = metrics::gauge("projecteur_overlay_memory_bytes",
+                                              "Estimated memory held by overlay windows.");
+  quint64 bytes = 0;
+  for (const auto window : m_overlayWindows) {
+    bytes += overlayMemoryUsage(window);
+  }
+  overlayMemory.set(static_cast<int64_t>(bytes));
+}
+
+// -------------------------------------------------------------------------------------------------
+void ProjecteurApplication::releaseOverlayResources()
+{
+  if (m_spotlight->spotActive()) { return; }
+
+  // Screen captures are taken again on every activation, they are always released.
+  for (const auto window : m_overlayWindows) {
+    window->setProperty("desktopPixmap", QPixmap());
+  }
+
+  // Keep scene resources of the overlay on the current screen first, as long as the memory
+  // budget allows it.
+  auto windows = m_overlayWindows;
+  const auto it = m_screenWindowMap.find(screenAtCursorPos());
+  if (it != m_screenWindowMap.cend() && windows.removeOne(it->second)) {
+    windows.prepend(it->second);
+  }
+
+  const auto budget = static_cast<quint64>(m_settings->overlayMemoryBudget()) * 1024 * 1024;
+  quint64 kept = 0;
+  for (const auto window : windows)
+  {
+    if (!window->property(overlayWarmProperty).toBool()) { continue; }
+
+    const auto usage = overlayMemoryUsage(window);
+    if (kept + usage <= budget) {
+      kept += usage;
+      continue;
+    }
+
+    // The scene graph and the graphics context are only released with the window hidden.
+    window->setProperty(overlayWarmProperty, false);
+    if (const auto quickWindow = qobject_cast<QQuickWindow*>(window))
+    {
+      quickWindow->setPersistentSceneGraph(false);
+    #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+      quickWindow->setPersistentGraphics(false);
+    #else
+      quickWindow->setPersistentOpenGLContext(false);
+    #endif
+      quickWindow->hide();
+      quickWindow->releaseResources();
+    }
+  }
+
+  updateOverlayMemoryUsage();
+  logDebug(mainapp) << tr("Released overlay resources, keeping %1 KiB.").arg(kept / 1024);
+}
+
 // -------------------------------------------------------------------------------------------------
 void ProjecteurApplication::setupTrayIcon(Options const& options)
 {
@@ -352,6 +617,23 @@ QWindow* ProjecteurApplication::createOverlayWindow()
   object->setParent(m_qmlEngine);
   const auto window = qobject_cast<QWindow*>(object);
   window->setFlags(window->flags() | Qt::WindowTransparentForInput | Qt::Tool);
+
+  // Render time per overlay frame; the rendering signals are emitted on the render thread.
+  if (const auto quickWindow = qobject_cast<QQuickWindow*>(window))
+  {
+    static auto& frameTime = metrics::histogram("projecteur_overlay_frame_seconds",
+                                                "Render time of overlay window frames.");
+    const auto frameStart = std::make_shared<std::atomic<int64_t>>(0);
+    connect(quickWindow, &QQuickWindow::beforeRendering, quickWindow, [frameStart]() {
+      frameStart->store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                        std::memory_order_relaxed);
+    }, Qt::DirectConnection);
+    connect(quickWindow, &QQuickWindow::afterRendering, quickWindow, [frameStart]() {
+      const auto start = std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(frameStart->load(std::memory_order_relaxed)));
+      frameTime.observe(std::chrono::steady_clock::now() - start);
+    }, Qt::DirectConnection);
+  }
   return window;
 }
 
@@ -554,6 +836,7 @@ void ProjecteurApplication::setCurrentCursorPos(const QPoint& pos)
 // -------------------------------------------------------------------------------------------------
 void ProjecteurApplication::readCommand(QLocalSocket* clientConnection)
 {
+  const watchdog::Zone zone("ProjecteurApplication::readCommand");
   auto it = m_commandConnections.find(clientConnection);
   if (it == m_commandConnections.end()) {
     return;
@@ -625,7 +908,12 @@ void ProjecteurApplication::readCommand(QLocalSocket* clientConnection)
                               .arg(intensity)
                               .arg(length);
 
-    m_deviceCommandHelper->sendVibrateCommand(intensity, length);
+    if (m_inputHelperClient) {
+      m_inputHelperClient->sendCommand(QString("vibrate=%1,%2").arg(intensity).arg(length));
+    }
+    else {
+      m_deviceCommandHelper->sendVibrateCommand(intensity, length);
+    }
   }
   else if (cmdKey == "spot.size.adjust")
   {
@@ -3,6 +3,9 @@
 #pragma once
 
 #include "devicescan.h"
+#include "inputbenchmark.h"
+#include "inputthread.h"
+#include "overlaybenchmark.h"
 
 #include <QApplication>
 #include <QPointer>
@@ -12,6 +15,8 @@
 
 class AboutDialog;
 class DeviceCommandHelper;
+class EventLoopWatchdog;
+class InputHelperClient;
 class LinuxDesktop;
 class PreferencesDialog;
 class QLocalServer;
@@ -20,8 +25,10 @@ class QMenu;
 class QQmlApplicationEngine;
 class QQmlComponent;
 class QSystemTrayIcon;
+class QTimer;
 class Settings;
 class Spotlight;
+class SpotStateFeed;
 
 class ProjecteurApplication : public QApplication
 {
@@ -29,6 +36,7 @@ class ProjecteurApplication : public QApplication
   Q_PROPERTY(bool overlayVisible READ overlayVisible NOTIFY overlayVisibleChanged)
   Q_PROPERTY(quint64 currentSpotScreen READ currentSpotScreen NOTIFY currentSpotScreenChanged)
   Q_PROPERTY(QPoint currentCursorPos READ currentCursorPos NOTIFY currentCursorPosChanged)
+  Q_PROPERTY(bool spotFeedEnabled READ spotFeedEnabled CONSTANT)
 
 public:
   struct Options {
@@ -38,6 +46,15 @@ public:
     bool dialogMinimizeOnly = false;
     bool disableOverlay = false;
     bool hideSysTrayIcon = false;
+    bool runInputBenchmark = false;
+    InputBenchmark::Options inputBenchmark;
+    bool runOverlayBenchmark = false;
+    OverlayBenchmark::Options overlayBenchmark;
+    InputThread::Options inputThread;
+    bool useInputHelper = false; // devices are handled by a separate input helper process
+    bool spotFeed = false; // publish the spot state in shared memory for external readers
+    bool scanDevices = true; // false: don't connect presenter devices (reproducible benchmarks)
+    bool enableWatchdog = true; // detect and log event loop stalls
     std::vector<SupportedDevice> additionalDevices;
   };
 
@@ -45,6 +62,7 @@ public:
   virtual ~ProjecteurApplication() override;
 
   bool overlayVisible() const { return m_overlayVisible; }
+  bool spotFeedEnabled() const { return m_spotStateFeed != nullptr; }
 
 signals:
   void overlayVisibleChanged(bool visible);
@@ -74,6 +92,12 @@ private:
 
   void setupTrayIcon(Options const& options);
   void setupSpotlight();
+  void setupSpotStateFeed();
+  void startInputBenchmark(const InputBenchmark::Options& options);
+  void startOverlayBenchmark(const OverlayBenchmark::Options& options);
+  void releaseOverlayResources();
+  quint64 overlayMemoryUsage(QWindow* window) const;
+  void updateOverlayMemoryUsage();
 
 private:
   std::unique_ptr<QSystemTrayIcon> m_trayIcon;
@@ -81,12 +105,17 @@ private:
   std::unique_ptr<PreferencesDialog> m_dialog;
   QPointer<AboutDialog> m_aboutDialog;
   QLocalServer* const m_localServer = nullptr;
+  QLocalServer* const m_metricsServer = nullptr;
   Settings* m_settings = nullptr;
   Spotlight* m_spotlight = nullptr;
   DeviceCommandHelper* m_deviceCommandHelper = nullptr;
+  InputHelperClient* m_inputHelperClient = nullptr;
+  SpotStateFeed* m_spotStateFeed = nullptr;
+  EventLoopWatchdog* m_eventLoopWatchdog = nullptr;
   LinuxDesktop* m_linuxDesktop = nullptr;
   QQmlApplicationEngine* m_qmlEngine = nullptr;
   QQmlComponent* m_windowQmlComponent = nullptr;
+  QTimer* m_overlayReleaseTimer = nullptr;
   std::map<QLocalSocket*, quint32> m_commandConnections;
   bool m_overlayVisible = false;
   const bool m_xcbOnWayland = false;
@@ -0,0 +1,354 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "rasterspot.h"
+
+#include "settings.h"
+
+#include <QPainter>
+#include <QQmlPropertyMap>
+#include <QQuickWindow>
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+  const bool registered = [](){
+    RasterSpotItem::qmlRegister();
+    return true;
+  }();
+
+  // -----------------------------------------------------------------------------------------------
+  /// Same geometry as SpotShapeStar
+  QPolygonF starPolygon(const QRectF& rect, int points, int innerRadius)
+  {
+    const auto center = rect.center();
+    const qreal rx = rect.width() / 2.0;
+    const qreal ry = rect.height() / 2.0;
+    const qreal deltaRad = qDegreesToRadians(360.0 / points);
+    const qreal startRad = qDegreesToRadians(-90.0);
+
+    // Distance from the center to the inner points, see SpotShapeStar::updatePaintNode
+    const QPointF p0(rx * std::cos(startRad), ry * std::sin(startRad));
+    const QPointF p1(rx * std::cos(startRad + deltaRad), ry * std::sin(startRad + deltaRad));
+    const qreal dist0_1 = std::hypot(p0.x(), p0.y());
+    const qreal dist1_3_2 = std::hypot(p0.x() - p1.x(), p0.y() - p1.y()) / 2.0;
+    const qreal innerDistance = std::sqrt(dist0_1 * dist0_1 - dist1_3_2 * dist1_3_2)
+                                * innerRadius / 100.0;
+
+    QPolygonF polygon;
+    polygon.reserve(points * 2);
+    for (int i = 0; i < points; ++i)
+    {
+      const qreal theta = startRad + i * deltaRad;
+      polygon << center + QPointF(rx * std::cos(theta), ry * std::sin(theta))
+              << center + QPointF(innerDistance * std::cos(theta + deltaRad / 2),
+                                  innerDistance * std::sin(theta + deltaRad / 2));
+    }
+    return polygon;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Same geometry as SpotShapeNGon
+  QPolygonF ngonPolygon(const QRectF& rect, int sides)
+  {
+    const auto center = rect.center();
+    const qreal deltaRad = qDegreesToRadians(360.0 / sides);
+    const qreal startRad = qDegreesToRadians(-90.0);
+
+    QPolygonF polygon;
+    polygon.reserve(sides);
+    for (int i = 0; i < sides; ++i)
+    {
+      const qreal theta = startRad + i * deltaRad;
+      polygon << center + QPointF(rect.width() / 2.0 * std::cos(theta),
+                                  rect.height() / 2.0 * std::sin(theta));
+    }
+    return polygon;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  QImage createImage(const QSize& size, qreal dpr)
+  {
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(dpr);
+    image.fill(Qt::transparent);
+    return image;
+  }
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+RasterSpotItem::RasterSpotItem(QQuickItem* parent)
+  : QQuickPaintedItem(parent)
+{
+  setEnabled(false);
+}
+
+// -------------------------------------------------------------------------------------------------
+int RasterSpotItem::qmlRegister()
+{
+  return qmlRegisterType<RasterSpotItem>("Projecteur.Utils", 1, 0, "RasterSpot");
+}
+
+// -------------------------------------------------------------------------------------------------
+QObject* RasterSpotItem::settings() const
+{
+  return m_settings.data();
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::setSettings(QObject* settings)
+{
+  if (m_settings.data() == settings) { return; }
+
+  if (m_settings) {
+    disconnect(m_settings, nullptr, this, nullptr);
+    for (const auto& shape : Settings::spotShapes()) {
+      if (const auto map = m_settings->shapeSettings(shape.name())) {
+        disconnect(map, nullptr, this, nullptr);
+      }
+    }
+  }
+
+  m_settings = qobject_cast<Settings*>(settings);
+
+  if (m_settings)
+  {
+    const auto invalidate = [this](){ invalidateCache(); };
+    connect(m_settings, &Settings::spotShapeChanged, this, invalidate);
+    connect(m_settings, &Settings::showSpotShadeChanged, this, invalidate);
+    connect(m_settings, &Settings::shadeColorChanged, this, invalidate);
+    connect(m_settings, &Settings::shadeOpacityChanged, this, invalidate);
+    connect(m_settings, &Settings::showBorderChanged, this, invalidate);
+    connect(m_settings, &Settings::borderColorChanged, this, invalidate);
+    connect(m_settings, &Settings::borderSizeChanged, this, invalidate);
+    connect(m_settings, &Settings::borderOpacityChanged, this, invalidate);
+    for (const auto& shape : Settings::spotShapes()) {
+      if (const auto map = m_settings->shapeSettings(shape.name())) {
+        connect(map, &QQmlPropertyMap::valueChanged, this, invalidate);
+      }
+    }
+
+    const auto repaint = [this](){ update(); };
+    connect(m_settings, &Settings::showCenterDotChanged, this, repaint);
+    connect(m_settings, &Settings::dotSizeChanged, this, repaint);
+    connect(m_settings, &Settings::dotColorChanged, this, repaint);
+    connect(m_settings, &Settings::dotOpacityChanged, this, repaint);
+
+    connect(m_settings, &Settings::zoomFactorChanged, this, [this](){ invalidateZoom(); });
+  }
+
+  invalidateCache();
+  emit settingsChanged();
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::setPixmap(QPixmap pm)
+{
+  m_pixmap = pm;
+  invalidateZoom();
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::setZoomVisible(bool visible)
+{
+  if (m_zoomVisible == visible) { return; }
+
+  m_zoomVisible = visible;
+  m_zoomDirty = true;
+  update();
+  emit zoomVisibleChanged(m_zoomVisible);
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::setZoomCenter(const QPointF& center)
+{
+  if (m_zoomCenter == center) { return; }
+
+  m_zoomCenter = center;
+  invalidateZoom();
+  emit zoomCenterChanged(m_zoomCenter);
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::setSpotRotation(qreal rotation)
+{
+  if (qFuzzyCompare(m_spotRotation, rotation)) { return; }
+
+  m_spotRotation = rotation;
+  invalidateCache();
+  emit spotRotationChanged(m_spotRotation);
+}
+
+// -------------------------------------------------------------------------------------------------
+quint64 RasterSpotItem::cacheMemoryUsage() const
+{
+  quint64 bytes = 0;
+  for (const auto image : {&m_overlayCache, &m_shapeMask, &m_zoomBuffer}) {
+    bytes += static_cast<quint64>(image->bytesPerLine()) * image->height();
+  }
+  return bytes;
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::invalidateCache()
+{
+  m_overlayCache = QImage();
+  m_shapeMask = QImage();
+  m_zoomDirty = true;
+  update();
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::invalidateZoom()
+{
+  m_zoomDirty = true;
+  if (m_zoomVisible) { update(); }
+}
+
+// -------------------------------------------------------------------------------------------------
+QPainterPath RasterSpotItem::shapePath(const QRectF& rect) const
+{
+  QPainterPath path;
+  const auto& shapes = Settings::spotShapes();
+  const auto it = std::find_if(shapes.cbegin(), shapes.cend(), [this](const Settings::SpotShape& s) {
+    return s.qmlComponent() == m_settings->spotShape();
+  });
+
+  const QString name = (it != shapes.cend()) ? it->name() : QString();
+  const auto shapeSetting = [this, &name](const QString& key, int defaultValue) {
+    const auto map = m_settings->shapeSettings(name);
+    return (map && map->contains(key)) ? map->value(key).toInt() : defaultValue;
+  };
+
+  if (name == QLatin1String("Square"))
+  {
+    const qreal radius = rect.width() * 0.5 * shapeSetting("radius", 20) / 100.0;
+    path.addRoundedRect(rect, radius, radius);
+  }
+  else if (name == QLatin1String("Star")) {
+    path.addPolygon(starPolygon(rect, qMax(3, shapeSetting("points", 5)),
+                                qMax(5, shapeSetting("innerRadius", 50))));
+  }
+  else if (name == QLatin1String("Ngon")) {
+    path.addPolygon(ngonPolygon(rect, qMax(3, shapeSetting("sides", 3))));
+  }
+  else {
+    path.addEllipse(rect);
+  }
+
+  path.closeSubpath();
+  return path;
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::updateCache(const QSize& size, qreal dpr)
+{
+  const QRectF rect(0, 0, width(), height());
+  const auto center = rect.center();
+
+  // The unrotated shape fits into the item after rotation
+  const qreal rad = qDegreesToRadians(m_spotRotation);
+  const qreal side = rect.width() / (std::abs(std::cos(rad)) + std::abs(std::sin(rad)));
+  QTransform rotation;
+  rotation.translate(center.x(), center.y());
+  rotation.rotate(m_spotRotation);
+  rotation.translate(-center.x(), -center.y());
+  const auto shape = rotation.map(shapePath(QRectF(center.x() - side / 2, center.y() - side / 2,
+                                                   side, side)));
+
+  m_shapeMask = createImage(size, dpr);
+  {
+    QPainter p(&m_shapeMask);
+    p.setRenderHint(QPainter::Antialiasing);
+    p.fillPath(shape, Qt::black);
+  }
+
+  m_overlayCache = createImage(size, dpr);
+  QPainter p(&m_overlayCache);
+  p.setRenderHint(QPainter::Antialiasing);
+
+  if (m_settings->showSpotShade())
+  {
+    QPainterPath outside;
+    outside.addRect(rect);
+    p.setOpacity(m_settings->shadeOpacity());
+    p.fillPath(outside.subtracted(shape), m_settings->shadeColor());
+  }
+
+  if (m_settings->showBorder() && m_settings->borderSize() > 0)
+  {
+    const qreal scale = (100 - m_settings->borderSize()) / 100.0;
+    QTransform transform;
+    transform.translate(center.x(), center.y());
+    transform.scale(scale, scale);
+    transform.translate(-center.x(), -center.y());
+
+    p.setOpacity(m_settings->borderOpacity());
+    p.fillPath(shape.subtracted(transform.map(shape)), m_settings->borderColor());
+  }
+
+  m_zoomDirty = true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::updateZoomBuffer()
+{
+  if (m_zoomBuffer.size() != m_shapeMask.size()) {
+    m_zoomBuffer = createImage(m_shapeMask.size(), m_shapeMask.devicePixelRatio());
+  }
+  else {
+    m_zoomBuffer.fill(Qt::transparent);
+  }
+
+  QPainter p(&m_zoomBuffer);
+
+  // Map the zoom center to the spot center; the raster engine only processes the part of the
+  // pixmap that ends up in the (spot sized) buffer.
+  const qreal zoom = m_settings->zoomFactor();
+  p.translate(width() / 2.0, height() / 2.0);
+  p.scale(zoom, zoom);
+  p.translate(-m_zoomCenter);
+
+  const auto dpr = m_pixmap.devicePixelRatio();
+  p.drawPixmap(QRectF(0, 0, m_pixmap.width() / dpr, m_pixmap.height() / dpr),
+               m_pixmap, QRectF(m_pixmap.rect()));
+
+  p.resetTransform();
+  p.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+  p.drawImage(QPointF(0, 0), m_shapeMask);
+
+  m_zoomDirty = false;
+}
+
+// -------------------------------------------------------------------------------------------------
+void RasterSpotItem::paint(QPainter* painter)
+{
+  if (!m_settings || width() <= 0 || height() <= 0) { return; }
+
+  const qreal dpr = window() ? window()->devicePixelRatio() : 1.0;
+  const QSize size(qCeil(width() * dpr), qCeil(height() * dpr));
+
+  if (m_overlayCache.size() != size) {
+    updateCache(size, dpr);
+  }
+
+  if (m_zoomVisible && !m_pixmap.isNull())
+  {
+    if (m_zoomDirty) { updateZoomBuffer(); }
+    painter->drawImage(QPointF(0, 0), m_zoomBuffer);
+  }
+
+  painter->drawImage(QPointF(0, 0), m_overlayCache);
+
+  if (m_settings->showCenterDot())
+  {
+    const qreal radius = m_settings->dotSize() / 2.0;
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setOpacity(m_settings->dotOpacity());
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(m_settings->dotColor());
+    painter->drawEllipse(QPointF(width() / 2.0, height() / 2.0), radius, radius);
+  }
+}
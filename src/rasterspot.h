@@ -0,0 +1,76 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QImage>
+#include <QPainterPath>
+#include <QPixmap>
+#include <QPointer>
+#include <QQuickPaintedItem>
+
+class Settings;
+
+/// Spot for the Qt Quick software renderer: paints the spot shade, border, center dot and zoom
+/// with the raster paint engine, without any graphical effects. The item only covers the spot
+/// rectangle, the shade around it is done by the ShadeItem.
+class RasterSpotItem : public QQuickPaintedItem
+{
+  Q_OBJECT
+  Q_PROPERTY(QObject* settings READ settings WRITE setSettings NOTIFY settingsChanged)
+  Q_PROPERTY(QPixmap pixmap READ pixmap WRITE setPixmap)
+  Q_PROPERTY(bool zoomVisible READ zoomVisible WRITE setZoomVisible NOTIFY zoomVisibleChanged)
+  Q_PROPERTY(QPointF zoomCenter READ zoomCenter WRITE setZoomCenter NOTIFY zoomCenterChanged)
+  Q_PROPERTY(qreal spotRotation READ spotRotation WRITE setSpotRotation NOTIFY spotRotationChanged)
+
+public:
+  static int qmlRegister();
+
+  explicit RasterSpotItem(QQuickItem* parent = nullptr);
+  virtual ~RasterSpotItem() override = default;
+
+  void paint(QPainter* painter) override;
+
+  QObject* settings() const;
+  void setSettings(QObject* settings);
+
+  QPixmap pixmap() const { return m_pixmap; }
+  void setPixmap(QPixmap pm);
+
+  bool zoomVisible() const { return m_zoomVisible; }
+  void setZoomVisible(bool visible);
+
+  /// Center of the zoomed area in logical pixmap coordinates
+  QPointF zoomCenter() const { return m_zoomCenter; }
+  void setZoomCenter(const QPointF& center);
+
+  /// Rotation of the spot shape in degrees. The item size is the bounding box of the rotated shape.
+  qreal spotRotation() const { return m_spotRotation; }
+  void setSpotRotation(qreal rotation);
+
+  /// Memory held by the cached shade, mask and zoom images in bytes.
+  quint64 cacheMemoryUsage() const;
+
+signals:
+  void settingsChanged();
+  void zoomVisibleChanged(bool visible);
+  void zoomCenterChanged(const QPointF& center);
+  void spotRotationChanged(qreal rotation);
+
+private:
+  void invalidateCache();
+  void invalidateZoom();
+  QPainterPath shapePath(const QRectF& rect) const;
+  void updateCache(const QSize& size, qreal dpr);
+  void updateZoomBuffer();
+
+  QPointer<Settings> m_settings;
+  QPixmap m_pixmap;
+  bool m_zoomVisible = false;
+  QPointF m_zoomCenter;
+  qreal m_spotRotation = 0.0;
+
+  QImage m_overlayCache; // shade around the spot shape and the border
+  QImage m_shapeMask;    // opaque spot shape, used to mask the zoom
+  QImage m_zoomBuffer;   // scaled and masked sub-image of the desktop pixmap
+  bool m_zoomDirty = true;
+};
@@ -6,6 +6,7 @@
 #include "device.h"
 #include "deviceinput.h"
 #include "logging.h"
+#include "watchdog.h"
 
 #include <algorithm>
 #include <utility>
@@ -40,9 +41,15 @@ namespace {
     constexpr char zoomEnabled[] = "enableZoom";
     constexpr char zoomFactor[] = "zoomFactor";
     constexpr char multiScreenOverlay[] = "multiScreenOverlay";
+    constexpr char overlayReleaseDelay[] = "overlayReleaseDelay";
+    constexpr char overlayMemoryBudget[] = "overlayMemoryBudget";
 
     // -- device specific
     constexpr char inputSequenceInterval[] = "inputSequenceInterval";
+    constexpr char adaptiveInputSequence[] = "adaptiveInputSequence";
+    constexpr char firmwareRemapping[] = "firmwareRemapping";
+    constexpr char repeatMappedActions[] = "repeatMappedActions";
+    constexpr char regenerateAutorepeat[] = "regenerateAutorepeat";
     constexpr char inputMapConfig[] = "inputMapConfig";
     constexpr char timerEnabled[] = "timer%1enabled";
     constexpr char timerSeconds[] = "timer%1seconds";
@@ -68,9 +75,15 @@ namespace {
       constexpr bool zoomEnabled = false;
       constexpr double zoomFactor = 2.0;
       constexpr bool multiScreenOverlay = false;
+      constexpr int overlayReleaseDelay = 30;
+      constexpr int overlayMemoryBudget = 64;
 
       // -- device specific defaults
       constexpr int inputSequenceInterval = 250;
+      constexpr bool adaptiveInputSequence = false;
+      constexpr bool firmwareRemapping = false;
+      constexpr bool repeatMappedActions = false;
+      constexpr bool regenerateAutorepeat = false;
       constexpr uint8_t vibrationLength = 0;
       constexpr uint8_t vibrationIntensity = 128;
     } // end namespace defaultValue
@@ -84,6 +97,8 @@ namespace {
       constexpr Settings::SettingRange<int> borderSize{ 0, 100 };
       constexpr Settings::SettingRange<double> borderOpacity{ 0.0, 1.0 };
       constexpr Settings::SettingRange<double> zoomFactor{ 1.5, 20.0 };
+      constexpr Settings::SettingRange<int> overlayReleaseDelay{ 0, 3600 };
+      constexpr Settings::SettingRange<int> overlayMemoryBudget{ 0, 4096 };
 
       constexpr Settings::SettingRange<int> inputSequenceInterval{ 100, 950 };
     } // end namespace ranges
@@ -100,6 +115,30 @@ namespace {
      return QString(SETTINGS_PRESET_PREFIX "%1%2").arg(preset).arg(withSeparator ? "/" : "");
   }
 
+  // -----------------------------------------------------------------------------------------------
+  quint32 deviceKey(uint16_t vendorId, uint16_t productId) {
+    return (static_cast<quint32>(vendorId) << 16) | productId;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  Settings::DeviceInput defaultDeviceInput() {
+    Settings::DeviceInput di;
+    di.inputSeqInterval = settings::defaultValue::inputSequenceInterval;
+    di.adaptiveInputSeq = settings::defaultValue::adaptiveInputSequence;
+    di.firmwareRemapping = settings::defaultValue::firmwareRemapping;
+    di.repeatMappedActions = settings::defaultValue::repeatMappedActions;
+    di.regenerateAutorepeat = settings::defaultValue::regenerateAutorepeat;
+    return di;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  Settings::DeviceInput findDeviceInput(const std::map<quint32, Settings::DeviceInput>& inputs,
+                                        const DeviceId& dId)
+  {
+    const auto it = inputs.find(deviceKey(dId.vendorId, dId.productId));
+    return (it != inputs.cend()) ? it->second : defaultDeviceInput();
+  }
+
   // -----------------------------------------------------------------------------------------------
   QString settingsKey(const DeviceId& dId, const QString& key) {
     return QString("Device_%1_%2/%3")
@@ -121,6 +160,26 @@ namespace {
 } // end anonymous namespace
 
 
+// -------------------------------------------------------------------------------------------------
+/// Defers the snapshotPublished() notification to the end of the scope; all changes within the
+/// scope are announced once.
+class Settings::SnapshotBatch
+{
+public:
+  explicit SnapshotBatch(Settings* settings) : m_settings(settings) {
+    ++m_settings->m_snapshotBatchDepth;
+  }
+
+  ~SnapshotBatch() {
+    if (--m_settings->m_snapshotBatchDepth == 0 && m_settings->m_snapshotPending) {
+      m_settings->invalidateSnapshot();
+    }
+  }
+
+private:
+  Settings* const m_settings;
+};
+
 // -------------------------------------------------------------------------------------------------
 Settings::Settings(QObject* parent)
   : QObject(parent)
@@ -161,6 +220,7 @@ void Settings::init()
   shapeSettingsInitialize();
   load();
   initializeStringProperties();
+  invalidateSnapshot();
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -172,6 +232,12 @@ void Settings::initializeStringProperties()
                     [this](const QString& value){ setOverlayDisabled(!toBool(value)); } } );
   map.emplace_back( "spot.multi-screen", StringProperty{ StringProperty::Bool, {false, true},
                     [this](const QString& value){ setMultiScreenOverlayEnabled(toBool(value)); } } );
+  map.emplace_back( "overlay.release-delay", StringProperty{ StringProperty::Integer,
+                    {::settings::ranges::overlayReleaseDelay.min, ::settings::ranges::overlayReleaseDelay.max},
+                    [this](const QString& value){ setOverlayReleaseDelay(value.toInt()); } } );
+  map.emplace_back( "overlay.memory-budget", StringProperty{ StringProperty::Integer,
+                    {::settings::ranges::overlayMemoryBudget.min, ::settings::ranges::overlayMemoryBudget.max},
+                    [this](const QString& value){ setOverlayMemoryBudget(value.toInt()); } } );
   map.emplace_back( "spot.size", StringProperty{ StringProperty::Integer,
                     {::settings::ranges::spotSize.min, ::settings::ranges::spotSize.max},
                     [this](const QString& value){ setSpotSize(value.toInt()); } } );
@@ -270,6 +336,8 @@ const Settings::SettingRange<int>& Settings::borderSizeRange() { return settings
 const Settings::SettingRange<double>& Settings::borderOpacityRange() { return settings::ranges::borderOpacity; }
 const Settings::SettingRange<double>& Settings::zoomFactorRange() { return settings::ranges::zoomFactor; }
 const Settings::SettingRange<int>& Settings::inputSequenceIntervalRange() { return settings::ranges::inputSequenceInterval; }
+const Settings::SettingRange<int>& Settings::overlayReleaseDelayRange() { return settings::ranges::overlayReleaseDelay; }
+const Settings::SettingRange<int>& Settings::overlayMemoryBudgetRange() { return settings::ranges::overlayMemoryBudget; }
 
 // -------------------------------------------------------------------------------------------------
 const QList<Settings::SpotShape>& Settings::spotShapes()
@@ -289,6 +357,7 @@ const QList<Settings::SpotShape>& Settings::spotShapes()
 // -------------------------------------------------------------------------------------------------
 void Settings::setDefaults()
 {
+  const SnapshotBatch batch(this);
   setShowSpotShade(settings::defaultValue::showSpotShade);
   setSpotSize(settings::defaultValue::spotSize);
   setShowCenterDot(settings::defaultValue::showCenterDot);
@@ -307,6 +376,8 @@ void Settings::setDefaults()
   setZoomEnabled(settings::defaultValue::zoomEnabled);
   setZoomFactor(settings::defaultValue::zoomFactor);
   setMultiScreenOverlayEnabled(settings::defaultValue::multiScreenOverlay);
+  setOverlayReleaseDelay(settings::defaultValue::overlayReleaseDelay);
+  setOverlayMemoryBudget(settings::defaultValue::overlayMemoryBudget);
   shapeSettingsSetDefaults();
 }
 
@@ -329,6 +400,7 @@ void Settings::shapeSettingsSetDefaults()
     }
   }
   shapeSettingsPopulateRoot();
+  invalidateSnapshot();
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -367,6 +439,7 @@ void Settings::shapeSettingsLoad(const QString& preset)
     }
   }
   shapeSettingsPopulateRoot();
+  invalidateSnapshot();
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -422,6 +495,7 @@ void Settings::shapeSettingsInitialize()
             logDebug(lcSettings) << QString("spot.shape.%1.%2 = ").arg(shape.name().toLower(), it->settingsKey())
                                  << setValue;
             m_settings->setValue(QString("Shape.%1/%2").arg(shape.name()).arg(key), newValue);
+            invalidateSnapshot();
           }
         }
       });
@@ -446,6 +520,7 @@ void Settings::removePreset(const QString& preset)
 {
   m_presetModel->removePreset(preset);
   m_settings->remove(presetSection(preset, false));
+  invalidateSnapshot();
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -463,6 +538,8 @@ PresetModel* Settings::presetModel()
 // -------------------------------------------------------------------------------------------------
 void Settings::load(const QString& preset)
 {
+  const watchdog::Zone zone("Settings::load");
+  const SnapshotBatch batch(this);
   logDebug(lcSettings) << tr("Loading values from config:") << m_settings->fileName()
                        << (preset.size() ? QString("(%1)").arg(preset) : "");
 
@@ -485,12 +562,18 @@ void Settings::load(const QString& preset)
   setZoomEnabled(m_settings->value(s+::settings::zoomEnabled, settings::defaultValue::zoomEnabled).toBool());
   setZoomFactor(m_settings->value(s+::settings::zoomFactor, settings::defaultValue::zoomFactor).toDouble());
   setMultiScreenOverlayEnabled(m_settings->value(s+::settings::multiScreenOverlay, settings::defaultValue::multiScreenOverlay).toBool());
+  if (preset.isEmpty()) { // not part of presets
+    setOverlayReleaseDelay(m_settings->value(::settings::overlayReleaseDelay, settings::defaultValue::overlayReleaseDelay).toInt());
+    setOverlayMemoryBudget(m_settings->value(::settings::overlayMemoryBudget, settings::defaultValue::overlayMemoryBudget).toInt());
+    loadDeviceInputs();
+  }
   shapeSettingsLoad(preset);
 }
 
 // -------------------------------------------------------------------------------------------------
 void Settings::savePreset(const QString& preset)
 {
+  const watchdog::Zone zone("Settings::savePreset");
   const auto section = presetSection(preset);
 
   m_settings->setValue(section+::settings::showSpotShade, m_showSpotShade);
@@ -514,6 +597,7 @@ void Settings::savePreset(const QString& preset)
   shapeSettingsSavePreset(preset);
 
   m_presetModel->addPreset(preset);
+  invalidateSnapshot();
   emit presetLoaded(preset);
 }
 
@@ -525,6 +609,7 @@ void Settings::setShowSpotShade(bool show)
   m_showSpotShade = show;
   m_settings->setValue(::settings::showSpotShade, m_showSpotShade);
   logDebug(lcSettings) << "shade =" << m_showSpotShade;
+  invalidateSnapshot();
   emit showSpotShadeChanged(m_showSpotShade);
 }
 
@@ -536,6 +621,7 @@ void Settings::setSpotSize(int size)
   m_spotSize = qMin(qMax(::settings::ranges::spotSize.min, size), ::settings::ranges::spotSize.max);
   m_settings->setValue(::settings::spotSize, m_spotSize);
   logDebug(lcSettings) << "spot.size =" << m_spotSize;
+  invalidateSnapshot();
   emit spotSizeChanged(m_spotSize);
 }
 
@@ -547,6 +633,7 @@ void Settings::setShowCenterDot(bool show)
   m_showCenterDot = show;
   m_settings->setValue(::settings::showCenterDot, m_showCenterDot);
   logDebug(lcSettings) << "dot =" << m_showCenterDot;
+  invalidateSnapshot();
   emit showCenterDotChanged(m_showCenterDot);
 }
 
@@ -558,6 +645,7 @@ void Settings::setDotSize(int size)
   m_dotSize = qMin(qMax(::settings::ranges::dotSize.min, size), ::settings::ranges::dotSize.max);
   m_settings->setValue(::settings::dotSize, m_dotSize);
   logDebug(lcSettings) << "dot.size =" << m_dotSize;
+  invalidateSnapshot();
   emit dotSizeChanged(m_dotSize);
 }
 
@@ -569,6 +657,7 @@ void Settings::setDotColor(const QColor& color)
   m_dotColor = color;
   m_settings->setValue(::settings::dotColor, m_dotColor);
   logDebug(lcSettings) << "dot.color =" << m_dotColor.name();
+  invalidateSnapshot();
   emit dotColorChanged(m_dotColor);
 }
 
@@ -580,6 +669,7 @@ void Settings::setDotOpacity(double opacity)
     m_dotOpacity = qMin(qMax(::settings::ranges::dotOpacity.min, opacity), ::settings::ranges::dotOpacity.max);
     m_settings->setValue(::settings::dotOpacity, m_dotOpacity);
     logDebug(lcSettings) << "dot.opacity = " << m_dotOpacity;
+    invalidateSnapshot();
     emit dotOpacityChanged(m_dotOpacity);
   }
 }
@@ -592,6 +682,7 @@ void Settings::setShadeColor(const QColor& color)
   m_shadeColor = color;
   m_settings->setValue(::settings::shadeColor, m_shadeColor);
   logDebug(lcSettings) << "shade.color =" << m_shadeColor.name();
+  invalidateSnapshot();
   emit shadeColorChanged(m_shadeColor);
 }
 
@@ -603,6 +694,7 @@ void Settings::setShadeOpacity(double opacity)
     m_shadeOpacity = qMin(qMax(::settings::ranges::shadeOpacity.min, opacity), ::settings::ranges::shadeOpacity.max);
     m_settings->setValue(::settings::shadeOpacity, m_shadeOpacity);
     logDebug(lcSettings) << "shade.opacity = " << m_shadeOpacity;
+    invalidateSnapshot();
     emit shadeOpacityChanged(m_shadeOpacity);
   }
 }
@@ -615,6 +707,7 @@ void Settings::setCursor(Qt::CursorShape cursor)
   m_cursor = qMin(qMax(static_cast<Qt::CursorShape>(0), cursor), Qt::LastCursor);
   m_settings->setValue(::settings::cursor, static_cast<int>(m_cursor));
   logDebug(lcSettings) << "cursor = " << m_cursor;
+  invalidateSnapshot();
   emit cursorChanged(m_cursor);
 }
 
@@ -622,6 +715,7 @@ void Settings::setCursor(Qt::CursorShape cursor)
 void Settings::setSpotShape(const QString& spotShapeQmlComponent)
 {
   if (m_spotShape == spotShapeQmlComponent) { return; }
+  const SnapshotBatch batch(this);
 
   const auto it = std::find_if(spotShapes().cbegin(), spotShapes().cend(),
   [&spotShapeQmlComponent](const SpotShape& s) {
@@ -632,6 +726,7 @@ void Settings::setSpotShape(const QString& spotShapeQmlComponent)
     m_spotShape = it->qmlComponent();
     m_settings->setValue(::settings::spotShape, m_spotShape);
     logDebug(lcSettings) << "spot.shape = " << m_spotShape;
+    invalidateSnapshot();
     emit spotShapeChanged(m_spotShape);
     setSpotRotationAllowed(it->allowRotation());
   }
@@ -645,6 +740,7 @@ void Settings::setSpotRotation(double rotation)
     m_spotRotation = qMin(qMax(::settings::ranges::spotRotation.min, rotation), ::settings::ranges::spotRotation.max);
     m_settings->setValue(::settings::spotRotation, m_spotRotation);
     logDebug(lcSettings) << "spot.rotation = " << m_spotRotation;
+    invalidateSnapshot();
     emit spotRotationChanged(m_spotRotation);
   }
 }
@@ -690,6 +786,7 @@ void Settings::setSpotRotationAllowed(bool allowed)
   if (allowed == m_spotRotationAllowed) { return; }
 
   m_spotRotationAllowed = allowed;
+  invalidateSnapshot();
   emit spotRotationAllowedChanged(allowed);
 }
 
@@ -701,6 +798,7 @@ void Settings::setShowBorder(bool show)
   m_showBorder = show;
   m_settings->setValue(::settings::showBorder, m_showBorder);
   logDebug(lcSettings) << "border = " << m_showBorder;
+  invalidateSnapshot();
   emit showBorderChanged(m_showBorder);
 }
 
@@ -712,6 +810,7 @@ void Settings::setBorderColor(const QColor& color)
   m_borderColor = color;
   m_settings->setValue(::settings::borderColor, m_borderColor);
   logDebug(lcSettings) << "border.color = " << m_borderColor.name();
+  invalidateSnapshot();
   emit borderColorChanged(m_borderColor);
 }
 
@@ -723,6 +822,7 @@ void Settings::setBorderSize(int size)
   m_borderSize = qMin(qMax(::settings::ranges::borderSize.min, size), ::settings::ranges::borderSize.max);
   m_settings->setValue(::settings::borderSize, m_borderSize);
   logDebug(lcSettings) << "border.size = " << m_borderSize;
+  invalidateSnapshot();
   emit borderSizeChanged(m_borderSize);
 }
 
@@ -734,6 +834,7 @@ void Settings::setBorderOpacity(double opacity)
     m_borderOpacity = qMin(qMax(::settings::ranges::borderOpacity.min, opacity), ::settings::ranges::borderOpacity.max);
     m_settings->setValue(::settings::borderOpacity, m_borderOpacity);
     logDebug(lcSettings) << "border.opacity = " << m_borderOpacity;
+    invalidateSnapshot();
     emit borderOpacityChanged(m_borderOpacity);
   }
 }
@@ -746,6 +847,7 @@ void Settings::setZoomEnabled(bool enabled)
   m_zoomEnabled = enabled;
   m_settings->setValue(::settings::zoomEnabled, m_zoomEnabled);
   logDebug(lcSettings) << "zoom = " << m_zoomEnabled;
+  invalidateSnapshot();
   emit zoomEnabledChanged(m_zoomEnabled);
 }
 
@@ -757,6 +859,7 @@ void Settings::setZoomFactor(double factor)
     m_zoomFactor = qMin(qMax(::settings::ranges::zoomFactor.min, factor), ::settings::ranges::zoomFactor.max);
     m_settings->setValue(::settings::zoomFactor, m_zoomFactor);
     logDebug(lcSettings) << "zoom.factor = " << m_zoomFactor;
+    invalidateSnapshot();
     emit zoomFactorChanged(m_zoomFactor);
   }
 }
@@ -768,6 +871,7 @@ void Settings::setMultiScreenOverlayEnabled(bool enabled)
     m_multiScreenOverlayEnabled = enabled;
     m_settings->setValue(::settings::multiScreenOverlay, m_multiScreenOverlayEnabled);
     logDebug(lcSettings) << "multi-screen-overlay = " << m_multiScreenOverlayEnabled;
+    invalidateSnapshot();
     emit multiScreenOverlayEnabledChanged(m_multiScreenOverlayEnabled);
 }
 
@@ -776,9 +880,36 @@ void Settings::setOverlayDisabled(bool disabled)
 {
   if (m_overlayDisabled == disabled) { return; }
   m_overlayDisabled = disabled;
+  invalidateSnapshot();
   emit overlayDisabledChanged(m_overlayDisabled);
 }
 
+// -------------------------------------------------------------------------------------------------
+void Settings::setOverlayReleaseDelay(int seconds)
+{
+  if (seconds == m_overlayReleaseDelay) { return; }
+
+  m_overlayReleaseDelay = qMin(qMax(::settings::ranges::overlayReleaseDelay.min, seconds),
+                               ::settings::ranges::overlayReleaseDelay.max);
+  m_settings->setValue(::settings::overlayReleaseDelay, m_overlayReleaseDelay);
+  logDebug(lcSettings) << "overlay.release-delay = " << m_overlayReleaseDelay;
+  invalidateSnapshot();
+  emit overlayReleaseDelayChanged(m_overlayReleaseDelay);
+}
+
+// -------------------------------------------------------------------------------------------------
+void Settings::setOverlayMemoryBudget(int megabytes)
+{
+  if (megabytes == m_overlayMemoryBudget) { return; }
+
+  m_overlayMemoryBudget = qMin(qMax(::settings::ranges::overlayMemoryBudget.min, megabytes),
+                               ::settings::ranges::overlayMemoryBudget.max);
+  m_settings->setValue(::settings::overlayMemoryBudget, m_overlayMemoryBudget);
+  logDebug(lcSettings) << "overlay.memory-budget = " << m_overlayMemoryBudget;
+  invalidateSnapshot();
+  emit overlayMemoryBudgetChanged(m_overlayMemoryBudget);
+}
+
 // -------------------------------------------------------------------------------------------------
 QString Settings::StringProperty::typeToString(Type type)
 {
@@ -798,15 +929,179 @@ void Settings::setDeviceInputSeqInterval(const DeviceId& dId, int intervalMs)
   const auto v = qMin(qMax(::settings::ranges::inputSequenceInterval.min, intervalMs),
                            ::settings::ranges::inputSequenceInterval.max);
   m_settings->setValue(settingsKey(dId, ::settings::inputSequenceInterval), v);
+  deviceInputEntry(dId).inputSeqInterval = v;
+  invalidateSnapshot();
 }
 
 // -------------------------------------------------------------------------------------------------
 int Settings::deviceInputSeqInterval(const DeviceId& dId) const
 {
-  const auto value = m_settings->value(settingsKey(dId, ::settings::inputSequenceInterval),
-                                       ::settings::defaultValue::inputSequenceInterval).toInt();
-  return qMin(qMax(::settings::ranges::inputSequenceInterval.min, value),
-                   ::settings::ranges::inputSequenceInterval.max);
+  return findDeviceInput(m_deviceInputs, dId).inputSeqInterval;
+}
+
+// -------------------------------------------------------------------------------------------------
+void Settings::setDeviceAdaptiveInputSeq(const DeviceId& dId, bool adaptive)
+{
+  m_settings->setValue(settingsKey(dId, ::settings::adaptiveInputSequence), adaptive);
+  deviceInputEntry(dId).adaptiveInputSeq = adaptive;
+  invalidateSnapshot();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool Settings::deviceAdaptiveInputSeq(const DeviceId& dId) const
+{
+  return findDeviceInput(m_deviceInputs, dId).adaptiveInputSeq;
+}
+
+// -------------------------------------------------------------------------------------------------
+void Settings::setDeviceFirmwareRemapping(const DeviceId& dId, bool enabled)
+{
+  m_settings->setValue(settingsKey(dId, ::settings::firmwareRemapping), enabled);
+  deviceInputEntry(dId).firmwareRemapping = enabled;
+  invalidateSnapshot();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool Settings::deviceFirmwareRemapping(const DeviceId& dId) const
+{
+  return findDeviceInput(m_deviceInputs, dId).firmwareRemapping;
+}
+
+// -------------------------------------------------------------------------------------------------
+void Settings::setDeviceRepeatMappedActions(const DeviceId& dId, bool repeat)
+{
+  m_settings->setValue(settingsKey(dId, ::settings::repeatMappedActions), repeat);
+  deviceInputEntry(dId).repeatMappedActions = repeat;
+  invalidateSnapshot();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool Settings::deviceRepeatMappedActions(const DeviceId& dId) const
+{
+  return findDeviceInput(m_deviceInputs, dId).repeatMappedActions;
+}
+
+// -------------------------------------------------------------------------------------------------
+void Settings::setDeviceRegenerateAutorepeat(const DeviceId& dId, bool regenerate)
+{
+  m_settings->setValue(settingsKey(dId, ::settings::regenerateAutorepeat), regenerate);
+  deviceInputEntry(dId).regenerateAutorepeat = regenerate;
+  invalidateSnapshot();
+}
+
+// -------------------------------------------------------------------------------------------------
+bool Settings::deviceRegenerateAutorepeat(const DeviceId& dId) const
+{
+  return findDeviceInput(m_deviceInputs, dId).regenerateAutorepeat;
+}
+
+// -------------------------------------------------------------------------------------------------
+Settings::DeviceInput& Settings::deviceInputEntry(const DeviceId& dId)
+{
+  return m_deviceInputs.emplace(deviceKey(dId.vendorId, dId.productId),
+                                defaultDeviceInput()).first->second;
+}
+
+// -------------------------------------------------------------------------------------------------
+void Settings::loadDeviceInputs()
+{
+  m_deviceInputs.clear();
+  for (const auto& group : m_settings->childGroups())
+  {
+    // Device groups are named 'Device_<vendorId>_<productId>', see settingsKey()
+    const auto parts = group.split('_');
+    if (parts.size() != 3 || parts[0] != "Device") { continue; }
+
+    bool vendorOk = false, productOk = false;
+    const auto vendorId = parts[1].toUShort(&vendorOk, 16);
+    const auto productId = parts[2].toUShort(&productOk, 16);
+    if (!vendorOk || !productOk) { continue; }
+
+    const auto value = [this, &group](const char* key, const QVariant& defaultValue) {
+      return m_settings->value(QString("%1/%2").arg(group, key), defaultValue);
+    };
+
+    auto& di = m_deviceInputs[deviceKey(vendorId, productId)];
+    di.inputSeqInterval
+      = qMin(qMax(::settings::ranges::inputSequenceInterval.min,
+                  value(::settings::inputSequenceInterval,
+                        ::settings::defaultValue::inputSequenceInterval).toInt()),
+             ::settings::ranges::inputSequenceInterval.max);
+    di.adaptiveInputSeq = value(::settings::adaptiveInputSequence,
+                                ::settings::defaultValue::adaptiveInputSequence).toBool();
+    di.firmwareRemapping = value(::settings::firmwareRemapping,
+                                 ::settings::defaultValue::firmwareRemapping).toBool();
+    di.repeatMappedActions = value(::settings::repeatMappedActions,
+                                   ::settings::defaultValue::repeatMappedActions).toBool();
+    di.regenerateAutorepeat = value(::settings::regenerateAutorepeat,
+                                    ::settings::defaultValue::regenerateAutorepeat).toBool();
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+Settings::DeviceInput Settings::Snapshot::deviceInput(const DeviceId& dId) const
+{
+  return findDeviceInput(deviceInputs, dId);
+}
+
+// -------------------------------------------------------------------------------------------------
+std::shared_ptr<const Settings::Snapshot> Settings::snapshot() const
+{
+  if (!m_snapshot) { m_snapshot = buildSnapshot(); }
+  return m_snapshot;
+}
+
+// -------------------------------------------------------------------------------------------------
+void Settings::invalidateSnapshot()
+{
+  m_snapshot.reset();
+  ++m_snapshotVersion;
+  if (m_snapshotBatchDepth > 0)
+  {
+    m_snapshotPending = true;
+    return;
+  }
+  m_snapshotPending = false;
+  emit snapshotPublished(m_snapshotVersion);
+}
+
+// -------------------------------------------------------------------------------------------------
+std::shared_ptr<const Settings::Snapshot> Settings::buildSnapshot() const
+{
+  auto s = std::make_shared<Snapshot>();
+  s->version = m_snapshotVersion;
+  s->showSpotShade = m_showSpotShade;
+  s->spotSize = m_spotSize;
+  s->showCenterDot = m_showCenterDot;
+  s->dotSize = m_dotSize;
+  s->dotColor = m_dotColor;
+  s->dotOpacity = m_dotOpacity;
+  s->shadeColor = m_shadeColor;
+  s->shadeOpacity = m_shadeOpacity;
+  s->cursor = m_cursor;
+  s->spotShape = m_spotShape;
+  s->spotRotation = m_spotRotation;
+  s->spotRotationAllowed = m_spotRotationAllowed;
+  s->showBorder = m_showBorder;
+  s->borderColor = m_borderColor;
+  s->borderSize = m_borderSize;
+  s->borderOpacity = m_borderOpacity;
+  s->zoomEnabled = m_zoomEnabled;
+  s->zoomFactor = m_zoomFactor;
+  s->multiScreenOverlayEnabled = m_multiScreenOverlayEnabled;
+  s->overlayDisabled = m_overlayDisabled;
+  s->overlayReleaseDelay = m_overlayReleaseDelay;
+  s->overlayMemoryBudget = m_overlayMemoryBudget;
+  s->presets = m_presetModel->presets();
+  for (const auto& item : m_shapeSettings)
+  {
+    auto& values = s->shapeSettings[item.first];
+    for (const auto& key : item.second->keys()) {
+      values.insert(key, item.second->value(key));
+    }
+  }
+  s->deviceInputs = m_deviceInputs;
+  return s;
 }
 
 // -------------------------------------------------------------------------------------------------
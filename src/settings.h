@@ -4,6 +4,7 @@
 
 #include <functional>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include <QAbstractListModel>
@@ -88,6 +89,10 @@ public:
   void setMultiScreenOverlayEnabled(bool enabled);
   bool overlayDisabled() const { return m_overlayDisabled; }
   void setOverlayDisabled(bool disabled);
+  int overlayReleaseDelay() const { return m_overlayReleaseDelay; }
+  void setOverlayReleaseDelay(int seconds);
+  int overlayMemoryBudget() const { return m_overlayMemoryBudget; }
+  void setOverlayMemoryBudget(int megabytes);
 
   template <typename T> struct SettingRange {
     const T min;
@@ -102,6 +107,8 @@ public:
   static const SettingRange<int>& borderSizeRange();
   static const SettingRange<double>& borderOpacityRange();
   static const SettingRange<double>& zoomFactorRange();
+  static const SettingRange<int>& overlayReleaseDelayRange();
+  static const SettingRange<int>& overlayMemoryBudgetRange();
   static const SettingRange<int>& inputSequenceIntervalRange();
 
   class SpotShapeSetting {
@@ -169,6 +176,14 @@ public:
 
   void setDeviceInputSeqInterval(const DeviceId& dId, int intervalMs);
   int deviceInputSeqInterval(const DeviceId& dId) const;
+  void setDeviceAdaptiveInputSeq(const DeviceId& dId, bool adaptive);
+  bool deviceAdaptiveInputSeq(const DeviceId& dId) const;
+  void setDeviceFirmwareRemapping(const DeviceId& dId, bool enabled);
+  bool deviceFirmwareRemapping(const DeviceId& dId) const;
+  void setDeviceRepeatMappedActions(const DeviceId& dId, bool repeat);
+  bool deviceRepeatMappedActions(const DeviceId& dId) const;
+  void setDeviceRegenerateAutorepeat(const DeviceId& dId, bool regenerate);
+  bool deviceRegenerateAutorepeat(const DeviceId& dId) const;
   void setDeviceInputMapConfig(const DeviceId& dId, const InputMapConfig& imc);
   InputMapConfig getDeviceInputMapConfig(const DeviceId& dId);
 
@@ -178,6 +193,55 @@ public:
   void setVibrationSettings(const DeviceId& dId, uint8_t len, uint8_t intensity);
   std::pair<uint8_t, uint8_t> vibrationSettings(const DeviceId& dId) const;
 
+  /// Input mapper settings of a device.
+  struct DeviceInput
+  {
+    int inputSeqInterval = 0;
+    bool adaptiveInputSeq = false;
+    bool firmwareRemapping = false;
+    bool repeatMappedActions = false;
+    bool regenerateAutorepeat = false;
+  };
+
+  /// Immutable copy of the settings values. A holder keeps a consistent view of all values, even
+  /// if settings change in between.
+  struct Snapshot
+  {
+    quint64 version = 0;
+    bool showSpotShade = true;
+    int spotSize = 30;
+    bool showCenterDot = false;
+    int dotSize = 5;
+    QColor dotColor;
+    double dotOpacity = 0.8;
+    QColor shadeColor;
+    double shadeOpacity = 0.3;
+    Qt::CursorShape cursor = Qt::BlankCursor;
+    QString spotShape;
+    double spotRotation = 0.0;
+    bool spotRotationAllowed = false;
+    bool showBorder = false;
+    QColor borderColor;
+    int borderSize = 3;
+    double borderOpacity = 0.8;
+    bool zoomEnabled = false;
+    double zoomFactor = 2.0;
+    bool multiScreenOverlayEnabled = false;
+    bool overlayDisabled = false;
+    int overlayReleaseDelay = 30;
+    int overlayMemoryBudget = 64;
+    std::vector<QString> presets;
+    std::map<QString, QVariantMap> shapeSettings; ///< Shape name -> shape setting values
+    std::map<quint32, DeviceInput> deviceInputs; ///< (vendorId << 16 | productId) -> settings
+
+    /// Input mapper settings of the device, the default values if none are configured.
+    DeviceInput deviceInput(const DeviceId& dId) const;
+  };
+
+  /// Returns a snapshot of the current settings, GUI thread only. The snapshot is built on the
+  /// first call after a change.
+  std::shared_ptr<const Snapshot> snapshot() const;
+
 signals:
   void showSpotShadeChanged(bool show);
   void spotSizeChanged(int size);
@@ -199,8 +263,13 @@ signals:
   void zoomFactorChanged(double zoomFactor);
   void multiScreenOverlayEnabledChanged(bool enabled);
   void overlayDisabledChanged(bool disabled);
+  void overlayReleaseDelayChanged(int seconds);
+  void overlayMemoryBudgetChanged(int megabytes);
 
   void presetLoaded(const QString& preset);
+  /// Emitted once after the settings changed, multiple changes of a batch update (e.g. loading
+  /// a preset) are coalesced into a single notification.
+  void snapshotPublished(quint64 version);
 
 private:
   QSettings* m_settings = nullptr;
@@ -229,9 +298,18 @@ private:
   bool m_showBorder = false;
   bool m_multiScreenOverlayEnabled = false;
   bool m_overlayDisabled = false;
+  int m_overlayReleaseDelay = 30; ///< Seconds of inactivity until overlay resources are released.
+  int m_overlayMemoryBudget = 64; ///< Overlay memory (MB) that is kept while the spot is inactive.
 
   std::vector<std::pair<QString, StringProperty>> m_stringPropertyMap;
 
+  class SnapshotBatch;
+  mutable std::shared_ptr<const Snapshot> m_snapshot; ///< Built on demand, reset on changes
+  quint64 m_snapshotVersion = 0;
+  int m_snapshotBatchDepth = 0;
+  bool m_snapshotPending = false;
+  std::map<quint32, DeviceInput> m_deviceInputs;
+
 private:
   void init();
   void load(const QString& preset = QString());
@@ -243,6 +321,10 @@ private:
   void shapeSettingsSavePreset(const QString& preset);
   void setSpotRotationAllowed(bool allowed);
   void initializeStringProperties();
+  void loadDeviceInputs();
+  DeviceInput& deviceInputEntry(const DeviceId& dId);
+  void invalidateSnapshot();
+  std::shared_ptr<const Snapshot> buildSnapshot() const;
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -0,0 +1,215 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "shadeitem.h"
+
+#include <QQuickWindow>
+#include <QSGSimpleRectNode>
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+#include <QSGRendererInterface>
+#endif
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace {
+  const bool registered = [](){
+    ShadeItem::qmlRegister();
+    return true;
+  }();
+
+  namespace Defaults {
+    constexpr int tileSize = 128;
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Only the software renderer repaints just the changed nodes, the OpenGL/RHI renderers redraw
+  /// the full frame and would only get more nodes to draw from a tiled shade.
+  bool partialUpdates(const QQuickWindow* window)
+  {
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+    const auto ri = window ? window->rendererInterface() : nullptr;
+    return ri && ri->graphicsApi() == QSGRendererInterface::Software;
+  #else
+    Q_UNUSED(window)
+    return false;
+  #endif
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Shade around the spot: either four rectangles around the spot, or static tiles with four
+  /// fringe rectangles between the spot and the tiles it covers.
+  class ShadeNode : public QSGNode
+  {
+  public:
+    ShadeNode(const QSizeF& size, const QColor& color, bool tiled)
+      : m_size(size)
+      , m_color(color)
+      , m_tiled(tiled)
+      , m_columns(tiled ? static_cast<int>(std::ceil(size.width() / Defaults::tileSize)) : 0)
+      , m_rows(tiled ? static_cast<int>(std::ceil(size.height() / Defaults::tileSize)) : 0)
+    {
+      m_tiles.reserve(static_cast<size_t>(m_columns * m_rows));
+      for (int row = 0; row < m_rows; ++row) {
+        for (int column = 0; column < m_columns; ++column) {
+          m_tiles.push_back(addRectNode(tileRect(column, row)));
+        }
+      }
+
+      for (auto& fringe : m_fringe) {
+        fringe = addRectNode(QRectF());
+      }
+    }
+
+    const QSizeF& size() const { return m_size; }
+    bool tiled() const { return m_tiled; }
+
+    void setColor(const QColor& color)
+    {
+      if (color == m_color) { return; }
+
+      m_color = color;
+      for (auto tile : m_tiles) { tile->setColor(m_color); }
+      for (auto fringe : m_fringe) { fringe->setColor(m_color); }
+    }
+
+    void setSpotRect(const QRectF& spot)
+    {
+      const auto holeTiles = spot.isEmpty() ? QRect()
+        : QRect(QPoint(static_cast<int>(std::floor(spot.left() / Defaults::tileSize)),
+                       static_cast<int>(std::floor(spot.top() / Defaults::tileSize))),
+                QPoint(static_cast<int>(std::ceil(spot.right() / Defaults::tileSize)) - 1,
+                       static_cast<int>(std::ceil(spot.bottom() / Defaults::tileSize)) - 1))
+          .intersected(QRect(0, 0, m_columns, m_rows));
+
+      if (holeTiles != m_holeTiles)
+      {
+        // Restore tiles that are not covered by the spot anymore and clear newly covered tiles.
+        for (int row = m_holeTiles.top(); row <= m_holeTiles.bottom(); ++row) {
+          for (int column = m_holeTiles.left(); column <= m_holeTiles.right(); ++column) {
+            if (!holeTiles.contains(column, row)) {
+              setRect(m_tiles[static_cast<size_t>(row * m_columns + column)], tileRect(column, row));
+            }
+          }
+        }
+        for (int row = holeTiles.top(); row <= holeTiles.bottom(); ++row) {
+          for (int column = holeTiles.left(); column <= holeTiles.right(); ++column) {
+            if (!m_holeTiles.contains(column, row)) {
+              setRect(m_tiles[static_cast<size_t>(row * m_columns + column)], QRectF());
+            }
+          }
+        }
+        m_holeTiles = holeTiles;
+      }
+
+      // Without tiles the rectangles fill the whole item, otherwise only the cleared tiles.
+      const auto r = !m_tiled ? QRectF(QPointF(), m_size)
+                   : holeTiles.isEmpty() ? QRectF()
+                   : tileRect(holeTiles.left(), holeTiles.top())
+                       .united(tileRect(holeTiles.right(), holeTiles.bottom()));
+      if (r.isEmpty() || spot.isEmpty())
+      {
+        setRect(m_fringe[0], r);
+        for (size_t i = 1; i < m_fringe.size(); ++i) { setRect(m_fringe[i], QRectF()); }
+        return;
+      }
+
+      const auto hole = spot.intersected(r);
+      setRect(m_fringe[0], QRectF(r.left(), r.top(), r.width(), hole.top() - r.top()));
+      setRect(m_fringe[1], QRectF(r.left(), hole.bottom(), r.width(), r.bottom() - hole.bottom()));
+      setRect(m_fringe[2], QRectF(r.left(), hole.top(), hole.left() - r.left(), hole.height()));
+      setRect(m_fringe[3], QRectF(hole.right(), hole.top(), r.right() - hole.right(), hole.height()));
+    }
+
+  private:
+    QRectF tileRect(int column, int row) const
+    {
+      return QRectF(column * Defaults::tileSize, row * Defaults::tileSize,
+                    Defaults::tileSize, Defaults::tileSize).intersected(QRectF(QPointF(), m_size));
+    }
+
+    QSGSimpleRectNode* addRectNode(const QRectF& rect)
+    {
+      const auto node = new QSGSimpleRectNode(rect, m_color);
+      appendChildNode(node);
+      return node;
+    }
+
+    static void setRect(QSGSimpleRectNode* node, const QRectF& rect)
+    {
+      // Only changed nodes are part of the damaged region
+      if (node->rect() != rect) { node->setRect(rect); }
+    }
+
+    const QSizeF m_size;
+    QColor m_color;
+    const bool m_tiled = false;
+    const int m_columns = 0;
+    const int m_rows = 0;
+    QRect m_holeTiles;
+    std::vector<QSGSimpleRectNode*> m_tiles;
+    std::array<QSGSimpleRectNode*, 4> m_fringe {{}};
+  };
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+ShadeItem::ShadeItem(QQuickItem* parent)
+  : QQuickItem(parent)
+{
+  setEnabled(false);
+  setFlag(QQuickItem::ItemHasContents);
+  connect(this, &QQuickItem::widthChanged, this, &QQuickItem::update);
+  connect(this, &QQuickItem::heightChanged, this, &QQuickItem::update);
+}
+
+// -------------------------------------------------------------------------------------------------
+int ShadeItem::qmlRegister()
+{
+  return qmlRegisterType<ShadeItem>("Projecteur.Utils", 1, 0, "Shade");
+}
+
+// -------------------------------------------------------------------------------------------------
+void ShadeItem::setColor(const QColor& color)
+{
+  if (m_color == color) { return; }
+
+  m_color = color;
+  update();
+  emit colorChanged(m_color);
+}
+
+// -------------------------------------------------------------------------------------------------
+void ShadeItem::setSpotRect(const QRectF& rect)
+{
+  if (m_spotRect == rect) { return; }
+
+  m_spotRect = rect;
+  update();
+  emit spotRectChanged(m_spotRect);
+}
+
+// -------------------------------------------------------------------------------------------------
+QSGNode* ShadeItem::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* /* data */)
+{
+  auto node = static_cast<ShadeNode*>(oldNode);
+
+  if (width() <= 0 || height() <= 0)
+  {
+    delete node;
+    return nullptr;
+  }
+
+  const QSizeF size(width(), height());
+  const bool tiled = partialUpdates(window());
+  if (node == nullptr || node->size() != size || node->tiled() != tiled)
+  {
+    delete node;
+    node = new ShadeNode(size, m_color, tiled);
+  }
+
+  node->setColor(m_color);
+  node->setSpotRect(m_spotRect.intersected(boundingRect()));
+  return node;
+}
@@ -0,0 +1,43 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QColor>
+#include <QQuickItem>
+
+/// Fills the item with the shade color, except for the spot rectangle.
+///
+/// With the OpenGL/RHI renderers, which redraw the full frame, the shade consists of four
+/// rectangles around the spot. The software renderer only repaints changed nodes; there the shade
+/// is composed of static tiles, and only tiles around the previous and current spot rectangle
+/// change when the spot moves. That way the damaged (repainted) region of the overlay scales with
+/// the spot size and not with the screen resolution.
+class ShadeItem : public QQuickItem
+{
+  Q_OBJECT
+  Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
+  Q_PROPERTY(QRectF spotRect READ spotRect WRITE setSpotRect NOTIFY spotRectChanged)
+
+public:
+  static int qmlRegister();
+
+  explicit ShadeItem(QQuickItem* parent = nullptr);
+  virtual ~ShadeItem() override = default;
+
+  QColor color() const { return m_color; }
+  void setColor(const QColor& color);
+
+  QRectF spotRect() const { return m_spotRect; }
+  void setSpotRect(const QRectF& rect);
+
+signals:
+  void colorChanged(const QColor& color);
+  void spotRectChanged(const QRectF& rect);
+
+protected:
+  QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data) override;
+
+private:
+  QColor m_color = Qt::black;
+  QRectF m_spotRect;
+};
@@ -3,16 +3,21 @@
 
 #include "spotlight.h"
 
+#include "device-cache.h"
 #include "device-hidpp.h"
 #include "deviceinput.h"
 #include "logging.h"
+#include "metrics.h"
 #include "settings.h"
+#include "timing.h"
 #include "virtualdevice.h"
+#include "watchdog.h"
 
 #include <QSocketNotifier>
 #include <QTimer>
 #include <QVarLengthArray>
 
+#include <algorithm>
 #include <cmath>
 #include <fcntl.h>
 #include <sys/inotify.h>
@@ -26,9 +31,20 @@ DECLARE_LOGGING_CATEGORY(input)
 namespace {
   const auto hexId = logging::hexId;
 
-  // See details on workaround in onEventDataAvailable
+  // See details on workaround in processEventFrame
   bool workaroundLogitechFirstMoveEvent = true;
 
+  // Event timestamp in microseconds, with the compatible accessors for 64 bit time_t on 32 bit
+  // architectures (linux/input.h >= 4.16).
+  uint64_t timestampUs(const input_event& ev)
+  {
+  #if defined(input_event_sec)
+    return static_cast<uint64_t>(ev.input_event_sec) * 1000000 + static_cast<uint64_t>(ev.input_event_usec);
+  #else
+    return static_cast<uint64_t>(ev.time.tv_sec) * 1000000 + static_cast<uint64_t>(ev.time.tv_usec);
+  #endif
+  }
+
 } // end anonymous namespace
 
 
@@ -70,21 +86,54 @@ private:
   KeyEventSequence m_moveKeyEvSeq;
 };
 
+// -------------------------------------------------------------------------------------------------
+// Complete input event frames (terminated by EV_SYN) read from the event sub-devices of a device
+// within one wakeup. Frames are processed ordered by their kernel timestamp.
+struct InputFrameMerger
+{
+  struct Frame {
+    SubEventConnection* connection = nullptr;
+    size_t offset = 0;
+    size_t count = 0;
+    uint64_t timestamp = 0; // time of the EV_SYN event in microseconds
+  };
+
+  void clear() { frames.clear(); events.clear(); }
+
+  void add(SubEventConnection& connection, const input_event* frameEvents, size_t count)
+  {
+    frames.push_back({&connection, events.size(), count, timestampUs(frameEvents[count-1])});
+    events.insert(events.end(), frameEvents, frameEvents + count);
+  }
+
+  void sortByTime()
+  {
+    std::stable_sort(frames.begin(), frames.end(), [](const Frame& a, const Frame& b) {
+      return a.timestamp < b.timestamp;
+    });
+  }
+
+  std::vector<Frame> frames;
+  std::vector<input_event> events;
+};
+
 // -------------------------------------------------------------------------------------------------
 Spotlight::Spotlight(QObject* parent, Options options, Settings* settings)
   : QObject(parent)
   , m_options(std::move(options))
-  , m_activeTimer(new QTimer(this))
-  , m_connectionTimer(new QTimer(this))
-  , m_holdMoveEventTimer(new QTimer(this))
+  , m_activeTimer(new timing::Timer(this))
+  , m_connectionTimer(new timing::Timer(this))
+  , m_holdMoveEventTimer(new timing::Timer(this))
   , m_settings(settings)
   , m_holdButtonStatus(std::make_unique<HoldButtonStatus>())
+  , m_inputFrameMerger(std::make_unique<InputFrameMerger>())
+  , m_deviceStateCache(std::make_unique<DeviceStateCache>())
 {
   constexpr int spotlightActiveTimoutMs = 600;
   m_activeTimer->setSingleShot(true);
   m_activeTimer->setInterval(spotlightActiveTimoutMs);
 
-  connect(m_activeTimer, &QTimer::timeout, this, [this](){
+  connect(m_activeTimer, &timing::Timer::timeout, this, [this](){
     setSpotActive(false);
     workaroundLogitechFirstMoveEvent = true;
   });
@@ -106,7 +155,7 @@ Spotlight::Spotlight(QObject* parent, Options options, Settings* settings)
   constexpr int delayedConnectionTimerIntervalMs = 800;
   m_connectionTimer->setInterval(delayedConnectionTimerIntervalMs);
 
-  connect(m_connectionTimer, &QTimer::timeout, this, [this]() {
+  connect(m_connectionTimer, &timing::Timer::timeout, this, [this]() {
     logDebug(device) << tr("New connection check triggered");
     connectDevices();
   });
@@ -114,6 +163,23 @@ Spotlight::Spotlight(QObject* parent, Options options, Settings* settings)
   m_holdMoveEventTimer->setSingleShot(true);
   m_holdMoveEventTimer->setInterval(30);
 
+  if (m_options.inputThread.enabled && m_options.connectDevices)
+  {
+    m_inputThread = std::make_unique<InputThread>(m_options.inputThread,
+      [this](const InputThread::Frame& frame) { onInputThreadFrame(frame); });
+    if (!m_inputThread->start()) { m_inputThread.reset(); }
+  }
+
+  if (!m_options.connectDevices) {
+    logInfo(device) << tr("Device connections are handled by the input helper.");
+    return;
+  }
+
+  if (!m_options.scanDevices) {
+    logInfo(device) << tr("Device scanning is disabled, no presenter devices are connected.");
+    return;
+  }
+
   // Try to find already attached device(s) and connect to it.
   connectDevices();
   setupDevEventInotify();
@@ -157,6 +223,42 @@ std::shared_ptr<DeviceConnection> Spotlight::deviceConnection(const DeviceId& de
   return (find_it != m_deviceConnections.end()) ? find_it->second : std::shared_ptr<DeviceConnection>();
 }
 
+// -------------------------------------------------------------------------------------------------
+void Spotlight::cyclePresets()
+{
+  const auto settings = m_settings->snapshot();
+  const auto& presets = settings->presets;
+  auto it = std::find(presets.cbegin(), presets.cend(), m_lastPreset);
+  if ((it == presets.cend()) || (++it == presets.cend())) {
+    it = presets.cbegin();
+  }
+
+  if (it != presets.cend())
+  {
+    m_lastPreset = *it;
+    m_settings->loadPreset(m_lastPreset);
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void Spotlight::toggleSpotlight()
+{
+  m_settings->setOverlayDisabled(!m_settings->snapshot()->overlayDisabled);
+}
+
+// -------------------------------------------------------------------------------------------------
+QVariantMap Spotlight::deviceUiState(const DeviceId& deviceId) const
+{
+  const auto entry = m_deviceStateCache->find(deviceId);
+  return entry ? entry->uiState : QVariantMap();
+}
+
+// -------------------------------------------------------------------------------------------------
+void Spotlight::setDeviceUiState(const DeviceId& deviceId, const QVariantMap& state)
+{
+  m_deviceStateCache->entry(deviceId).uiState = state;
+}
+
 // -------------------------------------------------------------------------------------------------
 std::vector<Spotlight::ConnectedDeviceInfo> Spotlight::connectedDevices() const
 {
@@ -171,14 +273,25 @@ std::vector<Spotlight::ConnectedDeviceInfo> Spotlight::connectedDevices() const
 // -------------------------------------------------------------------------------------------------
 int Spotlight::connectDevices()
 {
+  const watchdog::Zone zone("Spotlight::connectDevices");
   const auto scanResult = DeviceScan::getDevices(m_options.additionalDevices);
 
   for (const auto& dev : scanResult.devices)
   {
     auto& dc = m_deviceConnections[dev.id];
-    if (!dc) {
-      dc = std::make_shared<DeviceConnection>(
-        dev.id, dev.getName(), m_virtualMouseDevice, m_virtualKeyDevice);
+    bool restored = false; // input mapper restored from a previous connection
+    if (!dc)
+    {
+      if (auto im = m_deviceStateCache->takeInputMapper(dev.id))
+      {
+        dc = std::make_shared<DeviceConnection>(dev.id, dev.getName(), std::move(im));
+        restored = true;
+      }
+      else
+      {
+        dc = std::make_shared<DeviceConnection>(
+          dev.id, dev.getName(), m_virtualMouseDevice, m_virtualKeyDevice);
+      }
     }
 
     const bool anyConnectedBefore = anySpotlightDeviceConnected();
@@ -205,6 +318,10 @@ int Spotlight::connectDevices()
           {
             if (auto hidppCon = SubHidppConnection::create(scanSubDevice, *dc))
             {
+              if (const auto entry = m_deviceStateCache->find(dc->deviceId())) {
+                hidppCon->restoreFeatureSet(entry->featureSet);
+              }
+
               QPointer<SubHidppConnection> connPtr(hidppCon.get());
 
               connect(&*hidppCon, &SubHidppConnection::featureSetInitialized, this,
@@ -253,37 +370,38 @@ int Spotlight::connectDevices()
 
       if (!subDeviceConnection) { continue; }
 
-      if (dc->subDeviceCount() == 0) {
+      if (dc->subDeviceCount() == 0 && restored) {
+        logDebug(device) << tr("Restored input mapping from memory: %1 (%2:%3)")
+                            .arg(dc->deviceName(), hexId(dev.id.vendorId), hexId(dev.id.productId));
+        metrics::counter("projecteur_device_restores",
+                         "Device reconnects restored from the device state cache.").inc();
+      }
+      else if (dc->subDeviceCount() == 0) {
         // Load Input mapping settings when first sub-device gets added.
         const auto im = dc->inputMapper().get();
 
         im->setKeyEventInterval(m_settings->deviceInputSeqInterval(dev.id));
+        im->setAdaptiveSequenceTiming(m_settings->deviceAdaptiveInputSeq(dev.id));
+        im->setFirmwareRemapping(m_settings->deviceFirmwareRemapping(dev.id));
+        im->setRepeatMappedActions(m_settings->deviceRepeatMappedActions(dev.id));
+        im->setRegenerateAutorepeat(m_settings->deviceRegenerateAutorepeat(dev.id));
         im->setConfiguration(m_settings->getDeviceInputMapConfig(dev.id));
 
         connect(im, &InputMapper::configurationChanged, this, [this, id=dev.id, im]() {
           m_settings->setDeviceInputMapConfig(id, im->configuration());
         });
 
-        static QString lastPreset;
-
         connect(im, &InputMapper::actionMapped, this, [this](const std::shared_ptr<Action>& action)
         {
           if (action->type() == Action::Type::CyclePresets)
           {
-            auto it = std::find(m_settings->presets().cbegin(), m_settings->presets().cend(), lastPreset);
-            if ((it == m_settings->presets().cend()) || (++it == m_settings->presets().cend())) {
-              it = m_settings->presets().cbegin();
-            }
-
-            if (it != m_settings->presets().cend())
-            {
-              lastPreset = *it;
-              m_settings->loadPreset(lastPreset);
-            }
+            if (m_options.applySettingsActions) { cyclePresets(); }
+            else { emit cyclePresetsMapped(); }
           }
           else if (action->type() == Action::Type::ToggleSpotlight)
           {
-            m_settings->setOverlayDisabled(!m_settings->overlayDisabled());
+            if (m_options.applySettingsActions) { toggleSpotlight(); }
+            else { emit toggleSpotlightMapped(); }
           }
           else if (action->type() == Action::Type::ScrollHorizontal || action->type() == Action::Type::ScrollVertical)
           {
@@ -335,13 +453,43 @@ int Spotlight::connectDevices()
       emit subDeviceConnected(dev.id, dc->deviceName(), scanSubDevice.deviceFile);
     }
 
-    if (dc->subDeviceCount() == 0) {
+    if (dc->subDeviceCount() == 0)
+    {
+      if (restored) { m_deviceStateCache->entry(dev.id).inputMapper = dc->inputMapper(); }
       m_deviceConnections.erase(dev.id);
     }
   }
   return m_deviceConnections.size();
 }
 
+// -------------------------------------------------------------------------------------------------
+bool Spotlight::connectBenchmarkDevice(int sourceFd, std::shared_ptr<VirtualDevice> sink)
+{
+  const DeviceId id{0xfeed, 0xbe4c, BusType::Unknown, "benchmark"};
+  const DeviceScan::SubDevice sd{"benchmark:event", "benchmark", DeviceScan::SubDevice::Type::Event,
+                                 true, true, false};
+
+  m_virtualMouseDevice = sink;
+  m_virtualKeyDevice = sink;
+
+  auto& dc = m_deviceConnections[id];
+  dc = std::make_shared<DeviceConnection>(id, "Projecteur Input Benchmark", sink, sink);
+
+  auto connection = SubEventConnection::createFromFd(sourceFd, sd, *dc);
+  if (!addInputEventHandler(connection))
+  {
+    m_deviceConnections.erase(id);
+    return false;
+  }
+
+  const bool anyConnectedBefore = anySpotlightDeviceConnected();
+  dc->addSubDevice(std::move(connection));
+  emit deviceConnected(id, dc->deviceName());
+  if (!anyConnectedBefore) { emit anySpotlightDeviceConnectedChanged(true); }
+  emit subDeviceConnected(id, dc->deviceName(), sd.deviceFile);
+  return true;
+}
+
 // -------------------------------------------------------------------------------------------------
 void Spotlight::removeDeviceConnection(const QString &devicePath)
 {
@@ -353,6 +501,24 @@ void Spotlight::removeDeviceConnection(const QString &devicePath)
     }
 
     auto& dc = dc_it->second;
+    if (m_inputThread)
+    {
+      const auto sd = dc->subDevice(devicePath).get();
+      for (auto it = m_inputThreadConnections.begin(); it != m_inputThreadConnections.end(); ++it)
+      {
+        if (it->second.get() != sd) { continue; }
+        m_inputThread->removeDevice(it->first);
+        m_inputThreadConnections.erase(it);
+        break;
+      }
+    }
+
+    // Keep the resolved HID++ features for a reconnect of the sub-device
+    const auto hidppConn = qobject_cast<SubHidppConnection*>(dc->subDevice(devicePath).get());
+    if (hidppConn && hidppConn->featureSet().state() == HIDPP::FeatureSet::State::Initialized) {
+      m_deviceStateCache->entry(dc_it->first).featureSet = hidppConn->featureSet().snapshot();
+    }
+
     if (dc->removeSubDevice(devicePath)) {
       emit subDeviceDisconnected(dc_it->first, dc->deviceName(), devicePath);
     }
@@ -363,6 +529,10 @@ void Spotlight::removeDeviceConnection(const QString &devicePath)
                          .arg(dc->deviceName(), hexId(dc_it->first.vendorId),
                               hexId(dc_it->first.productId));
       emit deviceDisconnected(dc_it->first, dc->deviceName());
+
+      // Keep the compiled input mapping in memory, a reconnect does not need to load it again.
+      dc->inputMapper()->resetState();
+      m_deviceStateCache->entry(dc_it->first).inputMapper = dc->inputMapper();
       dc_it = m_deviceConnections.erase(dc_it);
     }
     else {
@@ -373,6 +543,44 @@ void Spotlight::removeDeviceConnection(const QString &devicePath)
 
 // -------------------------------------------------------------------------------------------------
 void Spotlight::onEventDataAvailable(int fd, SubEventConnection& connection)
+{
+  const watchdog::Zone zone("Spotlight::onEventDataAvailable");
+
+  auto& merger = *m_inputFrameMerger;
+  merger.clear();
+  readEventFrames(fd, connection);
+
+  // A device usually has multiple event sub-devices (e.g. keyboard, mouse and consumer control).
+  // Collect the ready frames of all of them in this wakeup and feed them ordered by their kernel
+  // timestamp into the input mapper. Sub-device removal is always deferred, the connection
+  // pointers stay valid until all frames are processed.
+  const auto dcIt = m_deviceConnections.find(connection.deviceId());
+  if (dcIt != m_deviceConnections.end() && dcIt->second)
+  {
+    for (const auto& item : dcIt->second->subDevices())
+    {
+      const auto& sd = item.second;
+      if (!sd || sd.get() == &connection || sd->type() != ConnectionType::Event
+          || !sd->hasFlags(DeviceFlag::NonBlocking) || !sd->isConnected()
+          || static_cast<SubEventConnection&>(*sd).readByInputThread()) {
+        continue;
+      }
+
+      if (const auto notifier = sd->socketReadNotifier()) {
+        readEventFrames(static_cast<int>(notifier->socket()), static_cast<SubEventConnection&>(*sd));
+      }
+    }
+  }
+
+  if (merger.frames.size() > 1) { merger.sortByTime(); }
+
+  for (const auto& frame : merger.frames) {
+    processEventFrame(*frame.connection, &merger.events[frame.offset], frame.count);
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void Spotlight::readEventFrames(int fd, SubEventConnection& connection)
 {
   const bool isNonBlocking = connection.hasFlags(DeviceFlag::NonBlocking);
   while (true)
@@ -398,44 +606,8 @@ void Spotlight::onEventDataAvailable(int fd, SubEventConnection& connection)
 
     if (ev.type == EV_SYN)
     {
-      // Check for relative events -> set Spotlight active
-      const auto &first_ev = buf[0];
-      const bool isMouseMoveEvent = first_ev.type == EV_REL
-                                    && (first_ev.code == REL_X || first_ev.code == REL_Y);
-
-      if (isMouseMoveEvent)
-      { // Skip input mapping for mouse move events completely
-
-        // Note: During a Next or Back button press the Logitech Spotlight device can send
-        // move events via hid++ notifications. It seems that just when releasing the
-        // next or back button sometimes a mouse move event 'leaks' through here as
-        // relative input event causing the spotlight to be activated.
-        // The workaround skips a first input move event from the logitech spotlight device.
-        const bool isLogitechSpotlight = connection.deviceId().vendorId == 0x46d
-          && (connection.deviceId().productId == 0xc53e || connection.deviceId().productId == 0xb503);
-        const bool logitechIsFirst = isLogitechSpotlight && workaroundLogitechFirstMoveEvent;
-
-        if (isLogitechSpotlight)
-        {
-          workaroundLogitechFirstMoveEvent = false;
-          if(!logitechIsFirst) {
-            if (!spotActive()) { setSpotActive(true); }
-          }
-        }
-        else if (!m_activeTimer->isActive()) {
-          setSpotActive(true);
-        }
-
-        m_activeTimer->start();
-        if (m_virtualMouseDevice) {
-          // forward events to virtual mouse device
-          m_virtualMouseDevice->emitEvents(buf.data(), buf.pos());
-        }
-      }
-      else
-      { // Forward events to input mapper for the device
-        connection.inputMapper()->addEvents(buf.data(), buf.pos());
-      }
+      connection.framesRead().inc();
+      m_inputFrameMerger->add(connection, buf.data(), buf.pos());
       buf.reset();
     }
     else if (buf.pos() >= buf.size())
@@ -449,6 +621,123 @@ void Spotlight::onEventDataAvailable(int fd, SubEventConnection& connection)
   } // end while loop
 }
 
+// -------------------------------------------------------------------------------------------------
+void Spotlight::onInputThreadFrame(const InputThread::Frame& frame)
+{
+  const watchdog::Zone zone("Spotlight::onInputThreadFrame");
+
+  const auto it = m_inputThreadConnections.find(frame.device);
+  if (it == m_inputThreadConnections.end()) { return; } // already removed
+  const auto connection = it->second; // keep alive until the frame is processed
+
+  switch (frame.type)
+  {
+  case InputThread::Frame::Type::Events:
+    connection->framesRead().inc(frame.frames);
+    processEventFrame(*connection, frame.events, frame.count, frame.forwarded);
+    if (frame.frames > 1) { // merged pointer motion, already written to the virtual mouse
+      connection->framesForwarded().inc(frame.frames - 1);
+    }
+    break;
+  case InputThread::Frame::Type::Overflow:
+    // Too many events without EV_SYN, or the input thread dropped frames for the input mapper.
+    logWarning(device) << tr("Discarded input events, resetting input mapper state.");
+    connection->inputMapper()->resetState();
+    break;
+  case InputThread::Frame::Type::ReadError: {
+    m_inputThread->removeDevice(frame.device);
+    m_inputThreadConnections.erase(it);
+
+    const bool anyConnectedBefore = anySpotlightDeviceConnected();
+    connection->disconnect();
+    QTimer::singleShot(0, this, [this, devicePath=connection->path(), anyConnectedBefore](){
+      removeDeviceConnection(devicePath);
+      if (!anySpotlightDeviceConnected() && anyConnectedBefore) {
+        emit anySpotlightDeviceConnectedChanged(false);
+      }
+    });
+    break;
+  }
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void Spotlight::setupDirectForwarding(uint32_t id, const SubEventConnection& connection)
+{
+  const auto im = connection.inputMapper().get();
+  const auto update = [this, id, im]()
+  {
+    InputThread::KeyForwarding forwarding;
+    forwarding.enabled = !im->recordingMode() && im->hasVirtualDevice();
+    forwarding.relayRepeats = !im->regenerateAutorepeat();
+    for (uint16_t code = 0; code < KEY_CNT; ++code) {
+      forwarding.mappedKeys[code] = im->isMappedKey(code);
+    }
+    m_inputThread->setKeyForwarding(id, forwarding);
+  };
+
+  // The input mapper can outlive the connection, e.g. in the device state cache.
+  connect(im, &InputMapper::directForwardingChanged, &connection, update);
+  connect(im, &InputMapper::sequencePendingChanged, &connection, [this, id](bool pending) {
+    m_inputThread->setSequencePending(id, pending);
+  });
+
+  m_inputThread->setSequencePending(id, im->sequencePending());
+  update();
+}
+
+// -------------------------------------------------------------------------------------------------
+void Spotlight::processEventFrame(SubEventConnection& connection, const input_event* events,
+                                  size_t count, bool forwarded)
+{
+  // Check for relative events -> set Spotlight active
+  const auto &first_ev = events[0];
+  const bool isMouseMoveEvent = first_ev.type == EV_REL
+                                && (first_ev.code == REL_X || first_ev.code == REL_Y);
+
+  if (isMouseMoveEvent)
+  { // Skip input mapping for mouse move events completely
+
+    // Note: During a Next or Back button press the Logitech Spotlight device can send
+    // move events via hid++ notifications. It seems that just when releasing the
+    // next or back button sometimes a mouse move event 'leaks' through here as
+    // relative input event causing the spotlight to be activated.
+    // The workaround skips a first input move event from the logitech spotlight device.
+    const bool isLogitechSpotlight = connection.deviceId().vendorId == 0x46d
+      && (connection.deviceId().productId == 0xc53e || connection.deviceId().productId == 0xb503);
+    const bool logitechIsFirst = isLogitechSpotlight && workaroundLogitechFirstMoveEvent;
+
+    if (isLogitechSpotlight)
+    {
+      workaroundLogitechFirstMoveEvent = false;
+      if(!logitechIsFirst) {
+        if (!spotActive()) { setSpotActive(true); }
+      }
+    }
+    else if (!m_activeTimer->isActive()) {
+      setSpotActive(true);
+    }
+
+    m_activeTimer->start();
+    if (forwarded) { // already written to the virtual mouse device by the input thread
+      connection.framesForwarded().inc();
+    }
+    else if (m_virtualMouseDevice) {
+      // forward events to virtual mouse device
+      m_virtualMouseDevice->emitEvents(events, count);
+      connection.framesForwarded().inc();
+    }
+  }
+  else if (forwarded)
+  { // Keys outside of the mapped sequences, already written to the virtual devices
+    connection.inputMapper()->addForwardedEvents(events, count);
+  }
+  else
+  { // Forward events to input mapper for the device
+    connection.inputMapper()->addEvents(events, count);
+  }
+}
+
 // -------------------------------------------------------------------------------------------------
 void Spotlight::registerForNotifications(SubHidppConnection* connection)
 {
@@ -551,6 +840,23 @@ bool Spotlight::addInputEventHandler(std::shared_ptr<SubEventConnection> connect
   }
 
   QSocketNotifier* const readNotifier = connection->socketReadNotifier();
+  if (m_inputThread)
+  {
+    // Each frame is written with a single write call, so the input thread and the event loop
+    // can share the virtual devices.
+    const auto id = m_inputThread->addDevice(static_cast<int>(readNotifier->socket()),
+                                             connection->hasFlags(DeviceFlag::NonBlocking),
+                                             m_virtualMouseDevice.get(), m_virtualKeyDevice.get());
+    if (id != 0)
+    {
+      connection->setReadByInputThread();
+      setupDirectForwarding(id, *connection);
+      m_inputThreadConnections.emplace(id, std::move(connection));
+      return true;
+    }
+    logWarning(device) << tr("Could not add %1 to the input thread.").arg(connection->path());
+  }
+
   connect(readNotifier, &QSocketNotifier::activated, this,
   [this, connection=std::move(connection)](int fd) {
     onEventDataAvailable(fd, *connection);
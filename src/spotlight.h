@@ -3,6 +3,7 @@
 #pragma once
 
 #include <QObject>
+#include <QVariantMap>
 
 #include <map>
 #include <memory>
@@ -10,15 +11,19 @@
 
 #include "asynchronous.h"
 #include "devicescan.h"
+#include "inputthread.h"
 
-class QTimer;
 class Settings;
 class VirtualDevice;
 class DeviceConnection;
+class DeviceStateCache;
 class SubEventConnection;
 class SubHidppConnection;
 
+namespace timing { class Timer; }
+
 struct HoldButtonStatus;
+struct InputFrameMerger;
 
 /// Class handling spotlight device connections and indicating if a device is sending
 /// sending mouse move events.
@@ -30,6 +35,10 @@ public:
   struct Options {
     bool enableUInput = true; // enable virtual uinput device
     std::vector<SupportedDevice> additionalDevices;
+    InputThread::Options inputThread; // read input devices on a real-time thread
+    bool connectDevices = true; // false: devices are handled by the input helper process
+    bool applySettingsActions = true; // false: mapped settings actions are only signaled
+    bool scanDevices = true; // false: no presenter devices are connected (benchmark runs)
   };
 
   explicit Spotlight(QObject* parent, Options options, Settings* settings);
@@ -48,6 +57,18 @@ public:
   std::vector<ConnectedDeviceInfo> connectedDevices() const;
   std::shared_ptr<DeviceConnection> deviceConnection(const DeviceId& deviceId);
 
+  /// Settings actions of the input mapping: load the next preset, toggle the overlay.
+  void cyclePresets();
+  void toggleSpotlight();
+
+  /// State of the device preferences page, restored when a device reconnects.
+  QVariantMap deviceUiState(const DeviceId& deviceId) const;
+  void setDeviceUiState(const DeviceId& deviceId, const QVariantMap& state);
+
+  /// Connect a synthetic device that reads input events from sourceFd and writes all
+  /// forwarded and mapped events to sink instead of the uinput devices (input benchmark).
+  bool connectBenchmarkDevice(int sourceFd, std::shared_ptr<VirtualDevice> sink);
+
 signals:
   void deviceConnected(const DeviceId& id, const QString& name);
   void deviceDisconnected(const DeviceId& id, const QString& name);
@@ -55,6 +76,9 @@ signals:
   void subDeviceDisconnected(const DeviceId& id, const QString& name, const QString& path);
   void anySpotlightDeviceConnectedChanged(bool connected);
   void spotActiveChanged(bool isActive);
+  /// Mapped settings actions, emitted instead of applying them without applySettingsActions.
+  void cyclePresetsMapped();
+  void toggleSpotlightMapped();
 
 private:
   enum class ConnectionResult { CouldNotOpen, NotASpotlightDevice, Connected };
@@ -67,17 +91,27 @@ private:
   int connectDevices();
   void removeDeviceConnection(const QString& devicePath);
   void onEventDataAvailable(int fd, SubEventConnection& connection);
+  void readEventFrames(int fd, SubEventConnection& connection);
+  void processEventFrame(SubEventConnection& connection, const struct input_event* events,
+                         size_t count, bool forwarded = false);
+  void onInputThreadFrame(const InputThread::Frame& frame);
+  void setupDirectForwarding(uint32_t id, const SubEventConnection& connection);
 
   const Options m_options;
   std::map<DeviceId, std::shared_ptr<DeviceConnection>> m_deviceConnections;
   std::vector<DeviceId> m_activeDeviceIds;
 
-  QTimer* m_activeTimer = nullptr;
-  QTimer* m_connectionTimer = nullptr;
-  QTimer* m_holdMoveEventTimer = nullptr;
+  timing::Timer* m_activeTimer = nullptr;
+  timing::Timer* m_connectionTimer = nullptr;
+  timing::Timer* m_holdMoveEventTimer = nullptr;
   bool m_spotActive = false;
   std::shared_ptr<VirtualDevice> m_virtualMouseDevice;
   std::shared_ptr<VirtualDevice> m_virtualKeyDevice;
   Settings* m_settings = nullptr;
+  QString m_lastPreset; // loaded by the last cyclePresets()
   std::unique_ptr<HoldButtonStatus> m_holdButtonStatus;
+  std::unique_ptr<InputFrameMerger> m_inputFrameMerger;
+  std::unique_ptr<DeviceStateCache> m_deviceStateCache;
+  std::map<uint32_t, std::shared_ptr<SubEventConnection>> m_inputThreadConnections;
+  std::unique_ptr<InputThread> m_inputThread; // last, stopped before the virtual devices are gone
 };
@@ -0,0 +1,188 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "spotstatefeed.h"
+
+#include "logging.h"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+LOGGING_CATEGORY(spotfeed, "spotfeed")
+
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  QByteArray sharedMemoryName() {
+    return QString(PROJECTEUR_SPOT_FEED_NAME_FORMAT).replace("%u", QString::number(getuid())).toLocal8Bit();
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Opens the feed segment of a previous instance, so its readers keep working, if it belongs to
+  /// the user. Otherwise (e.g. created by another local user) it is replaced by a new segment.
+  int openSharedMemory(const QByteArray& name)
+  {
+    const int fd = shm_open(name.constData(), O_RDWR | O_CLOEXEC, 0);
+    if (fd >= 0)
+    {
+      struct stat st{};
+      if (fstat(fd, &st) == 0 && st.st_uid == getuid() && fchmod(fd, 0644) == 0) { return fd; }
+      ::close(fd);
+    }
+
+    shm_unlink(name.constData());
+    return shm_open(name.constData(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  uint64_t monotonicNs()
+  {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Spot height in pixels, the same as calculated by the overlay window.
+  uint32_t spotSizePixels(int percent, int screenHeight)
+  {
+    const int size = static_cast<int>(screenHeight / 100.0 * percent);
+    return static_cast<uint32_t>(size > 50 ? std::min(size, screenHeight) : 50);
+  }
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+SpotStateFeed::SpotStateFeed(QObject* parent)
+  : QObject(parent)
+{
+  const auto name = sharedMemoryName();
+  const int fd = openSharedMemory(name);
+  if (fd >= 0)
+  {
+    if (ftruncate(fd, sizeof(projecteur_spot_feed)) == 0)
+    {
+      void* mem = mmap(nullptr, sizeof(projecteur_spot_feed), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (mem != MAP_FAILED) { m_feed = static_cast<projecteur_spot_feed*>(mem); }
+    }
+    ::close(fd);
+  }
+
+  if (!m_feed)
+  {
+    logError(spotfeed) << tr("Could not create the spot state feed '%1': %2")
+                          .arg(QString::fromLocal8Bit(name)).arg(strerror(errno));
+    return;
+  }
+
+  // Readers of a previous instance may still have the segment mapped, keep the sequence going.
+  __atomic_store_n(&m_feed->magic, 0u, __ATOMIC_RELAXED);
+  m_feed->version = PROJECTEUR_SPOT_FEED_VERSION;
+  m_feed->size = sizeof(projecteur_spot_feed);
+  m_feed->sequence &= ~1u;
+  publish();
+  __atomic_store_n(&m_feed->magic, PROJECTEUR_SPOT_FEED_MAGIC, __ATOMIC_RELEASE);
+
+  logInfo(spotfeed) << tr("Publishing the spot state to '%1'.").arg(QString::fromLocal8Bit(name));
+}
+
+// -------------------------------------------------------------------------------------------------
+SpotStateFeed::~SpotStateFeed()
+{
+  if (!m_feed) { return; }
+
+  __atomic_store_n(&m_feed->magic, 0u, __ATOMIC_RELEASE);
+  munmap(m_feed, sizeof(projecteur_spot_feed));
+  shm_unlink(sharedMemoryName().constData());
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpotStateFeed::setActive(bool active)
+{
+  if (m_state.active == (active ? 1u : 0u)) { return; }
+  m_state.active = active ? 1 : 0;
+  publish();
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpotStateFeed::setPosition(const QPoint& globalPos)
+{
+  if (m_state.x == globalPos.x() && m_state.y == globalPos.y()) { return; }
+  m_state.x = globalPos.x();
+  m_state.y = globalPos.y();
+  publish();
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpotStateFeed::setScreenGeometry(const QRect& geometry)
+{
+  if (QRect(m_state.screen_x, m_state.screen_y, m_state.screen_width, m_state.screen_height) == geometry) {
+    return;
+  }
+  m_state.screen_x = geometry.x();
+  m_state.screen_y = geometry.y();
+  m_state.screen_width = geometry.width();
+  m_state.screen_height = geometry.height();
+  m_state.size = spotSizePixels(static_cast<int>(m_state.size_percent), m_state.screen_height);
+  publish();
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpotStateFeed::setSpotSize(int percent)
+{
+  if (m_state.size_percent == static_cast<uint32_t>(percent)) { return; }
+  m_state.size_percent = static_cast<uint32_t>(percent);
+  m_state.size = spotSizePixels(percent, m_state.screen_height);
+  publish();
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpotStateFeed::setShape(const QString& name)
+{
+  char shape[sizeof(m_state.shape)] = {};
+  const auto utf8 = name.toUtf8();
+  std::memcpy(shape, utf8.constData(), std::min(static_cast<size_t>(utf8.size()), sizeof(shape) - 1));
+  if (std::memcmp(shape, m_state.shape, sizeof(shape)) == 0) { return; }
+
+  std::memcpy(m_state.shape, shape, sizeof(shape));
+  publish();
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpotStateFeed::setZoom(bool enabled, double factor)
+{
+  if (m_state.zoom_enabled == (enabled ? 1u : 0u) && m_state.zoom_factor == factor) { return; }
+  m_state.zoom_enabled = enabled ? 1 : 0;
+  m_state.zoom_factor = factor;
+  publish();
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpotStateFeed::setRotation(double degrees)
+{
+  if (m_state.rotation == degrees) { return; }
+  m_state.rotation = degrees;
+  publish();
+}
+
+// -------------------------------------------------------------------------------------------------
+void SpotStateFeed::publish()
+{
+  if (!m_feed) { return; }
+
+  m_state.timestamp_ns = monotonicNs();
+
+  // Sequence lock writer side: odd sequence while the state is written.
+  const uint32_t sequence = __atomic_load_n(&m_feed->sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&m_feed->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  std::memcpy(&m_feed->state, &m_state, sizeof(m_state));
+  __atomic_store_n(&m_feed->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,38 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QObject>
+#include <QPoint>
+#include <QRect>
+
+#include "projecteur-spotfeed.h"
+
+// -------------------------------------------------------------------------------------------------
+/// Publishes the spot state to a shared memory segment for external readers, see
+/// projecteur-spotfeed.h for the layout and the reader side. Each change is written immediately
+/// under a sequence lock; readers never block the writer.
+class SpotStateFeed : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit SpotStateFeed(QObject* parent = nullptr);
+  ~SpotStateFeed() override;
+
+  bool isValid() const { return m_feed != nullptr; }
+
+  void setActive(bool active);
+  void setPosition(const QPoint& globalPos);
+  void setScreenGeometry(const QRect& geometry);
+  void setSpotSize(int percent);
+  void setShape(const QString& name);
+  void setZoom(bool enabled, double factor);
+  void setRotation(double degrees);
+
+private:
+  void publish();
+
+  projecteur_spot_feed* m_feed = nullptr;
+  projecteur_spot_state m_state{};
+};
@@ -0,0 +1,159 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "timing.h"
+
+#include <QTimer>
+
+#include <algorithm>
+
+namespace timing {
+
+// -------------------------------------------------------------------------------------------------
+VirtualClock::VirtualClock(TimePoint start)
+  : m_now(start)
+{}
+
+// -------------------------------------------------------------------------------------------------
+VirtualClock::~VirtualClock() = default;
+
+// -------------------------------------------------------------------------------------------------
+void VirtualClock::advanceTo(TimePoint time)
+{
+  while (!m_timers.empty() && m_timers.cbegin()->first.first <= time)
+  {
+    const auto it = m_timers.cbegin();
+    const auto timer = it->second;
+    m_now = std::max(m_now, it->first.first);
+    m_keys.erase(timer);
+    m_timers.erase(it);
+    timer->expire();
+  }
+  m_now = std::max(m_now, time);
+}
+
+// -------------------------------------------------------------------------------------------------
+TimePoint VirtualClock::nextDeadline() const
+{
+  return m_timers.empty() ? TimePoint::max() : m_timers.cbegin()->first.first;
+}
+
+// -------------------------------------------------------------------------------------------------
+bool VirtualClock::schedule(Timer* timer, TimePoint deadline)
+{
+  cancel(timer);
+  const Key key{deadline, m_sequence++};
+  m_timers.emplace(key, timer);
+  m_keys.emplace(timer, key);
+  return true;
+}
+
+// -------------------------------------------------------------------------------------------------
+void VirtualClock::cancel(Timer* timer)
+{
+  const auto it = m_keys.find(timer);
+  if (it == m_keys.cend()) { return; }
+
+  m_timers.erase(it->second);
+  m_keys.erase(it);
+}
+
+// -------------------------------------------------------------------------------------------------
+namespace {
+  std::shared_ptr<Clock>& currentClock()
+  {
+    static std::shared_ptr<Clock> clock = std::make_shared<SystemClock>();
+    return clock;
+  }
+} // end anonymous namespace
+
+// -------------------------------------------------------------------------------------------------
+void setClock(std::shared_ptr<Clock> clock)
+{
+  currentClock() = clock ? std::move(clock) : std::make_shared<SystemClock>();
+}
+
+// -------------------------------------------------------------------------------------------------
+const std::shared_ptr<Clock>& clock()
+{
+  return currentClock();
+}
+
+// -------------------------------------------------------------------------------------------------
+Timer::Timer(QObject* parent)
+  : QObject(parent)
+  , m_clock(clock())
+{}
+
+// -------------------------------------------------------------------------------------------------
+Timer::~Timer()
+{
+  if (m_active && !m_qtimer) { m_clock->cancel(this); }
+}
+
+// -------------------------------------------------------------------------------------------------
+void Timer::start()
+{
+  // A repeating timer without interval would never let virtual time advance.
+  const int interval = (m_singleShot || m_qtimer) ? m_interval : std::max(1, m_interval);
+  m_active = true;
+
+  if (m_qtimer || !m_clock->schedule(this, m_clock->now() + std::chrono::milliseconds(interval)))
+  {
+    if (!m_qtimer)
+    {
+      m_qtimer = new QTimer(this);
+      m_qtimer->setTimerType(m_timerType);
+      connect(m_qtimer, &QTimer::timeout, this, &Timer::expire);
+    }
+    m_qtimer->setSingleShot(m_singleShot);
+    m_qtimer->start(m_interval);
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void Timer::start(int msec)
+{
+  m_interval = msec;
+  start();
+}
+
+// -------------------------------------------------------------------------------------------------
+void Timer::stop()
+{
+  if (!m_active) { return; }
+
+  m_active = false;
+  if (m_qtimer) {
+    m_qtimer->stop();
+  } else {
+    m_clock->cancel(this);
+  }
+}
+
+// -------------------------------------------------------------------------------------------------
+void Timer::setInterval(int msec)
+{
+  m_interval = msec;
+  if (m_active) { start(); } // like QTimer, an active timer restarts with the new interval
+}
+
+// -------------------------------------------------------------------------------------------------
+void Timer::setTimerType(Qt::TimerType type)
+{
+  m_timerType = type;
+  if (m_qtimer) { m_qtimer->setTimerType(type); }
+}
+
+// -------------------------------------------------------------------------------------------------
+void Timer::expire()
+{
+  if (m_singleShot) {
+    m_active = false;
+  } else if (!m_qtimer) {
+    m_clock->schedule(this, m_clock->now() + std::chrono::milliseconds(std::max(1, m_interval)));
+  }
+  emit timeout();
+}
+
+} // end namespace timing
@@ -0,0 +1,135 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QObject>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+
+class QTimer;
+
+// -------------------------------------------------------------------------------------------------
+/// Time source and timers of the core (input mapping, HID++ requests, spot activity, presentation
+/// timers). By default the monotonic system clock and Qt event loop timers are used. With a
+/// VirtualClock installed, time only moves with VirtualClock::advanceTo and all due timers fire
+/// from there in a deterministic order - recorded input can be replayed faster than real time.
+///
+/// Measurements of real processing time (metrics, benchmarks, watchdog) keep using the system
+/// clock directly.
+namespace timing {
+
+  using TimePoint = std::chrono::steady_clock::time_point;
+  using Duration = std::chrono::steady_clock::duration;
+
+  class Timer;
+
+  // -----------------------------------------------------------------------------------------------
+  class Clock
+  {
+  public:
+    virtual ~Clock() = default;
+    virtual TimePoint now() const = 0;
+
+  protected:
+    friend class Timer;
+    /// Timer service, returns false if the timer has to use a Qt event loop timer.
+    virtual bool schedule(Timer* timer, TimePoint deadline) = 0;
+    virtual void cancel(Timer* timer) = 0;
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  class SystemClock : public Clock
+  {
+  public:
+    TimePoint now() const override { return std::chrono::steady_clock::now(); }
+
+  protected:
+    bool schedule(Timer*, TimePoint) override { return false; }
+    void cancel(Timer*) override {}
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  class VirtualClock : public Clock
+  {
+  public:
+    explicit VirtualClock(TimePoint start = TimePoint());
+    ~VirtualClock() override;
+
+    TimePoint now() const override { return m_now; }
+
+    /// Moves the time forward to 'time'. Timers due until then fire in the order of their
+    /// deadline, with the clock set to the deadline; timers with the same deadline fire in the
+    /// order they were started. Timers started by timeout handlers fire in the same call if due.
+    void advanceTo(TimePoint time);
+    void advance(Duration duration) { advanceTo(m_now + duration); }
+
+    /// Deadline of the next active timer, TimePoint::max() if there is none.
+    TimePoint nextDeadline() const;
+    size_t activeTimers() const { return m_timers.size(); }
+
+  protected:
+    bool schedule(Timer* timer, TimePoint deadline) override;
+    void cancel(Timer* timer) override;
+
+  private:
+    using Key = std::pair<TimePoint, uint64_t>;
+
+    TimePoint m_now;
+    uint64_t m_sequence = 0;
+    std::map<Key, Timer*> m_timers;
+    std::map<Timer*, Key> m_keys;
+  };
+
+  // -----------------------------------------------------------------------------------------------
+  /// Clock used by all timing functions and timers created after the call. Must be installed
+  /// before the core objects are created, e.g. right at the start of main().
+  void setClock(std::shared_ptr<Clock> clock);
+  const std::shared_ptr<Clock>& clock();
+
+  /// Current time of the installed clock.
+  inline TimePoint now() { return clock()->now(); }
+
+  // -----------------------------------------------------------------------------------------------
+  /// Drop-in replacement for the used subset of QTimer, driven by the clock installed at
+  /// construction time.
+  class Timer : public QObject
+  {
+    Q_OBJECT
+
+  public:
+    explicit Timer(QObject* parent = nullptr);
+    ~Timer() override;
+
+    void start();
+    void start(int msec);
+    void stop();
+    bool isActive() const { return m_active; }
+
+    void setInterval(int msec);
+    int interval() const { return m_interval; }
+
+    void setSingleShot(bool singleShot) { m_singleShot = singleShot; }
+    bool isSingleShot() const { return m_singleShot; }
+
+    void setTimerType(Qt::TimerType type);
+    Qt::TimerType timerType() const { return m_timerType; }
+
+  signals:
+    void timeout();
+
+  private:
+    friend class VirtualClock;
+    void expire();
+
+    const std::shared_ptr<Clock> m_clock;
+    QTimer* m_qtimer = nullptr; // only with clocks without own timer service
+    Qt::TimerType m_timerType = Qt::CoarseTimer;
+    int m_interval = 0;
+    bool m_singleShot = false;
+    bool m_active = false;
+  };
+} // end namespace timing
@@ -37,7 +37,7 @@ VirtualDevice::~VirtualDevice()
 {
   if (m_uinpFd >= 0)
   {
-    ioctl(m_uinpFd, UI_DEV_DESTROY);
+    if (m_isUinput) { ioctl(m_uinpFd, UI_DEV_DESTROY); }
     ::close(m_uinpFd);
     logDebug(virtualdevice)
       << VirtualDevice_::tr("uinput Device Closed (%1; %2)").arg(m_userName, m_deviceName);
@@ -126,15 +126,20 @@ std::shared_ptr<VirtualDevice> VirtualDevice::create(Type deviceType,
 }
 
 // -------------------------------------------------------------------------------------------------
-void VirtualDevice::emitEvents(const struct input_event input_events[], size_t num)
+std::shared_ptr<VirtualDevice> VirtualDevice::createFromFd(int fd, const char* name)
 {
-  if (!num) { return; }
+  if (fd < 0) { return std::shared_ptr<VirtualDevice>(); }
 
-  if (const ssize_t sz = sizeof(input_event) * num) {
-    const auto bytesWritten = write(m_uinpFd, input_events, sz);
-    if (bytesWritten != sz) {
-      logError(virtualdevice) << VirtualDevice_::tr("Error while writing to virtual device.");
-    }
+  auto device = std::make_shared<VirtualDevice>(Token{}, fd, name, name);
+  device->m_isUinput = false;
+  return device;
+}
+
+// -------------------------------------------------------------------------------------------------
+void VirtualDevice::emitEvents(const struct input_event input_events[], size_t num)
+{
+  if (!writeEvents(input_events, num)) {
+    logError(virtualdevice) << VirtualDevice_::tr("Error while writing to virtual device.");
   }
 }
 
@@ -143,3 +148,12 @@ void VirtualDevice::emitEvents(const std::vector<struct input_event>& events)
 {
   emitEvents(events.data(), events.size());
 }
+
+// -------------------------------------------------------------------------------------------------
+bool VirtualDevice::writeEvents(const struct input_event input_events[], size_t num)
+{
+  if (!num) { return true; }
+
+  const ssize_t sz = sizeof(input_event) * num;
+  return write(m_uinpFd, input_events, sz) == sz;
+}
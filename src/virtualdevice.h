@@ -19,6 +19,7 @@ class VirtualDevice
 private:
   struct Token;
   int m_uinpFd = -1;
+  bool m_isUinput = true;
   QString m_userName;
   QString m_deviceName;
 
@@ -36,9 +37,17 @@ public:
                                                uint16_t virtualVersionId = 1,
                                                const char* location = "/dev/uinput");
 
+  /// Return a VirtualDevice that writes its events to an already open file descriptor
+  /// (e.g. a pipe used by the input benchmark). The device takes ownership of the descriptor.
+  static std::shared_ptr<VirtualDevice> createFromFd(int fd, const char* name);
+
   VirtualDevice(Token, int fd, const char* name, const char* sysfs_name);
   ~VirtualDevice();
 
   void emitEvents(const struct input_event[], size_t num);
   void emitEvents(const std::vector<struct input_event>& events);
+
+  /// Like emitEvents, but returns false on errors instead of logging them, e.g. for threads
+  /// other than the Qt Gui thread.
+  bool writeEvents(const struct input_event[], size_t num);
 };
@@ -0,0 +1,110 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+
+#include "watchdog.h"
+
+#include "logging.h"
+#include "metrics.h"
+
+#include <QTimer>
+
+LOGGING_CATEGORY(lcWatchdog, "watchdog")
+
+namespace {
+  // -----------------------------------------------------------------------------------------------
+  namespace Defaults {
+    constexpr std::chrono::milliseconds heartbeatInterval{50};
+  }
+
+  // -----------------------------------------------------------------------------------------------
+  std::atomic<const char*> currentZone{nullptr};
+} // end anonymous namespace
+
+namespace watchdog {
+  // -----------------------------------------------------------------------------------------------
+  Zone::Zone(const char* name)
+    : m_previous(currentZone.exchange(name, std::memory_order_relaxed))
+  {}
+
+  // -----------------------------------------------------------------------------------------------
+  Zone::~Zone()
+  {
+    currentZone.store(m_previous, std::memory_order_relaxed);
+  }
+} // end namespace watchdog
+
+// -------------------------------------------------------------------------------------------------
+EventLoopWatchdog::EventLoopWatchdog(QObject* parent, std::chrono::milliseconds stallThreshold)
+  : QObject(parent)
+  , m_threshold(stallThreshold)
+  , m_heartbeatTimer(new QTimer(this))
+  , m_lastHeartbeat(Clock::now().time_since_epoch().count())
+  , m_stalls(metrics::counter("projecteur_eventloop_stalls", "GUI event loop stalls above threshold."))
+  , m_maxLag(metrics::gauge("projecteur_eventloop_lag_max_milliseconds",
+                            "Maximum GUI event loop lag observed."))
+  , m_lag(metrics::histogram("projecteur_eventloop_stall_seconds", "Duration of GUI event loop stalls."))
+{
+  // Lags below the threshold are not reported, a coarse timer lets the heartbeat share wakeups.
+  m_heartbeatTimer->setTimerType(Qt::CoarseTimer);
+  m_heartbeatTimer->setInterval(static_cast<int>(Defaults::heartbeatInterval.count()));
+  connect(m_heartbeatTimer, &QTimer::timeout, this, &EventLoopWatchdog::heartbeat);
+  m_heartbeatTimer->start();
+
+  m_thread = std::thread([this](){ watch(); });
+}
+
+// -------------------------------------------------------------------------------------------------
+EventLoopWatchdog::~EventLoopWatchdog()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_stopCondition.notify_all();
+  if (m_thread.joinable()) { m_thread.join(); }
+}
+
+// -------------------------------------------------------------------------------------------------
+void EventLoopWatchdog::heartbeat()
+{
+  const auto now = Clock::now();
+  const auto last = Clock::time_point(Clock::duration(
+    m_lastHeartbeat.exchange(now.time_since_epoch().count(), std::memory_order_relaxed)));
+  const auto lag = now - last - Defaults::heartbeatInterval;
+  const char* zone = m_stallZone.exchange(nullptr, std::memory_order_relaxed);
+
+  if (lag < m_threshold) { return; }
+
+  const auto lagMs = std::chrono::duration_cast<std::chrono::milliseconds>(lag).count();
+
+  m_stalls.inc();
+  m_maxLag.setMax(lagMs);
+  m_lag.observe(lag);
+
+  logWarning(lcWatchdog) << tr("Event loop stalled for %1 ms (in '%2').")
+                            .arg(lagMs).arg(zone ? zone : "unknown");
+}
+
+// -------------------------------------------------------------------------------------------------
+void EventLoopWatchdog::watch()
+{
+  // The watcher only wakes up when the next heartbeat is overdue by the threshold, and samples
+  // the active zone in threshold intervals while the event loop is stalled.
+  std::unique_lock<std::mutex> lock(m_mutex);
+  auto deadline = Clock::now() + Defaults::heartbeatInterval + m_threshold;
+  while (!m_stopCondition.wait_until(lock, deadline, [this](){ return m_stop; }))
+  {
+    const auto last = Clock::time_point(Clock::duration(
+      m_lastHeartbeat.load(std::memory_order_relaxed)));
+    const auto now = Clock::now();
+    deadline = last + Defaults::heartbeatInterval + m_threshold;
+    if (now < deadline) { continue; }
+
+    // Event loop is stalled: remember the first zone seen while stalled.
+    if (const auto zone = currentZone.load(std::memory_order_relaxed)) {
+      const char* expected = nullptr;
+      m_stallZone.compare_exchange_strong(expected, zone, std::memory_order_relaxed);
+    }
+    deadline = now + m_threshold;
+  }
+}
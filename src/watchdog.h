@@ -0,0 +1,69 @@
+// This file is part of Projecteur - https://github.com/jahnf/projecteur
+// - See LICENSE.md and README.md
+#pragma once
+
+#include <QObject>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class QTimer;
+
+namespace metrics { class Counter; class Gauge; class Histogram; }
+
+namespace watchdog {
+  // -----------------------------------------------------------------------------------------------
+  /// Marks the handler currently running on the GUI thread. If the event loop stalls while a zone
+  /// is active, the stall is attributed to it. Zones can be nested, names must be string literals.
+  class Zone
+  {
+  public:
+    explicit Zone(const char* name);
+    ~Zone();
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+  private:
+    const char* const m_previous;
+  };
+} // end namespace watchdog
+
+// -------------------------------------------------------------------------------------------------
+/// Detects stalls of the GUI thread event loop.
+///
+/// A timer on the GUI thread sends regular heartbeats; a separate watchdog thread wakes up when a
+/// heartbeat is overdue and samples the currently active watchdog::Zone. The stall is logged (on the GUI
+/// thread) together with its duration once the event loop is running again.
+class EventLoopWatchdog : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit EventLoopWatchdog(QObject* parent = nullptr,
+                             std::chrono::milliseconds stallThreshold = std::chrono::milliseconds(50));
+  ~EventLoopWatchdog() override;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  void heartbeat();
+  void watch();
+
+  const Clock::duration m_threshold;
+  QTimer* const m_heartbeatTimer = nullptr;
+
+  std::atomic<Clock::rep> m_lastHeartbeat;
+  std::atomic<const char*> m_stallZone{nullptr};
+
+  metrics::Counter& m_stalls;
+  metrics::Gauge& m_maxLag;
+  metrics::Histogram& m_lag;
+
+  std::mutex m_mutex;
+  std::condition_variable m_stopCondition;
+  bool m_stop = false;
+  std::thread m_thread;
+};